@@ -0,0 +1,94 @@
+#include "clock.h"
+#include "debug.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+static Uint64 GetCounterFrequency()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+}
+
+Uint64 GetNanoSeconds()
+{
+    static const Uint64 frequency = GetCounterFrequency();
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    // Split into whole seconds and the remainder so multiplying up to nanoseconds can't overflow
+    Uint64 seconds = counter.QuadPart / frequency;
+    Uint64 remainder = counter.QuadPart % frequency;
+    return seconds * 1000000000ULL + remainder * 1000000000ULL / frequency;
+}
+
+Uint64 GetClockResolution()
+{
+    return SDL_max(1000000000ULL / GetCounterFrequency(), 1ULL);
+}
+
+#else
+#include <time.h>
+
+Uint64 GetNanoSeconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (Uint64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+Uint64 GetClockResolution()
+{
+    timespec resolution;
+    clock_getres(CLOCK_MONOTONIC, &resolution);
+    return SDL_max((Uint64)resolution.tv_sec * 1000000000ULL + resolution.tv_nsec, 1ULL);
+}
+
+#endif
+
+ClockMeasurement MeasureClock()
+{
+    const int samples = 100000;
+
+    // Time a pile of back to back calls for the overhead, and keep the smallest step we see for the practical resolution
+    ClockMeasurement result;
+    result.smallestStep = 0;
+    result.monotonic = true;
+
+    Uint64 start = GetNanoSeconds();
+    Uint64 previous = start;
+    for (int i = 0; i < samples; ++i)
+    {
+        Uint64 now = GetNanoSeconds();
+        if (now < previous)
+        {
+            result.monotonic = false;
+        }
+        else if (now > previous && (result.smallestStep == 0 || now - previous < result.smallestStep))
+        {
+            result.smallestStep = now - previous;
+        }
+
+        previous = now;
+    }
+
+    result.callOverhead = (double)(previous - start) / samples;
+    return result;
+}
+
+bool ClockSelfTest()
+{
+    ClockMeasurement measurement = MeasureClock();
+
+    Debug::console("Clock: reported resolution %llu ns, smallest step seen %llu ns, %.1f ns per call\n",
+        GetClockResolution(), measurement.smallestStep, measurement.callOverhead);
+
+    if (!measurement.monotonic)
+    {
+        Debug::console("Clock: went backwards during the self test!\n");
+    }
+
+    return measurement.monotonic;
+}
@@ -1,6 +1,7 @@
 /*
 This file is meant to abstract everything to do with time.
 It just wraps the systems specific high resolution timers for now
+QueryPerformanceCounter on Windows and the monotonic clock_gettime everywhere else
 */
 
 #ifndef CLOCK_H
@@ -8,6 +9,30 @@ It just wraps the systems specific high resolution timers for now
 
 #include <SDL/SDL.h>
 
+// Nanoseconds since some fixed point in the past. It only ever goes forward, so subtract two of these to time something
+// The value itself doesn't mean anything across runs
 Uint64 GetNanoSeconds();
 
-#endif
\ No newline at end of file
+// The smallest step the clock can take in nanoseconds as the system reports it, 100 for QPC's usual 10MHz,
+// and usually 1 for clock_gettime. The step actually seen between calls is often bigger, which is what ClockSelfTest measures
+Uint64 GetClockResolution();
+
+// What the clock does in practice, measured by calling it over and over
+struct ClockMeasurement
+{
+    // The smallest step seen between two calls, in nanoseconds
+    Uint64 smallestStep;
+
+    // How long one call takes, in nanoseconds
+    double callOverhead;
+
+    // False if the clock was ever caught going backwards
+    bool monotonic;
+};
+
+ClockMeasurement MeasureClock();
+
+// Measures the clock and logs the results, returning false if it went backwards
+bool ClockSelfTest();
+
+#endif
@@ -1,44 +1,429 @@
 #include "debug.h"
 #include <cstdio>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <windows.h>
+#include "clock.h"
 
 namespace Debug
 {
-	//TODO: Make this a circular flushing buffer so we can write larger messages
-	char buffer[4096];
+	// How many records each thread can have waiting before new messages get dropped
+	const Uint32 LOG_RING_SIZE = 1024;
 
-	//Writes out the given message to the log file
-	void log(int category, const char* fmt, ...)
+	// How long the writing thread sleeps when there's nothing to write. Loggers never wake it up, that would cost a system call
+	const int LOG_DRAIN_MILLISECONDS = 5;
+
+	// Each thread only ever adds records at the head, and only the writing thread takes them off the tail,
+	// so neither side needs a lock
+	struct LogRing
+	{
+		LogRing()
+			: head(0), tail(0), dropped(0), reportedDropped(0)
+		{
+			records = new LogRecord[LOG_RING_SIZE];
+		}
+
+		LogRecord* records;
+		std::atomic<Uint32> head;
+		std::atomic<Uint32> tail;
+		std::atomic<Uint32> dropped;
+
+		// Only touched by the writing thread
+		Uint32 reportedDropped;
+	};
+
+	// Rings live for the rest of the program, a thread can finish while its messages are still waiting
+	static std::mutex ringsLock;
+	static std::vector<LogRing*> rings;
+	static thread_local LogRing* currentRing = NULL;
+
+	// Used to write messages straight away when the writing thread isn't running
+	static thread_local LogRecord immediateRecord;
+
+	static std::atomic<bool> draining(false);
+	static std::thread drainThread;
+	static std::mutex drainLock;
+	static std::condition_variable drainSignal;
+	static bool quitting = false;
+	static FILE* logFile = NULL;
+	static bool echoOutput = true;
+	static Uint64 startTime = 0;
+
+	static LogRing* GetThreadRing()
+	{
+		if (!currentRing)
+		{
+			currentRing = new LogRing();
+
+			std::lock_guard<std::mutex> guard(ringsLock);
+			rings.push_back(currentRing);
+		}
+
+		return currentRing;
+	}
+
+	static Sint64 SignedValue(const LogRecord& record, int i)
+	{
+		switch (record.types[i])
+		{
+		case LOG_ARG_UINT: return (Sint64)record.values[i].u;
+		case LOG_ARG_DOUBLE: return (Sint64)record.values[i].d;
+		case LOG_ARG_POINTER: return (Sint64)(intptr_t)record.values[i].p;
+		case LOG_ARG_STRING: return 0;
+		default: return record.values[i].i;
+		}
+	}
+
+	static double DoubleValue(const LogRecord& record, int i)
+	{
+		switch (record.types[i])
+		{
+		case LOG_ARG_INT: return (double)record.values[i].i;
+		case LOG_ARG_UINT: return (double)record.values[i].u;
+		case LOG_ARG_DOUBLE: return record.values[i].d;
+		default: return 0.0;
+		}
+	}
+
+	static const char* StringValue(const LogRecord& record, int i)
+	{
+		if (record.types[i] != LOG_ARG_STRING)
+		{
+			return "(not a string)";
+		}
+
+		return record.values[i].u < LOG_STRING_SPACE ? record.strings + record.values[i].u : "";
+	}
+
+	// Runs the format one conversion at a time, since the arguments can't be turned back into a va_list
+	// Flags, width and precision are kept, but the length is swapped for one that matches how the argument was stored
+	static void FormatRecord(const LogRecord& record, char* out, int size)
+	{
+		int length = 0;
+		int arg = 0;
+		const char* format = record.format;
+
+		while (*format && length < size - 1)
+		{
+			if (*format != '%')
+			{
+				out[length++] = *format++;
+				continue;
+			}
+
+			if (format[1] == '%')
+			{
+				out[length++] = '%';
+				format += 2;
+				continue;
+			}
+
+			// A * width or precision takes the next argument, the same as printf. It's written into the spec as a number,
+			// where a negative width reads as the - flag and a negative precision means there isn't one
+			char spec[32];
+			int specLength = 0;
+			spec[specLength++] = *format++;
+			while (*format && strchr("-+ #0123456789.*", *format) && specLength < 24)
+			{
+				if (*format != '*')
+				{
+					spec[specLength++] = *format++;
+					continue;
+				}
+
+				++format;
+				int value = arg < record.argCount ? (int)SignedValue(record, arg++) : 0;
+				if (value < 0 && spec[specLength - 1] == '.')
+				{
+					--specLength;
+					continue;
+				}
+
+				// Leaves room for the length and conversion that get added on the end
+				int space = (int)sizeof(spec) - 4 - specLength;
+				int written = SDL_snprintf(spec + specLength, space, "%d", value);
+				specLength += SDL_max(0, SDL_min(written, space - 1));
+			}
+
+			while (*format && strchr("hljztL", *format))
+			{
+				++format;
+			}
+
+			char conversion = *format;
+			if (!conversion)
+			{
+				break;
+			}
+			++format;
+
+			if (arg >= record.argCount)
+			{
+				continue;
+			}
+
+			int written = 0;
+			switch (conversion)
+			{
+			case 'd': case 'i':
+				spec[specLength++] = 'l';
+				spec[specLength++] = 'l';
+				spec[specLength++] = conversion;
+				spec[specLength] = 0;
+				written = snprintf(out + length, size - length, spec, (long long)SignedValue(record, arg));
+				break;
+			case 'u': case 'o': case 'x': case 'X':
+				spec[specLength++] = 'l';
+				spec[specLength++] = 'l';
+				spec[specLength++] = conversion;
+				spec[specLength] = 0;
+				written = snprintf(out + length, size - length, spec, (unsigned long long)SignedValue(record, arg));
+				break;
+			case 'c':
+				spec[specLength++] = 'c';
+				spec[specLength] = 0;
+				written = snprintf(out + length, size - length, spec, (int)SignedValue(record, arg));
+				break;
+			case 's':
+				spec[specLength++] = 's';
+				spec[specLength] = 0;
+				written = snprintf(out + length, size - length, spec, StringValue(record, arg));
+				break;
+			case 'p':
+				spec[specLength++] = 'p';
+				spec[specLength] = 0;
+				written = snprintf(out + length, size - length, spec, record.values[arg].p);
+				break;
+			default:
+				spec[specLength++] = conversion;
+				spec[specLength] = 0;
+				written = snprintf(out + length, size - length, spec, DoubleValue(record, arg));
+				break;
+			}
+
+			++arg;
+			length += SDL_max(0, SDL_min(written, size - 1 - length));
+		}
+
+		out[length] = 0;
+	}
+
+	static void WriteMessage(const LogRecord& record, const char* message, bool toFile)
 	{
-		va_list argptr;
-		va_start(argptr,fmt);
-		vsnprintf(buffer, 4096, fmt, argptr);
-		SDL_LogDebug(category, buffer);
+		if (echoOutput || !toFile)
+		{
+			if (record.output == CONSOLE_OUTPUT)
+			{
+				OutputDebugStringA(message);
+				fputs(message, stderr);
+			}
+			else
+			{
+				SDL_LogDebug(record.category, "%s", message);
+			}
+		}
+
+		if (toFile && logFile)
+		{
+			size_t length = strlen(message);
+			bool newline = length > 0 && message[length - 1] == '\n';
+			fprintf(logFile, "%12.6f %s%s", (record.time - startTime) / 1000000000.0, message, newline ? "" : "\n");
+		}
+	}
+
+	// Writes out everything waiting in the rings, oldest first across all the threads
+	static void DrainRings()
+	{
+		std::vector<LogRing*> waiting;
+		{
+			std::lock_guard<std::mutex> guard(ringsLock);
+			waiting = rings;
+		}
+
+		char message[1024];
+		for (size_t i = 0; i < waiting.size(); ++i)
+		{
+			LogRing* ring = waiting[i];
+			Uint32 dropped = ring->dropped.load(std::memory_order_relaxed);
+			if (dropped != ring->reportedDropped)
+			{
+				LogRecord note;
+				note.output = CONSOLE_OUTPUT;
+				note.category = SDL_LOG_CATEGORY_APPLICATION;
+				note.time = GetNanoSeconds();
+				SDL_snprintf(message, sizeof(message), "Log: %u messages dropped, the thread logged faster than we could write\n", dropped - ring->reportedDropped);
+				WriteMessage(note, message, true);
+				ring->reportedDropped = dropped;
+			}
+		}
+
+		while (true)
+		{
+			LogRing* oldest = NULL;
+			for (size_t i = 0; i < waiting.size(); ++i)
+			{
+				LogRing* ring = waiting[i];
+				Uint32 tail = ring->tail.load(std::memory_order_relaxed);
+				if (tail == ring->head.load(std::memory_order_acquire))
+				{
+					continue;
+				}
+
+				if (!oldest || ring->records[tail % LOG_RING_SIZE].time < oldest->records[oldest->tail.load(std::memory_order_relaxed) % LOG_RING_SIZE].time)
+				{
+					oldest = ring;
+				}
+			}
+
+			if (!oldest)
+			{
+				break;
+			}
+
+			Uint32 tail = oldest->tail.load(std::memory_order_relaxed);
+			const LogRecord& record = oldest->records[tail % LOG_RING_SIZE];
+			FormatRecord(record, message, sizeof(message));
+			WriteMessage(record, message, true);
+			oldest->tail.store(tail + 1, std::memory_order_release);
+		}
+
+		if (logFile)
+		{
+			fflush(logFile);
+		}
 	}
 
-	void log(const char* fmt, ...)
+	static void DrainLoop()
 	{
-		va_list argptr;
-		va_start(argptr,fmt);
-		vsnprintf(buffer, 4096, fmt, argptr);
-		SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, buffer);
+		std::unique_lock<std::mutex> guard(drainLock);
+		while (!quitting)
+		{
+			guard.unlock();
+			DrainRings();
+			guard.lock();
+
+			drainSignal.wait_for(guard, std::chrono::milliseconds(LOG_DRAIN_MILLISECONDS), []() { return quitting; });
+		}
 	}
 
-	//TODO: Set up categories append to the string when using the console
-	//Writes out the given message to the debug console
-	void console(int category, const char* fmt, ...)
+	void Init(const char* filename, bool echo)
 	{
-		va_list argptr;
-		va_start(argptr,fmt);
-		vsnprintf(buffer, 4096, fmt, argptr);
-		OutputDebugStringA(buffer);
+		if (draining)
+		{
+			return;
+		}
+
+		logFile = filename ? fopen(filename, "w") : NULL;
+		echoOutput = echo;
+		startTime = GetNanoSeconds();
+		quitting = false;
+		drainThread = std::thread(DrainLoop);
+		draining = true;
 	}
 
-	void console(const char* fmt, ...)
+	void Shutdown()
 	{
-		va_list argptr;
-		va_start(argptr,fmt);
-		vsnprintf(buffer, 4096, fmt, argptr);
-		OutputDebugStringA(buffer);
+		if (!draining)
+		{
+			return;
+		}
+
+		draining = false;
+		{
+			std::lock_guard<std::mutex> guard(drainLock);
+			quitting = true;
+		}
+		drainSignal.notify_all();
+		drainThread.join();
+
+		// Anything logged while we were stopping still needs writing
+		DrainRings();
+
+		if (logFile)
+		{
+			fclose(logFile);
+			logFile = NULL;
+		}
+
+		echoOutput = true;
+	}
+
+	LogRecord* BeginRecord(int output, int category, const char* format)
+	{
+		LogRecord* record = &immediateRecord;
+		if (draining.load(std::memory_order_relaxed))
+		{
+			LogRing* ring = GetThreadRing();
+			Uint32 head = ring->head.load(std::memory_order_relaxed);
+			if (head - ring->tail.load(std::memory_order_acquire) >= LOG_RING_SIZE)
+			{
+				ring->dropped.fetch_add(1, std::memory_order_relaxed);
+				return NULL;
+			}
+
+			record = &ring->records[head % LOG_RING_SIZE];
+		}
+
+		record->format = format;
+		record->time = GetNanoSeconds();
+		record->category = category;
+		record->output = (Uint8)output;
+		record->argCount = 0;
+		record->stringsUsed = 0;
+		return record;
+	}
+
+	void CommitRecord(LogRecord* record)
+	{
+		if (record == &immediateRecord)
+		{
+			char message[1024];
+			FormatRecord(*record, message, sizeof(message));
+			WriteMessage(*record, message, false);
+			return;
+		}
+
+		currentRing->head.store(currentRing->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	void CaptureString(LogRecord& record, const char* value)
+	{
+		if (record.argCount >= LOG_MAX_ARGS)
+		{
+			return;
+		}
+
+		int i = record.argCount++;
+		record.types[i] = LOG_ARG_STRING;
+		record.values[i].u = LOG_STRING_SPACE;
+
+		// Long strings get cut off, and once the space runs out the rest come out empty
+		int space = LOG_STRING_SPACE - record.stringsUsed;
+		if (space <= 1)
+		{
+			return;
+		}
+
+		if (!value)
+		{
+			value = "(null)";
+		}
+
+		// Copied in one pass rather than measuring the string first, they're usually short
+		char* out = record.strings + record.stringsUsed;
+		char* last = out + space - 1;
+		while (*value && out < last)
+		{
+			*out++ = *value++;
+		}
+		*out++ = 0;
+
+		record.values[i].u = record.stringsUsed;
+		record.stringsUsed = (Uint8)(out - record.strings);
 	}
-}
\ No newline at end of file
+}
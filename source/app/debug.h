@@ -2,6 +2,7 @@
 #define DEBUG_H
 
 #include <SDL/SDL.h>
+#include <type_traits>
 
 namespace Debug
 {
@@ -15,13 +16,147 @@ namespace Debug
 		INPUT = SDL_LOG_CATEGORY_INPUT // input log
 	};
 
+	// Starts the thread that writes messages out, so logging only costs copying the arguments into a buffer
+	// Until this is called, and after Shutdown, messages get written straight away on whichever thread logged them
+	// With a filename every message also goes into that file, and echo keeps sending them to the debugger and SDL's log
+	void Init(const char* filename = NULL, bool echo = true);
+
+	// Writes out anything still waiting and stops the thread
+	void Shutdown();
+
+	enum Output
+	{
+		LOG_OUTPUT,
+		CONSOLE_OUTPUT
+	};
+
+	// Messages are formatted later on another thread, so the format has to stay around (string literals are the way to go)
+	// and every argument gets copied into a record. Strings are copied too, up to the space a record has for them
+	const int LOG_MAX_ARGS = 8;
+	const int LOG_STRING_SPACE = 128;
+
+	enum LogArgType
+	{
+		LOG_ARG_INT,
+		LOG_ARG_UINT,
+		LOG_ARG_DOUBLE,
+		LOG_ARG_STRING,
+		LOG_ARG_POINTER
+	};
+
+	struct LogRecord
+	{
+		const char* format;
+		Uint64 time;
+		int category;
+		Uint8 output;
+		Uint8 argCount;
+		Uint8 stringsUsed;
+		Uint8 types[LOG_MAX_ARGS];
+
+		// Strings store where they start in the strings buffer
+		union
+		{
+			Sint64 i;
+			Uint64 u;
+			double d;
+			const void* p;
+		} values[LOG_MAX_ARGS];
+
+		char strings[LOG_STRING_SPACE];
+	};
+
+	// Everything below here is used by log and console, call those instead
+	// Begin hands out the next free record on this thread, or NULL if the thread's buffer is full and the message gets dropped
+	LogRecord* BeginRecord(int output, int category, const char* format);
+	void CommitRecord(LogRecord* record);
+	void CaptureString(LogRecord& record, const char* value);
+
+	inline void CaptureArg(LogRecord& record, const char* value) { CaptureString(record, value); }
+	inline void CaptureArg(LogRecord& record, char* value) { CaptureString(record, value); }
+
+	template <class T>
+	inline typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type CaptureArg(LogRecord& record, T value)
+	{
+		if (record.argCount >= LOG_MAX_ARGS)
+		{
+			return;
+		}
+
+		int i = record.argCount++;
+		if (std::is_floating_point<T>::value)
+		{
+			record.types[i] = LOG_ARG_DOUBLE;
+			record.values[i].d = (double)value;
+		}
+		else if (std::is_signed<T>::value || std::is_enum<T>::value)
+		{
+			record.types[i] = LOG_ARG_INT;
+			record.values[i].i = (Sint64)value;
+		}
+		else
+		{
+			record.types[i] = LOG_ARG_UINT;
+			record.values[i].u = (Uint64)value;
+		}
+	}
+
+	template <class T>
+	inline void CaptureArg(LogRecord& record, T* value)
+	{
+		if (record.argCount < LOG_MAX_ARGS)
+		{
+			int i = record.argCount++;
+			record.types[i] = LOG_ARG_POINTER;
+			record.values[i].p = value;
+		}
+	}
+
+	inline void CaptureArgs(LogRecord&) {}
+
+	template <class T, class... Rest>
+	inline void CaptureArgs(LogRecord& record, T value, Rest... rest)
+	{
+		CaptureArg(record, value);
+		CaptureArgs(record, rest...);
+	}
+
+	template <class... Args>
+	void Write(int output, int category, const char* format, Args... args)
+	{
+		LogRecord* record = BeginRecord(output, category, format);
+		if (record)
+		{
+			CaptureArgs(*record, args...);
+			CommitRecord(record);
+		}
+	}
+
 	//Writes out the given message to the log file
-	void log(int category, const char* fmt, ...);
-	void log(const char* fmt, ...);
+	template <class... Args>
+	void log(int category, const char* fmt, Args... args)
+	{
+		Write(LOG_OUTPUT, category, fmt, args...);
+	}
+
+	template <class... Args>
+	void log(const char* fmt, Args... args)
+	{
+		Write(LOG_OUTPUT, SDL_LOG_CATEGORY_APPLICATION, fmt, args...);
+	}
 
 	//Writes out the given message to the debug console
-	void console(int category, const char* fmt, ...);
-	void console(const char* fmt, ...);
+	template <class... Args>
+	void console(int category, const char* fmt, Args... args)
+	{
+		Write(CONSOLE_OUTPUT, category, fmt, args...);
+	}
+
+	template <class... Args>
+	void console(const char* fmt, Args... args)
+	{
+		Write(CONSOLE_OUTPUT, SDL_LOG_CATEGORY_APPLICATION, fmt, args...);
+	}
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,232 @@
+#include "jobs.h"
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "profiler.h"
+
+struct Job
+{
+    JobFunction function;
+    void* data;
+    JobCounter* counter;
+};
+
+// Each thread's jobs. The owner pushes and pops at the back, thieves take from the front
+// The lock is only ever fought over when someone is stealing, so it stays cheap
+struct JobQueue
+{
+    std::mutex lock;
+    std::deque<Job> jobs;
+};
+
+static std::vector<std::thread> workers;
+static JobQueue* queues = NULL;
+static int queueCount = 0;
+
+// Which queue belongs to the current thread, threads we didn't start share the first one with the main thread
+static thread_local int threadIndex = 0;
+
+// Workers that can't find anything to do go to sleep until more jobs get queued
+static std::atomic<int> queuedJobs(0);
+static std::atomic<int> sleepingWorkers(0);
+static std::atomic<bool> quitting(false);
+static std::mutex sleepLock;
+static std::condition_variable wakeUp;
+
+// Names for the profiler, kept around for good since traces can be written after the workers are gone
+const int MAX_NAMED_WORKERS = 64;
+static char workerNames[MAX_NAMED_WORKERS][16];
+
+static void FinishJob(JobCounter* counter)
+{
+    // Once a counter is empty it lets go of its parent, which might empty that one too
+    // The parent has to be read first, as soon as pending hits zero the waiter can return and the counter is gone
+    while (counter)
+    {
+        JobCounter* parent = counter->parent;
+        if (counter->pending.fetch_sub(1) != 1)
+        {
+            break;
+        }
+
+        counter = parent;
+    }
+}
+
+static bool PopJob(Job& job)
+{
+    JobQueue& queue = queues[threadIndex];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.jobs.empty())
+    {
+        return false;
+    }
+
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+
+static bool StealJob(Job& job)
+{
+    // Start with our neighbour so the threads don't all gang up on the same victim
+    for (int i = 1; i < queueCount; ++i)
+    {
+        JobQueue& queue = queues[(threadIndex + i) % queueCount];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (!queue.jobs.empty())
+        {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Finds and runs one job, returns false if there wasn't anything to do
+static bool RunOneJob()
+{
+    Job job;
+    if (!PopJob(job) && !StealJob(job))
+    {
+        return false;
+    }
+
+    --queuedJobs;
+    job.function(job.data);
+    FinishJob(job.counter);
+    return true;
+}
+
+static void WorkerLoop(int index)
+{
+    threadIndex = index;
+    if (index < MAX_NAMED_WORKERS)
+    {
+        Profiler::SetThreadName(workerNames[index]);
+    }
+
+    while (!quitting)
+    {
+        if (RunOneJob())
+        {
+            continue;
+        }
+
+        // Spin for a little while first since new work usually shows up right away during a frame
+        bool found = false;
+        for (int spin = 0; spin < 64 && !found; ++spin)
+        {
+            std::this_thread::yield();
+            found = queuedJobs > 0;
+        }
+
+        if (!found)
+        {
+            std::unique_lock<std::mutex> guard(sleepLock);
+            ++sleepingWorkers;
+            wakeUp.wait(guard, []() { return queuedJobs > 0 || quitting; });
+            --sleepingWorkers;
+        }
+    }
+}
+
+void Jobs::Init(int workerCount)
+{
+    if (workerCount < 0)
+    {
+        workerCount = std::max((int)std::thread::hardware_concurrency() - 1, 0);
+    }
+
+    quitting = false;
+    queueCount = workerCount + 1;
+    queues = new JobQueue[queueCount];
+    threadIndex = 0;
+    Profiler::SetThreadName("Main");
+
+    for (int i = 1; i < queueCount; ++i)
+    {
+        if (i < MAX_NAMED_WORKERS)
+        {
+            snprintf(workerNames[i], sizeof(workerNames[i]), "Worker %d", i);
+        }
+
+        workers.push_back(std::thread(WorkerLoop, i));
+    }
+}
+
+void Jobs::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        quitting = true;
+    }
+    wakeUp.notify_all();
+
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+
+    workers.clear();
+    delete[] queues;
+    queues = NULL;
+    queueCount = 0;
+}
+
+int Jobs::ThreadCount()
+{
+    return std::max(queueCount, 1);
+}
+
+void Jobs::Run(JobFunction function, void* data, JobCounter* counter)
+{
+    // Without any workers there's nobody else to run it, so just do it now
+    if (queueCount == 0)
+    {
+        function(data);
+        return;
+    }
+
+    // The first job into a counter holds its parent open
+    for (JobCounter* current = counter; current && current->pending.fetch_add(1) == 0; current = current->parent)
+    {
+    }
+
+    Job job;
+    job.function = function;
+    job.data = data;
+    job.counter = counter;
+
+    {
+        JobQueue& queue = queues[threadIndex];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.jobs.push_back(job);
+    }
+
+    ++queuedJobs;
+
+    // Taking the lock makes sure a worker that's about to sleep either sees the new job or gets the notify
+    if (sleepingWorkers > 0)
+    {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+        }
+        wakeUp.notify_one();
+    }
+}
+
+void Jobs::Wait(JobCounter* counter)
+{
+    while (counter->pending > 0)
+    {
+        if (!RunOneJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// A small work stealing job system. Every thread gets its own queue of jobs, it takes the newest job
+// off its own queue (which is most likely still in cache) and when that runs dry it steals the oldest job
+// from someone else's, which tends to be the biggest piece of work left
+
+typedef void (*JobFunction)(void* data);
+
+// Counts the jobs that still need to finish before something can carry on
+// A counter can have a parent, which it keeps open for as long as it has jobs of its own. That way a job can
+// spawn children into its own counter and anyone waiting on the parent waits for the whole tree
+struct JobCounter
+{
+    JobCounter(JobCounter* _parent = NULL)
+        : pending(0), parent(_parent)
+    {}
+
+    std::atomic<int> pending;
+    JobCounter* parent;
+};
+
+namespace Jobs
+{
+    // Starts the worker threads, by default one less than the number of cores since the calling thread works too
+    // Until this is called everything runs straight away on the calling thread
+    void Init(int workerCount = -1);
+    void Shutdown();
+
+    // Workers plus the thread that called Init
+    int ThreadCount();
+
+    // Queues up a job, the counter goes up now and back down once the job has run
+    void Run(JobFunction function, void* data, JobCounter* counter);
+
+    // Runs other jobs until the counter gets back down to zero, so waiting threads never just sit there
+    void Wait(JobCounter* counter);
+
+    template <class Body>
+    struct ParallelForRange
+    {
+        const Body* body;
+        int start;
+        int end;
+    };
+
+    template <class Body>
+    void RunParallelForRange(void* data)
+    {
+        ParallelForRange<Body>* range = (ParallelForRange<Body> *)data;
+        (*range->body)(range->start, range->end);
+    }
+
+    // Calls body(start, end) over pieces of 0 to count, at least grain items at a time, and returns once they're all done
+    // The pieces are never smaller than grain, but we also don't cut it into many more pieces than there are threads
+    template <class Body>
+    void ParallelFor(int count, int grain, const Body& body)
+    {
+        int threads = ThreadCount();
+        if (count <= grain || threads == 1)
+        {
+            if (count > 0)
+            {
+                body(0, count);
+            }
+
+            return;
+        }
+
+        int piecesPerThread = 4;
+        int pieceSize = std::max(grain, (count + threads * piecesPerThread - 1) / (threads * piecesPerThread));
+        int pieceCount = (count + pieceSize - 1) / pieceSize;
+
+        std::vector<ParallelForRange<Body> > ranges(pieceCount);
+        JobCounter counter;
+        for (int i = 0; i < pieceCount; ++i)
+        {
+            ranges[i].body = &body;
+            ranges[i].start = i * pieceSize;
+            ranges[i].end = std::min(count, (i + 1) * pieceSize);
+            Run(RunParallelForRange<Body>, &ranges[i], &counter);
+        }
+
+        Wait(&counter);
+    }
+}
+
+#endif
@@ -2,10 +2,15 @@
 #include <stdio.h>
 #include "debug.h"
 #include "perftimer.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "clock.h"
 
 #include "rendering\tests.h"
 #include "rendering\3d\mesh.h"
 #include "rendering\device.h"
+#include "rendering\pipeline.h"
+#include "rendering\texture.h"
 
 FILE _iob[] = { *stdin, *stdout, *stderr };
 
@@ -25,7 +30,16 @@ SDL_Surface* gScreenSurface = NULL;
 
 //The image we will load and show on the screen
 Mesh gMesh;
-Device* gDevice;
+FramePipeline* gPipeline = NULL;
+
+// How the mesh gets filled in, pressing M cycles through the modes, D through the depth formats
+// and C toggles depth compression. P switches between pipelined and one at a time frames
+// U switches between updating the whole window every frame and only the parts that changed
+// T starts profiling, and pressing it again writes everything recorded to trace.json
+// S shows the frame counters on screen, and V starts and stops recording them to stats.csv
+// R starts and stops writing every frame out to capture_00000.png and on, Y streams them all into capture.y4m
+DrawState gDrawState;
+Texture gTexture;
 
 //Starts up SDL and creates window
 bool init();
@@ -33,6 +47,9 @@ void close();
 
 int main( int argc, char* args[] )
 {
+    // Messages get written out on their own thread from here on
+    Debug::Init();
+
     //Start up SDL and create window
     if( !init() )
     {
@@ -46,6 +63,10 @@ int main( int argc, char* args[] )
         //Event handler
         SDL_Event e;
 
+        // Frame times get averaged over about a second and shown in the title bar
+        Uint64 statsStart = GetNanoSeconds();
+        int statsFrames = 0;
+
         //While application is running
         while( !quit )
         {
@@ -57,12 +78,91 @@ int main( int argc, char* args[] )
                 {
                     quit = true;
                 }
+                // Only changed parts of the window get updated, so anything that wipes it needs a full update
+                else if( e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED )
+                {
+                    gPipeline->InvalidateWindow();
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_m )
+                {
+                    gDrawState.mode = (ShadeMode)((gDrawState.mode + 1) % SHADE_MODE_COUNT);
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_d )
+                {
+                    gPipeline->SetDepthFormat((DepthFormat)((gPipeline->GetDepthFormat() + 1) % DEPTH_FORMAT_COUNT));
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_c )
+                {
+                    gPipeline->SetDepthCompression(!gPipeline->DepthCompression());
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_u )
+                {
+                    gPipeline->SetDirtyRects(!gPipeline->DirtyRects());
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_p )
+                {
+                    gPipeline->SetPipelined(!gPipeline->Pipelined());
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_s )
+                {
+                    gPipeline->SetStatsOverlay(!gPipeline->StatsOverlay());
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_v )
+                {
+                    if (gPipeline->RecordingStats())
+                    {
+                        gPipeline->StopStatsRecording();
+                    }
+                    else
+                    {
+                        gPipeline->StartStatsRecording("stats.csv");
+                    }
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_r )
+                {
+                    gPipeline->SetCapturing(!gPipeline->Capturing());
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_y )
+                {
+                    if (gPipeline->Streaming())
+                    {
+                        gPipeline->StopStreaming();
+                    }
+                    else
+                    {
+                        gPipeline->StartStreaming("capture.y4m", VIDEO_Y4M);
+                    }
+                }
+                else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_t )
+                {
+                    if (Profiler::Enabled())
+                    {
+                        gPipeline->Flush();
+                        Profiler::SetEnabled(false);
+                        Profiler::WriteChromeTrace("trace.json");
+                    }
+                    else
+                    {
+                        Profiler::Reset();
+                        Profiler::SetEnabled(true);
+                    }
+                }
             }
             
             //Apply the image
-            gDevice->Clear(Color(0x000000));
-            Draw(gDevice, gMesh);
-            SDL_UpdateWindowSurface( gWindow );
+            gPipeline->RunFrame(gMesh, gDrawState);
+
+            ++statsFrames;
+            Uint64 statsElapsed = GetNanoSeconds() - statsStart;
+            if (statsElapsed >= 1000000000ULL)
+            {
+                char title[64];
+                SDL_snprintf(title, sizeof(title), "Rasterizer - %.2f ms per frame", statsElapsed / (statsFrames * 1000000.0));
+                SDL_SetWindowTitle(gWindow, title);
+
+                statsStart += statsElapsed;
+                statsFrames = 0;
+            }
         }
     }
 
@@ -96,11 +196,13 @@ bool init()
         {
             //Get window surface
             gScreenSurface = SDL_GetWindowSurface( gWindow );
-            gDevice = new Device(gScreenSurface);
+            gPipeline = new FramePipeline(gWindow, gScreenSurface);
+            gPipeline->SetDepthCompression(true);
         }
     }
 
     PerfTimer::Init();
+    Jobs::Init();
 
     if (!gMesh.ReadTestFormat("data/suzanne.obj"))
     {
@@ -108,20 +210,28 @@ bool init()
         success = false;
     }
 
+    gTexture.Create(64, 64);
+    gTexture.FillChecker(8, Color(0xFFFFFF), Color(0x3060C0));
+    gDrawState.texture = &gTexture;
+
     return success;
 }
 
 void close()
 {
-    if (gDevice)
+    if (gPipeline)
     {
-        delete gDevice;
+        delete gPipeline;
     }
 
+    Jobs::Shutdown();
+
     //Destroy window
     SDL_DestroyWindow( gWindow );
     gWindow = NULL;
 
     //Quit SDL subsystems
     SDL_Quit();
+
+    Debug::Shutdown();
 }
\ No newline at end of file
@@ -1,35 +1,27 @@
 #include "perftimer.h"
+#include "clock.h"
 #include "debug.h"
 
-double PerfTimer::PCFreq = 0.0;
-
 void PerfTimer::Init()
 {
-	LARGE_INTEGER li;
-	if (!QueryPerformanceFrequency(&li))
+	if (!ClockSelfTest())
 	{
-		Debug::console("QueryPerformanceFrequency failed!\n");
+		Debug::console("The high resolution clock isn't reliable, timings will be off!\n");
 	}
-
-	PCFreq = double(li.QuadPart) / 1000000.0;
 }
 
 PerfTimer::PerfTimer(const char* function)
 {
 	functionName = function;
-	LARGE_INTEGER li;
-	QueryPerformanceCounter(&li);
-	startTime = li.QuadPart;
+	startTime = GetNanoSeconds();
 }
 
 double PerfTimer::Current()
 {
-	LARGE_INTEGER li;
-	QueryPerformanceCounter(&li);
-	return double(li.QuadPart - startTime) / PCFreq;
+	return double(GetNanoSeconds() - startTime);
 }
 
 PerfTimer::~PerfTimer()
 {
 	Debug::console("PERFORMANCE: %s took %lf nanoseconds\n", functionName, Current());
-}
\ No newline at end of file
+}
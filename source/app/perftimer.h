@@ -1,23 +1,23 @@
 #ifndef PERFTIMER_H
 #define PERFTIMER_H
 
-#include <windows.h>
 #include <SDL/SDL.h>
 
 class PerfTimer
 {
 public:
+	// Checks the clock is usable, logging its resolution and overhead
 	static void Init();
 
 	PerfTimer(const char* function);
 	~PerfTimer();
 
+	// Nanoseconds since the timer was made
 	double Current();
 
 private:
-	static double PCFreq;
-	Sint64 startTime;
+	Uint64 startTime;
 	const char* functionName;
 };
 
-#endif
\ No newline at end of file
+#endif
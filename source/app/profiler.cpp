@@ -0,0 +1,175 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "clock.h"
+#include "debug.h"
+
+// How many finished zones each thread remembers
+const Uint32 PROFILER_RING_SIZE = 1 << 16;
+
+// Zones nested deeper than this still balance out, they just don't get recorded
+const int PROFILER_MAX_DEPTH = 32;
+
+struct ProfileEvent
+{
+    const char* name;
+    Uint64 start;
+    Uint64 end;
+};
+
+struct ThreadProfile
+{
+    ThreadProfile()
+        : name(NULL), id(0), events(NULL), count(0), depth(0)
+    {}
+
+    const char* name;
+    int id;
+
+    // Only allocated once the thread records something, so threads that never get profiled cost nothing
+    ProfileEvent* events;
+
+    // Every zone ever recorded, the ring position is this wrapped around the ring size
+    Uint32 count;
+
+    // The zones that are still open
+    int depth;
+    const char* openNames[PROFILER_MAX_DEPTH];
+    Uint64 openStarts[PROFILER_MAX_DEPTH];
+};
+
+std::atomic<bool> Profiler::enabledFlag(false);
+
+// Thread profiles live for the rest of the program so the trace can still be written after their threads are gone
+static std::mutex threadsLock;
+static std::vector<ThreadProfile*> threadProfiles;
+static thread_local ThreadProfile* currentProfile = NULL;
+
+static ThreadProfile* GetThreadProfile()
+{
+    if (!currentProfile)
+    {
+        currentProfile = new ThreadProfile();
+
+        std::lock_guard<std::mutex> guard(threadsLock);
+        currentProfile->id = (int)threadProfiles.size();
+        threadProfiles.push_back(currentProfile);
+    }
+
+    return currentProfile;
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+    enabledFlag = enabled;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    GetThreadProfile()->name = name;
+}
+
+void Profiler::BeginZone(const char* name)
+{
+    ThreadProfile* profile = GetThreadProfile();
+    if (profile->depth < PROFILER_MAX_DEPTH)
+    {
+        profile->openNames[profile->depth] = name;
+        profile->openStarts[profile->depth] = GetNanoSeconds();
+    }
+
+    ++profile->depth;
+}
+
+void Profiler::EndZone()
+{
+    ThreadProfile* profile = GetThreadProfile();
+    --profile->depth;
+    if (profile->depth < 0 || profile->depth >= PROFILER_MAX_DEPTH)
+    {
+        profile->depth = SDL_max(profile->depth, 0);
+        return;
+    }
+
+    if (!profile->events)
+    {
+        profile->events = new ProfileEvent[PROFILER_RING_SIZE];
+    }
+
+    ProfileEvent& event = profile->events[profile->count % PROFILER_RING_SIZE];
+    event.name = profile->openNames[profile->depth];
+    event.start = profile->openStarts[profile->depth];
+    event.end = GetNanoSeconds();
+    ++profile->count;
+}
+
+bool Profiler::WriteChromeTrace(const char* filename)
+{
+    FILE* file = fopen(filename, "w");
+    if (!file)
+    {
+        Debug::console("Unable to write trace %s\n", filename);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(threadsLock);
+
+    // Times are written in microseconds from the oldest zone we still have
+    Uint64 base = 0;
+    bool hasBase = false;
+    for (size_t i = 0; i < threadProfiles.size(); ++i)
+    {
+        ThreadProfile* profile = threadProfiles[i];
+        Uint32 first = profile->count > PROFILER_RING_SIZE ? profile->count - PROFILER_RING_SIZE : 0;
+        for (Uint32 e = first; e < profile->count; ++e)
+        {
+            Uint64 start = profile->events[e % PROFILER_RING_SIZE].start;
+            if (!hasBase || start < base)
+            {
+                base = start;
+                hasBase = true;
+            }
+        }
+    }
+
+    // The clock counts nanoseconds and the trace wants microseconds
+    const double toMicroseconds = 0.001;
+    bool firstEvent = true;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < threadProfiles.size(); ++i)
+    {
+        ThreadProfile* profile = threadProfiles[i];
+        if (profile->name)
+        {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                firstEvent ? "" : ",\n", profile->id, profile->name);
+            firstEvent = false;
+        }
+
+        Uint32 first = profile->count > PROFILER_RING_SIZE ? profile->count - PROFILER_RING_SIZE : 0;
+        for (Uint32 e = first; e < profile->count; ++e)
+        {
+            const ProfileEvent& event = profile->events[e % PROFILER_RING_SIZE];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                firstEvent ? "" : ",\n", event.name, profile->id,
+                (event.start - base) * toMicroseconds, (event.end - event.start) * toMicroseconds);
+            firstEvent = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    fclose(file);
+    return true;
+}
+
+void Profiler::Reset()
+{
+    std::lock_guard<std::mutex> guard(threadsLock);
+    for (size_t i = 0; i < threadProfiles.size(); ++i)
+    {
+        threadProfiles[i]->count = 0;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <SDL/SDL.h>
+#include <atomic>
+
+// Set this to 0 to compile every zone out completely
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// A frame profiler built out of nested zones. Each thread records the zones it finishes into its own ring buffer,
+// so recording never takes a lock and the oldest zones just get written over. When profiling is switched off
+// a zone costs one check of a flag
+namespace Profiler
+{
+    // Only touched through SetEnabled and Enabled, it lives out here so a zone's check inlines to one relaxed load
+    extern std::atomic<bool> enabledFlag;
+
+    void SetEnabled(bool enabled);
+    inline bool Enabled() { return PROFILER_ENABLED && enabledFlag.load(std::memory_order_relaxed); }
+
+    // Names the calling thread in the exported trace
+    void SetThreadName(const char* name);
+
+    // The name has to stay around until the trace is written, so string literals are the way to go
+    void BeginZone(const char* name);
+    void EndZone();
+
+    // Writes whatever is still in the ring buffers out as Chrome trace event JSON, which can be loaded in
+    // about:tracing or Perfetto. Nothing should be recording while this runs, so call it in between frames
+    bool WriteChromeTrace(const char* filename);
+
+    // Throws away everything recorded so far
+    void Reset();
+}
+
+// Records the time from construction until it goes out of scope
+class ProfileZone
+{
+public:
+    ProfileZone(const char* name)
+        : active(Profiler::Enabled())
+    {
+        if (active)
+        {
+            Profiler::BeginZone(name);
+        }
+    }
+
+    ~ProfileZone()
+    {
+        if (active)
+        {
+            Profiler::EndZone();
+        }
+    }
+
+private:
+    bool active;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+#include "binner.h"
+#include <math.h>
+#include "../../jobs.h"
+#include "../../profiler.h"
+
+// How many triangles one binning job looks at
+const int BIN_BATCH_SIZE = 512;
+
+TileBinner::TileBinner()
+    : screenWidth(0), screenHeight(0), binsX(0), binsY(0), batchCount(0)
+{
+}
+
+void TileBinner::Reset(int _screenWidth, int _screenHeight, int triangleCount)
+{
+    screenWidth = _screenWidth;
+    screenHeight = _screenHeight;
+    binsX = (screenWidth + BIN_SIZE - 1) / BIN_SIZE;
+    binsY = (screenHeight + BIN_SIZE - 1) / BIN_SIZE;
+
+    triangles.resize(triangleCount);
+    batchCount = (triangleCount + BIN_BATCH_SIZE - 1) / BIN_BATCH_SIZE;
+
+    // The lists keep their memory from frame to frame, they just get emptied when they're binned into again
+    binLists.resize(batchCount * binsX * binsY);
+}
+
+void TileBinner::Bin(RenderStats& stats)
+{
+    int binCount = binsX * binsY;
+    batchStats.resize(batchCount);
+
+    Jobs::ParallelFor(batchCount, 1, [this, binCount](int start, int end)
+    {
+        PROFILE_ZONE("Bin");
+        for (int batch = start; batch < end; ++batch)
+        {
+            std::vector<int>* lists = &binLists[batch * binCount];
+            for (int i = 0; i < binCount; ++i)
+            {
+                lists[i].clear();
+            }
+
+            RenderStats& counts = batchStats[batch];
+            counts.Reset();
+
+            int first = batch * BIN_BATCH_SIZE;
+            int last = SDL_min(first + BIN_BATCH_SIZE, (int)triangles.size());
+            for (int i = first; i < last; ++i)
+            {
+                const ScreenTriangle& triangle = triangles[i];
+                const Vector3& p1 = triangle.v1.position;
+                const Vector3& p2 = triangle.v2.position;
+                const Vector3& p3 = triangle.v3.position;
+
+                // The bounding box is rounded outwards so it always holds every pixel the rasterizer could touch
+                int left = (int)floorf(SDL_min(p1.x, SDL_min(p2.x, p3.x)));
+                int right = (int)ceilf(SDL_max(p1.x, SDL_max(p2.x, p3.x)));
+                int top = (int)floorf(SDL_min(p1.y, SDL_min(p2.y, p3.y)));
+                int bottom = (int)ceilf(SDL_max(p1.y, SDL_max(p2.y, p3.y)));
+
+                if (right < 0 || bottom < 0 || left >= screenWidth || top >= screenHeight)
+                {
+                    ++counts.trianglesCulled;
+                    continue;
+                }
+
+                ++counts.trianglesRasterized;
+                if (left < 0 || top < 0 || right >= screenWidth || bottom >= screenHeight)
+                {
+                    ++counts.trianglesClipped;
+                }
+
+                int firstBinX = SDL_max(left, 0) / BIN_SIZE;
+                int lastBinX = SDL_min(right, screenWidth - 1) / BIN_SIZE;
+                int firstBinY = SDL_max(top, 0) / BIN_SIZE;
+                int lastBinY = SDL_min(bottom, screenHeight - 1) / BIN_SIZE;
+
+                for (int binY = firstBinY; binY <= lastBinY; ++binY)
+                {
+                    for (int binX = firstBinX; binX <= lastBinX; ++binX)
+                    {
+                        lists[binX + binY * binsX].push_back(i);
+                    }
+                }
+            }
+        }
+    });
+
+    for (int batch = 0; batch < batchCount; ++batch)
+    {
+        stats.Add(batchStats[batch]);
+    }
+}
+
+void TileBinner::Rasterize(Device* screen, const DrawState& state, RasterizeFunction rasterize, Uint32 firstTriangleId, RenderStats& stats)
+{
+    int binCount = binsX * binsY;
+    binStats.resize(binCount);
+
+    // Bins are a fairly even amount of work so one at a time is plenty fine grained
+    Jobs::ParallelFor(binCount, 1, [&](int start, int end)
+    {
+        PROFILE_ZONE("Raster bins");
+        for (int bin = start; bin < end; ++bin)
+        {
+            int binX = bin % binsX;
+            int binY = bin / binsX;
+            ClipRect clip(binX * BIN_SIZE, binY * BIN_SIZE, (binX + 1) * BIN_SIZE, (binY + 1) * BIN_SIZE);
+
+            RenderStats& counts = binStats[bin];
+            counts.Reset();
+
+            for (int batch = 0; batch < batchCount; ++batch)
+            {
+                const std::vector<int>& list = binLists[batch * binCount + bin];
+                for (size_t i = 0; i < list.size(); ++i)
+                {
+                    const ScreenTriangle& triangle = triangles[list[i]];
+                    rasterize(screen, state, clip, triangle.v1, triangle.v2, triangle.v3, triangle.faceColor, firstTriangleId + list[i], counts);
+                }
+            }
+        }
+    });
+
+    for (int bin = 0; bin < binCount; ++bin)
+    {
+        stats.Add(binStats[bin]);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef RENDERING_BINNER_H
+#define RENDERING_BINNER_H
+
+#include <vector>
+#include "mesh.h"
+#include "rasterizer.h"
+#include "../device.h"
+
+// The screen gets cut into square bins this many pixels wide, and each bin is filled by one thread at a time
+const int BIN_SIZE = 64;
+
+// Bins have to line up with the framebuffer tiles, otherwise two threads could end up sharing a tile
+static_assert(BIN_SIZE % FRAMEBUFFER_TILE_SIZE == 0, "Bins need to be made of whole framebuffer tiles");
+
+// A triangle that's been through the vertex stage and is ready to be filled
+struct ScreenTriangle
+{
+    Vertex v1;
+    Vertex v2;
+    Vertex v3;
+    Color faceColor;
+};
+
+// Sorts triangles into the bins they touch, then fills all the bins in parallel
+// Triangles in a bin are always filled in the order they were added, so the picture comes out
+// exactly the same as filling them one after another
+class TileBinner
+{
+public:
+    TileBinner();
+
+    // Throws out the last set of triangles and makes room for a new set, fill them in with Triangle
+    void Reset(int screenWidth, int screenHeight, int triangleCount);
+
+    ScreenTriangle& Triangle(int i) { return triangles[i]; }
+    int TriangleCount() const { return (int)triangles.size(); }
+
+    // Works out which bins each triangle touches, adding up how many were culled, clipped and kept
+    void Bin(RenderStats& stats);
+
+    // Fills every bin, triangle i gets the id firstTriangleId + i, and the fragment counts get added to stats
+    void Rasterize(Device* screen, const DrawState& state, RasterizeFunction rasterize, Uint32 firstTriangleId, RenderStats& stats);
+
+private:
+    std::vector<ScreenTriangle> triangles;
+
+    int screenWidth;
+    int screenHeight;
+    int binsX;
+    int binsY;
+
+    // Triangles are binned in batches on different threads, every batch keeps its own list per bin
+    // so nothing has to be locked, and reading the batches back in order keeps the triangles in order
+    int batchCount;
+    std::vector<std::vector<int> > binLists;
+
+    // Counts kept per batch and per bin for the same reason, then added up at the end
+    std::vector<RenderStats> batchStats;
+    std::vector<RenderStats> binStats;
+};
+
+#endif
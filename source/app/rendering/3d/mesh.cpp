@@ -1,64 +1,205 @@
 #include "mesh.h"
 #include <fstream>
 #include <sstream>
+#include <stdlib.h>
+#include <math.h>
 #include "..\..\debug.h"
+#include "../../jobs.h"
 
 using namespace std;
 
+// Pulls the position and texture indices out of a face definition like "1/2/3", "1//3" or "1"
+void ReadFaceIndex(const string& facedef, int& position, int& texcoord)
+{
+    position = atoi(facedef.c_str());
+    texcoord = 0;
+
+    size_t slash = facedef.find('/');
+    if (slash != string::npos)
+    {
+        texcoord = atoi(facedef.c_str() + slash + 1);
+    }
+}
+
+// Everything read out of one piece of the file. Faces keep the raw indices from the file since
+// they point at vertices that might be in another piece
+struct ObjChunk
+{
+    ObjChunk() : hasName(false) {}
+
+    string name;
+    bool hasName;
+    vector<Vector3> positions;
+    vector<float> texcoords;
+    vector<int> faceIndices;
+};
+
+static void ReadObjChunk(const string& contents, size_t start, size_t end, ObjChunk& chunk)
+{
+    std::istringstream lines(contents.substr(start, end - start));
+
+    string line;
+    while (getline(lines, line))
+    {
+        string object;
+        std::istringstream iss(line);
+        iss >> object;
+        if (object == "o")
+        {
+            iss >> chunk.name;
+            chunk.hasName = true;
+        }
+        else if (object == "v")
+        {
+            Vector3 temp;
+            iss >> temp.x;
+            iss >> temp.y;
+            iss >> temp.z;
+            chunk.positions.push_back(temp);
+        }
+        else if (object == "vt")
+        {
+            float u = 0.0f;
+            float v = 0.0f;
+            iss >> u;
+            iss >> v;
+            chunk.texcoords.push_back(u);
+            chunk.texcoords.push_back(v);
+        }
+        else if (object == "f")
+        {
+            string facedef[3];
+            iss >> facedef[0];
+            iss >> facedef[1];
+            iss >> facedef[2];
+
+            for (int i = 0; i < 3; ++i)
+            {
+                int position;
+                int texcoord;
+                ReadFaceIndex(facedef[i], position, texcoord);
+                chunk.faceIndices.push_back(position);
+                chunk.faceIndices.push_back(texcoord);
+            }
+        }
+        else
+        {
+            continue;
+        }
+    }
+}
+
+// How much of the file each loading job parses
+const size_t OBJ_CHUNK_SIZE = 64 * 1024;
+
 bool Mesh::ReadTestFormat(string filename)
 {
     ifstream file(filename);
     if (file.is_open())
     {
-        string line;
-        while (getline(file, line))
+        // Pull the whole file in at once, then cut it into pieces on line breaks so each piece can be parsed on its own thread
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        file.close();
+        string contents = buffer.str();
+
+        vector<size_t> chunkStarts;
+        size_t chunkStart = 0;
+        while (chunkStart < contents.size())
         {
-            string object;
-            std::istringstream iss(line);
-            iss >> object;
-            if (object == "o")
+            chunkStarts.push_back(chunkStart);
+            size_t lineEnd = contents.find('\n', SDL_min(chunkStart + OBJ_CHUNK_SIZE, contents.size() - 1));
+            chunkStart = lineEnd == string::npos ? contents.size() : lineEnd + 1;
+        }
+        chunkStarts.push_back(contents.size());
+
+        int chunkCount = (int)chunkStarts.size() - 1;
+        vector<ObjChunk> chunks(chunkCount);
+        Jobs::ParallelFor(chunkCount, 1, [&](int start, int end)
+        {
+            for (int i = start; i < end; ++i)
             {
-                iss >> name;
+                ReadObjChunk(contents, chunkStarts[i], chunkStarts[i + 1], chunks[i]);
             }
-            else if (object == "v")
+        });
+
+        // Stitch the pieces back together in file order
+        vector<float> texcoords;
+        for (int i = 0; i < chunkCount; ++i)
+        {
+            const ObjChunk& chunk = chunks[i];
+            if (chunk.hasName)
             {
-                Vector3 temp;
-                iss >> temp.x;
-                iss >> temp.y;
-                iss >> temp.z;
-                vertices.push_back(temp);
+                name = chunk.name;
             }
-            else if (object == "f")
+
+            for (size_t v = 0; v < chunk.positions.size(); ++v)
             {
-                string facedef;
-                Face temp;
+                vertices.push_back(chunk.positions[v]);
+            }
+
+            texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        }
 
-                iss >> temp.a;
-                iss >> facedef;
+        // Faces go last since they can only be resolved once every vertex is in place
+        int vertexCount = (int)vertices.size();
+        int texcoordCount = (int)texcoords.size() / 2;
+        int skippedFaces = 0;
+        for (int i = 0; i < chunkCount; ++i)
+        {
+            const vector<int>& faceIndices = chunks[i].faceIndices;
+            for (size_t f = 0; f < faceIndices.size(); f += 6)
+            {
+                // The object file index starts at 1. A face pointing at a vertex that isn't there gets left out
+                int indices[3];
+                bool valid = true;
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    indices[corner] = faceIndices[f + corner * 2] - 1;
+                    valid = valid && indices[corner] >= 0 && indices[corner] < vertexCount;
+                }
 
-                iss >> temp.b;
-                iss >> facedef;
+                if (!valid)
+                {
+                    ++skippedFaces;
+                    continue;
+                }
 
-                iss >> temp.c;
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    int texcoord = faceIndices[f + corner * 2 + 1];
 
-                // The object file index starts at 1
-                --temp.a; --temp.b; --temp.c;
+                    // We only have one set of coordinates per vertex, so seams just take the last one we see
+                    if (texcoord > 0 && texcoord <= texcoordCount)
+                    {
+                        vertices[indices[corner]].u = texcoords[(texcoord - 1) * 2];
+                        vertices[indices[corner]].v = texcoords[(texcoord - 1) * 2 + 1];
+                    }
+                }
 
-                faces.push_back(temp);
-            }
-            else
-            {
-                continue;
+                faces.push_back(Face(indices[0], indices[1], indices[2]));
             }
         }
-        file.close();
+
+        if (skippedFaces > 0)
+        {
+            Debug::console("%s has %d faces with vertices that don't exist, they were left out\n", filename.c_str(), skippedFaces);
+        }
+
         CalculateNormals();
+
+        if (texcoords.empty())
+        {
+            CalculateSphericalUVs();
+        }
     }
     else
     {
         Debug::console("Unable to open file %s\n", filename.c_str());
         return false;
     }
+
+    return true;
 }
 
 Vector3 Normal(const Vector3& v1, const Vector3& v2, const Vector3& v3)
@@ -98,3 +239,20 @@ void Mesh::CalculateNormals()
         vertices[i].normal.Normalize();
     }
 }
+
+void Mesh::CalculateSphericalUVs()
+{
+    for (int i = 0; i < vertices.size(); ++i)
+    {
+        Vertex& vertex = vertices[i];
+        Vector3 direction = vertex.position;
+        if (direction.Length() == 0.0f)
+        {
+            continue;
+        }
+
+        direction.Normalize();
+        vertex.u = 0.5f + atan2(direction.z, direction.x) / (2 * (float)M_PI);
+        vertex.v = 0.5f - asin(direction.y) / (float)M_PI;
+    }
+}
@@ -7,20 +7,24 @@
 
 struct Vertex
 {
-    Vertex(){}
+    Vertex() : u(0.0f), v(0.0f) {}
 
-    Vertex(const Vector3& v, Color c = Color(0xFFFFFF))
-        : position(v), color(c)
+    Vertex(const Vector3& pos, Color c = Color(0xFFFFFF))
+        : position(pos), color(c), u(0.0f), v(0.0f)
     {}
 
     Vertex(float _x, float _y, float _z, Color c = Color(0xFFFFFF))
-        : position(_x, _y, _z), color(c)
+        : position(_x, _y, _z), color(c), u(0.0f), v(0.0f)
     {}
 
     Vector3 position;
     Vector3 normal;
     Vector3 worldPosition;
     Color color;
+
+    // Texture coordinates
+    float u;
+    float v;
 };
 
 struct Face
@@ -41,6 +45,10 @@ struct Mesh
     // Will read obj format for now
     bool ReadTestFormat(std::string filename);
     void CalculateNormals();
+
+    // Wraps texture coordinates around the mesh like a globe, for models that don't come with any
+    void CalculateSphericalUVs();
+
     std::vector<Vertex> vertices;
     std::vector<Face> faces;
     Vector3 position;
@@ -0,0 +1,511 @@
+#include "rasterizer.h"
+#include <math.h>
+#include <algorithm>
+#include "../simd.h"
+#include "../../util.h"
+
+// Everything a triangle needs that doesn't change across its surface
+struct TriangleSetup
+{
+    Color faceColor;
+    const Texture* texture;
+
+    // Set when the screen format lets us shade and store a whole group of pixels at once
+    bool wide;
+
+    // Set when the depth buffer is compressed, then the plane is used to test whole depth tiles at once
+    bool compressed;
+    TrianglePlane plane;
+
+    ClipRect clip;
+
+    // Where the fragment counts go
+    RenderStats* stats;
+};
+
+#if RENDERING_AVX2
+// Eight pixels worth of color, each channel kept as floats between 0 and 255 until it's packed
+struct WideColor
+{
+    __m256 r;
+    __m256 g;
+    __m256 b;
+};
+
+WideColor BroadcastColor(const Color& c)
+{
+    WideColor ret;
+    ret.r = _mm256_set1_ps(c.r);
+    ret.g = _mm256_set1_ps(c.g);
+    ret.b = _mm256_set1_ps(c.b);
+    return ret;
+}
+#endif
+
+// Attribute descriptors, each one says how many values get carried across the triangle besides depth,
+// how to pull those values out of a vertex, and how to turn them into a color in the "pixel shader"
+// Count is a compile time constant so the interpolation loops below unroll into straight line code
+struct DepthOnlyAttributes
+{
+    enum { Count = 0, WritesColor = 0 };
+
+    static void Load(const Vertex& vertex, float* values) {}
+    static Color Shade(const float* values, const TriangleSetup& setup) { return setup.faceColor; }
+#if RENDERING_AVX2
+    static WideColor ShadeWide(const __m256* values, const TriangleSetup& setup) { return BroadcastColor(setup.faceColor); }
+#endif
+};
+
+struct FlatAttributes
+{
+    enum { Count = 0, WritesColor = 1 };
+
+    static void Load(const Vertex& vertex, float* values) {}
+    static Color Shade(const float* values, const TriangleSetup& setup) { return setup.faceColor; }
+#if RENDERING_AVX2
+    static WideColor ShadeWide(const __m256* values, const TriangleSetup& setup) { return BroadcastColor(setup.faceColor); }
+#endif
+};
+
+struct GouraudAttributes
+{
+    enum { Count = 3, WritesColor = 1 };
+
+    static void Load(const Vertex& vertex, float* values)
+    {
+        values[0] = vertex.color.r;
+        values[1] = vertex.color.g;
+        values[2] = vertex.color.b;
+    }
+
+    static Color Shade(const float* values, const TriangleSetup& setup)
+    {
+        return Color((Uint8)values[0], (Uint8)values[1], (Uint8)values[2]);
+    }
+
+#if RENDERING_AVX2
+    static WideColor ShadeWide(const __m256* values, const TriangleSetup& setup)
+    {
+        WideColor ret;
+        ret.r = values[0];
+        ret.g = values[1];
+        ret.b = values[2];
+        return ret;
+    }
+#endif
+};
+
+struct TexturedAttributes
+{
+    enum { Count = 2, WritesColor = 1 };
+
+    static void Load(const Vertex& vertex, float* values)
+    {
+        values[0] = vertex.u;
+        values[1] = vertex.v;
+    }
+
+    static Color Shade(const float* values, const TriangleSetup& setup)
+    {
+        Color light = setup.faceColor;
+        return blendMultiply(setup.texture->Sample(values[0], values[1]), light);
+    }
+
+#if RENDERING_AVX2
+    // Texture lookups don't vectorize nicely so we pull the coordinates back out and sample each lane on its own
+    static WideColor ShadeWide(const __m256* values, const TriangleSetup& setup)
+    {
+        float u[SIMD_WIDTH];
+        float v[SIMD_WIDTH];
+        _mm256_storeu_ps(u, values[0]);
+        _mm256_storeu_ps(v, values[1]);
+
+        float r[SIMD_WIDTH];
+        float g[SIMD_WIDTH];
+        float b[SIMD_WIDTH];
+        for (int i = 0; i < SIMD_WIDTH; ++i)
+        {
+            float lane[2] = { u[i], v[i] };
+            Color c = Shade(lane, setup);
+            r[i] = c.r;
+            g[i] = c.g;
+            b[i] = c.b;
+        }
+
+        WideColor ret;
+        ret.r = _mm256_loadu_ps(r);
+        ret.g = _mm256_loadu_ps(g);
+        ret.b = _mm256_loadu_ps(b);
+        return ret;
+    }
+#endif
+};
+
+// A vertex stripped down to just what the descriptor needs, the extra slot keeps the array legal when Count is 0
+template <class Attributes>
+struct RasterVertex
+{
+    void Load(const Vertex& vertex)
+    {
+        x = vertex.position.x;
+        y = vertex.position.y;
+        z = vertex.position.z;
+        Attributes::Load(vertex, values);
+    }
+
+    float x;
+    float y;
+    float z;
+    float values[Attributes::Count + 1];
+};
+
+// Runs the depth test and pixel shader for every pixel in a clipped span, one pixel at a time
+// The values passed in are the ones at startX and the steps are how much they change per pixel
+// Each pixel works its values out from the start rather than adding up steps, so the wide path gets exactly
+// the same depths and two triangles that tie on depth pick the same winner either way
+template <class Attributes, class Depth>
+void ShadeSpan(Device* screen, const TriangleSetup& setup, int y, int startX, int endX,
+    float z, float zStep, const float* values, const float* steps)
+{
+    int written = 0;
+    int x = startX;
+    while (x < endX)
+    {
+        // Compressed depth is handled a tile row at a time since the whole row can pass or fail together
+        int chunkEnd = endX;
+        DepthTileVerdict verdict = DEPTH_TEST_PIXELS;
+        if (setup.compressed)
+        {
+            chunkEnd = SDL_min((x | (DEPTH_TILE_SIZE - 1)) + 1, endX);
+            verdict = screen->ClassifyDepthTile<Depth>(x / DEPTH_TILE_SIZE, y / DEPTH_TILE_SIZE, setup.plane);
+        }
+
+        for (; x < chunkEnd; ++x)
+        {
+            float offset = (float)(x - startX);
+            bool visible = verdict == DEPTH_PASS_ALL || (verdict == DEPTH_TEST_PIXELS && screen->TestDepth<Depth>(x, y, z + zStep * offset));
+            written += visible;
+            if (visible && Attributes::WritesColor)
+            {
+                float pixelValues[Attributes::Count + 1];
+                for (int i = 0; i < Attributes::Count; ++i)
+                {
+                    pixelValues[i] = values[i] + steps[i] * offset;
+                }
+
+                screen->PutPixel(x, y, Attributes::Shade(pixelValues, setup));
+            }
+        }
+    }
+
+    setup.stats->fragmentsWritten += written;
+}
+
+#if RENDERING_AVX2
+// Packs the shaded channels into the screen format, clamping first so stray lanes can't bleed into other channels
+__m256i PackColor(const WideColor& c, const SDL_PixelFormat* format)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 full = _mm256_set1_ps(255.0f);
+
+    __m256i r = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(c.r, zero), full));
+    __m256i g = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(c.g, zero), full));
+    __m256i b = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(c.b, zero), full));
+
+    __m256i packed = _mm256_set1_epi32(format->Amask);
+    packed = _mm256_or_si256(packed, _mm256_sll_epi32(r, _mm_cvtsi32_si128(format->Rshift)));
+    packed = _mm256_or_si256(packed, _mm256_sll_epi32(g, _mm_cvtsi32_si128(format->Gshift)));
+    packed = _mm256_or_si256(packed, _mm256_sll_epi32(b, _mm_cvtsi32_si128(format->Bshift)));
+    return packed;
+}
+
+static_assert(SIMD_WIDTH == DEPTH_TILE_SIZE, "Pixel groups need to line up with compressed depth tiles");
+static_assert(SIMD_WIDTH == FRAMEBUFFER_TILE_SIZE, "Pixel groups need to fill a framebuffer tile row");
+
+// The same as ShadeSpan but eight pixels at a time. Groups are lined up on multiples of eight, and a coverage mask
+// turns off the lanes that hang off either end of the span. The depth test, interpolation, packing and
+// the stores are all done for the whole group, using masked loads and stores so we never touch pixels outside the span
+template <class Attributes, class Depth>
+void ShadeSpanWide(Device* screen, const TriangleSetup& setup, int y, int startX, int endX,
+    float z, float zStep, const float* values, const float* steps)
+{
+    const SDL_PixelFormat* format = screen->Format();
+
+    // Back the starting values up to the first lane of the group startX falls in
+    int groupX = startX & ~(SIMD_WIDTH - 1);
+
+    // Each group is one row of a framebuffer tile, and the same row of the next tile is a whole tile further along
+    const int groupStride = FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+    int groupIndex = screen->PixelIndex(groupX, y);
+    Uint32* colorGroup = screen->ColorBuffer() + groupIndex;
+    typename Depth::Stored* depthGroup = screen->DepthBuffer<Depth>() + groupIndex;
+
+    // How far each lane is from startX, kept as floats since they're whole numbers and stay exact.
+    // Values are worked out from those the same way ShadeSpan does it, so both paths come out bit for bit the same
+    const __m256 groupStep = _mm256_set1_ps((float)SIMD_WIDTH);
+    const __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 offsets = _mm256_add_ps(_mm256_set1_ps((float)(groupX - startX)), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+
+    const __m256 zStart = _mm256_set1_ps(z);
+    const __m256 zSteps = _mm256_set1_ps(zStep);
+
+    __m256 valueStarts[Attributes::Count + 1];
+    __m256 valueSteps[Attributes::Count + 1];
+    for (int i = 0; i < Attributes::Count; ++i)
+    {
+        valueStarts[i] = _mm256_set1_ps(values[i]);
+        valueSteps[i] = _mm256_set1_ps(steps[i]);
+    }
+
+    const __m256i firstCovered = _mm256_set1_epi32(startX - 1);
+    const __m256i pastCovered = _mm256_set1_epi32(endX);
+
+    for (; groupX < endX; groupX += SIMD_WIDTH)
+    {
+        // Work out which lanes are actually inside the span
+        __m256i x = _mm256_add_epi32(_mm256_set1_epi32(groupX), laneIndices);
+        __m256i covered = _mm256_and_si256(_mm256_cmpgt_epi32(x, firstCovered), _mm256_cmpgt_epi32(pastCovered, x));
+
+        // Depth test, this also writes the depths that pass. Groups line up exactly with compressed depth tile rows
+        // so the tile can let the whole group through or throw it away without looking at any per pixel values
+        __m256i pass = covered;
+        DepthTileVerdict verdict = DEPTH_TEST_PIXELS;
+        if (setup.compressed)
+        {
+            verdict = screen->ClassifyDepthTile<Depth>(groupX / DEPTH_TILE_SIZE, y / DEPTH_TILE_SIZE, setup.plane);
+        }
+
+        if (verdict == DEPTH_TEST_PIXELS)
+        {
+            pass = Depth::TestWide(depthGroup, _mm256_add_ps(zStart, _mm256_mul_ps(zSteps, offsets)), covered);
+        }
+        else if (verdict == DEPTH_FAIL_ALL)
+        {
+            pass = _mm256_setzero_si256();
+        }
+
+        setup.stats->fragmentsWritten += _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(pass)));
+        if (Attributes::WritesColor && !_mm256_testz_si256(pass, pass))
+        {
+            __m256 valueLanes[Attributes::Count + 1];
+            for (int i = 0; i < Attributes::Count; ++i)
+            {
+                valueLanes[i] = _mm256_add_ps(valueStarts[i], _mm256_mul_ps(valueSteps[i], offsets));
+            }
+
+            __m256i packed = PackColor(Attributes::ShadeWide(valueLanes, setup), format);
+            _mm256_maskstore_epi32((int*)colorGroup, pass, packed);
+        }
+
+        colorGroup += groupStride;
+        depthGroup += groupStride;
+        offsets = _mm256_add_ps(offsets, groupStep);
+    }
+}
+#endif
+
+// This function draws a scanline between four vertices that are sorted along the y axis
+// It uses multiple lerps to find the values at each end of the line, then steps across it adding a fixed
+// amount per pixel. In hardware terms, this would set up and call your pixel shader
+template <class Attributes, class Depth>
+void DrawScanline(Device* screen, const TriangleSetup& setup, int y,
+    const RasterVertex<Attributes>& va, const RasterVertex<Attributes>& vb,
+    const RasterVertex<Attributes>& vc, const RasterVertex<Attributes>& vd)
+{
+    // A and B form a line, C and D form a line
+    // We then find out what percentage of the way we are vertically along each line given the y value
+    float gradientLeft = va.y != vb.y ? (y - va.y) / (vb.y - va.y) : 1;
+    float gradientRight = vc.y != vd.y ? (y - vc.y) / (vd.y - vc.y) : 1;
+
+    int startX = (int)lerp(va.x, vb.x, gradientLeft);
+    int endX = (int)lerp(vc.x, vd.x, gradientRight);
+
+    float z1 = lerp(va.z, vb.z, gradientLeft);
+    float z2 = lerp(vc.z, vd.z, gradientRight);
+
+    float start[Attributes::Count + 1];
+    float end[Attributes::Count + 1];
+    for (int i = 0; i < Attributes::Count; ++i)
+    {
+        start[i] = lerp(va.values[i], vb.values[i], gradientLeft);
+        end[i] = lerp(vc.values[i], vd.values[i], gradientRight);
+    }
+
+    // This makes sure we're drawing left to right
+    if (startX > endX)
+    {
+        std::swap(startX, endX);
+        std::swap(z1, z2);
+        for (int i = 0; i < Attributes::Count; ++i)
+        {
+            std::swap(start[i], end[i]);
+        }
+    }
+
+    if (startX == endX)
+    {
+        return;
+    }
+
+    // Rather than lerping every pixel we work out how much each value changes per pixel once, then each pixel is
+    // the span start plus that step times how far along it is, so the wide and scalar depths match bit for bit
+    float invWidth = 1.0f / (endX - startX);
+    float zStep = (z2 - z1) * invWidth;
+    float steps[Attributes::Count + 1];
+    for (int i = 0; i < Attributes::Count; ++i)
+    {
+        steps[i] = (end[i] - start[i]) * invWidth;
+    }
+
+    // Clip against the viewport once for the whole line instead of every pixel
+    int clipStart = SDL_max(startX, setup.clip.left);
+    int clipEnd = SDL_min(endX, setup.clip.right);
+    if (clipStart >= clipEnd)
+    {
+        return;
+    }
+
+    setup.stats->fragmentsGenerated += clipEnd - clipStart;
+    float skipped = (float)(clipStart - startX);
+
+    float z = z1 + zStep * skipped;
+    float values[Attributes::Count + 1];
+    for (int i = 0; i < Attributes::Count; ++i)
+    {
+        values[i] = start[i] + steps[i] * skipped;
+    }
+
+#if RENDERING_AVX2
+    if (setup.wide)
+    {
+        ShadeSpanWide<Attributes, Depth>(screen, setup, y, clipStart, clipEnd, z, zStep, values, steps);
+        return;
+    }
+#endif
+
+    ShadeSpan<Attributes, Depth>(screen, setup, y, clipStart, clipEnd, z, zStep, values, steps);
+}
+
+// determine on which side of a 2D line a 2D point is
+// returns positive values for "right", negative values for "left", and zero if point is on line
+template <class Attributes>
+float VertexDirection(const RasterVertex<Attributes>& p, const RasterVertex<Attributes>& start, const RasterVertex<Attributes>& end)
+{
+    return (p.x - start.x) * (end.y - start.y) - (end.x - start.x) * (p.y - start.y);
+}
+
+// Draws the whole triangle using interpolation rather than splitting it into a top half and bottom half
+template <class Attributes, class Depth>
+void FillTriangle(Device* screen, const DrawState& state, const ClipRect& clip,
+    const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, Color faceColor, Uint32 triangleId, RenderStats& stats)
+{
+    TriangleSetup setup;
+    setup.stats = &stats;
+    setup.faceColor = faceColor;
+    setup.texture = state.texture;
+    setup.wide = RENDERING_AVX2 && state.simd && screen->HasPackedFormat();
+    setup.compressed = screen->DepthCompression();
+    setup.clip.left = SDL_max(clip.left, 0);
+    setup.clip.top = SDL_max(clip.top, 0);
+    setup.clip.right = SDL_min(clip.right, screen->Width());
+    setup.clip.bottom = SDL_min(clip.bottom, screen->Height());
+    if (setup.compressed)
+    {
+        setup.plane.Setup(
+            vertex1.position.x, vertex1.position.y, vertex1.position.z,
+            vertex2.position.x, vertex2.position.y, vertex2.position.z,
+            vertex3.position.x, vertex3.position.y, vertex3.position.z,
+            triangleId);
+    }
+
+    RasterVertex<Attributes> v1;
+    RasterVertex<Attributes> v2;
+    RasterVertex<Attributes> v3;
+    v1.Load(vertex1);
+    v2.Load(vertex2);
+    v3.Load(vertex3);
+
+    // First we need to vertically sort the vertices so v1 is on top
+    if (v2.y > v3.y)
+    {
+        std::swap(v2, v3);
+    }
+
+    if (v1.y > v2.y)
+    {
+        std::swap(v1, v2);
+    }
+
+    if (v2.y > v3.y)
+    {
+        std::swap(v2, v3);
+    }
+
+    // Rows outside of the clip rect will never draw anything so don't bother visiting them
+    int startY = SDL_max((int)v1.y, setup.clip.top);
+    int endY = SDL_min((int)v3.y, setup.clip.bottom - 1);
+
+    // The tiles under the triangle's bounds get marked so clears and presents know they changed, a few
+    // of them might not have been touched but going tile by tile it hardly matters
+    int left = SDL_max((int)floorf(SDL_min(v1.x, SDL_min(v2.x, v3.x))), setup.clip.left);
+    int right = SDL_min((int)ceilf(SDL_max(v1.x, SDL_max(v2.x, v3.x))), setup.clip.right - 1);
+    if (startY > endY || left > right)
+    {
+        return;
+    }
+    screen->MarkDirty(left, startY, right, endY);
+
+    // We draw a right facing triangle one way
+    if (VertexDirection(v2, v1, v3) > 0)
+    {
+        for (int y = startY; y <= endY; y++)
+        {
+            if (y < v2.y)
+            {
+                DrawScanline<Attributes, Depth>(screen, setup, y, v1, v3, v1, v2);
+            }
+            else
+            {
+                DrawScanline<Attributes, Depth>(screen, setup, y, v1, v3, v2, v3);
+            }
+        }
+    }
+    // and a left facing triangle the opposite way
+    else
+    {
+        for (int y = startY; y <= endY; y++)
+        {
+            if (y < v2.y)
+            {
+                DrawScanline<Attributes, Depth>(screen, setup, y, v1, v2, v1, v3);
+            }
+            else
+            {
+                DrawScanline<Attributes, Depth>(screen, setup, y, v2, v3, v1, v3);
+            }
+        }
+    }
+}
+
+// Every combination of attributes and depth format gets its own loop, indexed by ShadeMode then DepthFormat
+// so keep these in the same order as the enums
+#define RASTERIZERS_FOR(Attributes) \
+    { \
+        FillTriangle<Attributes, DepthFloat32>, \
+        FillTriangle<Attributes, DepthFloat32Reversed>, \
+        FillTriangle<Attributes, DepthUnorm16>, \
+        FillTriangle<Attributes, DepthUnorm24> \
+    }
+
+static const RasterizeFunction rasterizers[SHADE_MODE_COUNT][DEPTH_FORMAT_COUNT] =
+{
+    RASTERIZERS_FOR(DepthOnlyAttributes),
+    RASTERIZERS_FOR(FlatAttributes),
+    RASTERIZERS_FOR(GouraudAttributes),
+    RASTERIZERS_FOR(TexturedAttributes)
+};
+
+RasterizeFunction GetRasterizer(ShadeMode mode, DepthFormat depthFormat)
+{
+    return rasterizers[mode][depthFormat];
+}
@@ -0,0 +1,66 @@
+#ifndef RENDERING_RASTERIZER_H
+#define RENDERING_RASTERIZER_H
+
+#include "mesh.h"
+#include "../device.h"
+#include "../color.h"
+#include "../texture.h"
+#include "../stats.h"
+
+// The different ways we know how to fill in a triangle. Each one gets compiled into its own
+// rasterizer loop that only interpolates the attributes it actually uses
+enum ShadeMode
+{
+    SHADE_DEPTH_ONLY,
+    SHADE_FLAT,
+    SHADE_GOURAUD,
+    SHADE_TEXTURED,
+    SHADE_MODE_COUNT
+};
+
+// Everything that stays the same for every triangle in a draw call
+struct DrawState
+{
+    DrawState()
+        : mode(SHADE_GOURAUD), texture(NULL), simd(true)
+    {}
+
+    ShadeMode mode;
+
+    // Only read when the mode is SHADE_TEXTURED
+    const Texture* texture;
+
+    // Lets the wide rasterizer loops be switched off, mostly so we can check they match the plain ones
+    bool simd;
+};
+
+// The part of the screen a rasterizer call is allowed to touch, right and bottom are one past the last pixel
+// Separate rectangles can be filled at the same time from different threads
+struct ClipRect
+{
+    ClipRect()
+        : left(0), top(0), right(0), bottom(0)
+    {}
+
+    ClipRect(int _left, int _top, int _right, int _bottom)
+        : left(_left), top(_top), right(_right), bottom(_bottom)
+    {}
+
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+// Fills the part of a triangle inside the clip rect, its vertices already projected onto the screen. The face color is used for
+// flat shading and to light textures, gouraud shading uses the vertex colors instead
+// The id has to be unique to the triangle for the frame, and the same every time it's drawn into a different rect
+// The fragment counts get added to stats, which should only be shared by calls on the same thread
+typedef void (*RasterizeFunction)(Device* screen, const DrawState& state, const ClipRect& clip,
+    const Vertex& v1, const Vertex& v2, const Vertex& v3, Color faceColor, Uint32 triangleId, RenderStats& stats);
+
+// Looks up the rasterizer variant for the given mode and depth buffer format
+// This should be done once per draw rather than per triangle
+RasterizeFunction GetRasterizer(ShadeMode mode, DepthFormat depthFormat);
+
+#endif
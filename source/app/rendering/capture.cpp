@@ -0,0 +1,139 @@
+#include "capture.h"
+#include <string.h>
+#include "image.h"
+#include "../debug.h"
+#include "../profiler.h"
+
+FrameCapture::FrameCapture(int bufferCount, CapturePolicy _policy)
+    : policy(_policy), format(IMAGE_TIFF), quitting(false), busy(false), written(0), dropped(0)
+{
+    // The buffers only get sized once the first frame comes in, so an unused capture costs nothing
+    for (int i = 0; i < bufferCount; ++i)
+    {
+        frames.push_back(new CaptureFrame());
+        freeFrames.push_back(frames.back());
+    }
+
+    writer = std::thread(&FrameCapture::WriterLoop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    Flush();
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quitting = true;
+    }
+    signal.notify_all();
+    writer.join();
+
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        delete frames[i];
+    }
+}
+
+bool FrameCapture::Capture(Device* device, const char* filename)
+{
+    PROFILE_ZONE("Capture");
+
+    CaptureFrame* frame = NULL;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (freeFrames.empty())
+        {
+            if (policy == CAPTURE_DROP)
+            {
+                ++dropped;
+                return false;
+            }
+
+            signal.wait(guard, [this]() { return !freeFrames.empty(); });
+        }
+
+        frame = freeFrames.back();
+        freeFrames.pop_back();
+    }
+
+    // The buffer is still in tiles, copying it as is keeps the time spent here down to a memcpy
+    frame->pixels.resize(device->ColorBufferSize());
+    memcpy(&frame->pixels[0], device->ColorBuffer(), device->ColorBufferSize() * sizeof(Uint32));
+    frame->width = device->Width();
+    frame->height = device->Height();
+    frame->pixelFormat = device->Format();
+    frame->format = format;
+    SDL_strlcpy(frame->filename, filename ? filename : "", sizeof(frame->filename));
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(frame);
+    }
+    signal.notify_all();
+    return true;
+}
+
+bool FrameCapture::OpenStream(const char* filename, VideoFormat streamFormat, int width, int height, int framesPerSecond)
+{
+    Flush();
+    return stream.Open(filename, streamFormat, width, height, framesPerSecond);
+}
+
+void FrameCapture::CloseStream()
+{
+    Flush();
+    stream.Close();
+}
+
+void FrameCapture::Flush()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    signal.wait(guard, [this]() { return queue.empty() && !busy; });
+}
+
+void FrameCapture::WriterLoop()
+{
+    Profiler::SetThreadName("Capture");
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        signal.wait(guard, [this]() { return !queue.empty() || quitting; });
+        if (queue.empty())
+        {
+            break;
+        }
+
+        CaptureFrame* frame = queue.front();
+        queue.pop_front();
+        busy = true;
+        guard.unlock();
+
+        {
+            PROFILE_ZONE("Write capture");
+            if (!frame->filename[0])
+            {
+                if (!stream.WriteFrame(&frame->pixels[0], frame->width, frame->height, frame->pixelFormat))
+                {
+                    Debug::console("Unable to append a frame to the capture stream\n");
+                }
+            }
+            else
+            {
+                frame->rgb.resize(frame->width * frame->height * 3);
+                Device::TiledToRgb(&frame->pixels[0], frame->width, 0, frame->height, frame->pixelFormat, &frame->rgb[0]);
+                if (!WriteImage(frame->filename, &frame->rgb[0], frame->width, frame->height, frame->format))
+                {
+                    Debug::console("Unable to write capture %s\n", frame->filename);
+                }
+            }
+        }
+
+        ++written;
+
+        guard.lock();
+        busy = false;
+        freeFrames.push_back(frame);
+        signal.notify_all();
+    }
+}
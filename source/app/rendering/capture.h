@@ -0,0 +1,93 @@
+#ifndef RENDERING_CAPTURE_H
+#define RENDERING_CAPTURE_H
+
+#include <SDL/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "device.h"
+#include "image.h"
+#include "video.h"
+
+// What to do with a new frame when every buffer is still waiting to be written
+enum CapturePolicy
+{
+    // Hold up the caller until the writer frees a buffer, every frame makes it out
+    CAPTURE_WAIT,
+
+    // Skip the frame, rendering carries on at full speed and the gaps show up in FramesDropped
+    CAPTURE_DROP
+};
+
+// Writes frames out to files on a thread of its own. Capturing only copies the color buffer into one of a
+// fixed set of buffers, the writer turns it into rgb and writes it, so a long capture barely slows the frames down
+// The buffers are the limit on how far behind the writer can get, and they're reused rather than allocated every frame
+class FrameCapture
+{
+public:
+    FrameCapture(int bufferCount = 4, CapturePolicy policy = CAPTURE_WAIT);
+    ~FrameCapture();
+
+    // Queues the device's current frame to be written in the current format. Returns false if it was dropped
+    // With a stream open, a NULL filename appends the frame to the stream instead
+    bool Capture(Device* device, const char* filename);
+
+    // Waits for every queued frame to be written
+    void Flush();
+
+    void SetPolicy(CapturePolicy _policy) { policy = _policy; }
+    CapturePolicy Policy() const { return policy; }
+
+    // Compressing happens on the writer too, so a smaller format costs the frames nothing and cuts down what goes to disk
+    void SetFormat(ImageFormat _format) { format = _format; }
+    ImageFormat Format() const { return format; }
+
+    // Opens a stream for frames to be appended to, see VideoStream. Opening and closing wait for queued frames first
+    bool OpenStream(const char* filename, VideoFormat format, int width, int height, int framesPerSecond);
+    void CloseStream();
+    bool Streaming() const { return stream.IsOpen(); }
+
+    Uint32 FramesWritten() const { return written; }
+    Uint32 FramesDropped() const { return dropped; }
+
+private:
+    struct CaptureFrame
+    {
+        std::vector<Uint32> pixels;
+        std::vector<Uint8> rgb;
+        int width;
+        int height;
+        const SDL_PixelFormat* pixelFormat;
+        ImageFormat format;
+
+        // Empty for frames going to the stream
+        char filename[256];
+    };
+
+    void WriterLoop();
+
+    std::vector<CaptureFrame*> frames;
+    std::vector<CaptureFrame*> freeFrames;
+    std::deque<CaptureFrame*> queue;
+    CapturePolicy policy;
+    ImageFormat format;
+
+    // Only the writer touches this while frames are queued
+    VideoStream stream;
+
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable signal;
+    bool quitting;
+
+    // Set while the writer has a frame that's off the queue but not written yet
+    bool busy;
+
+    std::atomic<Uint32> written;
+    std::atomic<Uint32> dropped;
+};
+
+#endif
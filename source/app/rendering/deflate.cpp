@@ -0,0 +1,264 @@
+#include "deflate.h"
+#include <string.h>
+
+Uint32 Adler32(Uint32 adler, const Uint8* data, size_t size)
+{
+    const Uint32 BASE = 65521;
+    Uint32 a = adler & 0xFFFF;
+    Uint32 b = adler >> 16;
+
+    // The sums can go this many bytes before they could overflow and need wrapping
+    const size_t NMAX = 5552;
+    while (size > 0)
+    {
+        size_t chunk = SDL_min(size, NMAX);
+        size -= chunk;
+        while (chunk--)
+        {
+            a += *data++;
+            b += a;
+        }
+
+        a %= BASE;
+        b %= BASE;
+    }
+
+    return a | (b << 16);
+}
+
+Uint32 Adler32Combine(Uint32 first, Uint32 second, size_t secondSize)
+{
+    const Uint32 BASE = 65521;
+    Uint32 remainder = (Uint32)(secondSize % BASE);
+    Uint32 a = first & 0xFFFF;
+    Uint32 b = (Uint32)(((Uint64)remainder * a) % BASE);
+    a += (second & 0xFFFF) + BASE - 1;
+    b += (first >> 16) + (second >> 16) + BASE - remainder;
+
+    if (a >= BASE) a -= BASE;
+    if (a >= BASE) a -= BASE;
+    if (b >= BASE << 1) b -= BASE << 1;
+    if (b >= BASE) b -= BASE;
+    return a | (b << 16);
+}
+
+struct CrcTable
+{
+    CrcTable()
+    {
+        for (Uint32 n = 0; n < 256; ++n)
+        {
+            Uint32 c = n;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            values[n] = c;
+        }
+    }
+
+    Uint32 values[256];
+};
+
+static const CrcTable crcTable;
+
+Uint32 Crc32(Uint32 crc, const Uint8* data, size_t size)
+{
+    crc = ~crc;
+    while (size--)
+    {
+        crc = crcTable.values[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Deflate writes its bits starting from the lowest bit of each byte
+struct BitWriter
+{
+    BitWriter(std::vector<Uint8>& _out)
+        : out(_out), bits(0), count(0)
+    {}
+
+    void Put(Uint32 value, int length)
+    {
+        bits |= (Uint64)value << count;
+        count += length;
+        while (count >= 8)
+        {
+            out.push_back((Uint8)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void Align()
+    {
+        if (count > 0)
+        {
+            out.push_back((Uint8)bits);
+        }
+        bits = 0;
+        count = 0;
+    }
+
+    std::vector<Uint8>& out;
+    Uint64 bits;
+    int count;
+};
+
+static const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// The fixed huffman codes with their bits already reversed, since huffman codes go out highest bit first
+// but everything else in deflate goes out lowest bit first. Lengths and distances are looked up straight to their codes
+struct FixedTables
+{
+    FixedTables()
+    {
+        for (int symbol = 0; symbol < 288; ++symbol)
+        {
+            Uint32 code;
+            int length;
+            if (symbol < 144) { code = 0x30 + symbol; length = 8; }
+            else if (symbol < 256) { code = 0x190 + symbol - 144; length = 9; }
+            else if (symbol < 280) { code = symbol - 256; length = 7; }
+            else { code = 0xC0 + symbol - 280; length = 8; }
+
+            literalCodes[symbol] = Reverse(code, length);
+            literalLengths[symbol] = length;
+        }
+
+        for (int i = 0; i < 29; ++i)
+        {
+            int last = i + 1 < 29 ? lengthBase[i + 1] : 259;
+            for (int length = lengthBase[i]; length < last && length <= 258; ++length)
+            {
+                lengthSymbols[length] = i;
+            }
+        }
+
+        for (int i = 0; i < 30; ++i)
+        {
+            distanceCodes[i] = Reverse(i, 5);
+        }
+    }
+
+    static Uint32 Reverse(Uint32 code, int length)
+    {
+        Uint32 reversed = 0;
+        for (int i = 0; i < length; ++i)
+        {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        return reversed;
+    }
+
+    Uint32 literalCodes[288];
+    int literalLengths[288];
+    Uint8 lengthSymbols[259];
+    Uint32 distanceCodes[30];
+};
+
+static const FixedTables fixedTables;
+
+static int DistanceSymbol(int distance)
+{
+    int symbol = 0;
+    while (symbol + 1 < 30 && distanceBase[symbol + 1] <= distance)
+    {
+        ++symbol;
+    }
+    return symbol;
+}
+
+const int DEFLATE_WINDOW = 32768;
+const int DEFLATE_MIN_MATCH = 3;
+const int DEFLATE_MAX_MATCH = 258;
+const int DEFLATE_HASH_BITS = 15;
+
+static inline Uint32 Hash3(const Uint8* p)
+{
+    Uint32 value = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (value * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+void Deflate(const Uint8* data, size_t size, bool final, std::vector<Uint8>& out)
+{
+    BitWriter writer(out);
+
+    // One block with the fixed codes, there's no limit on how big those can be
+    writer.Put(final ? 1 : 0, 1);
+    writer.Put(1, 2);
+
+    // Where each hash of three bytes was last seen, one more than the position so zero can mean nowhere
+    std::vector<Uint32> lastSeen(1 << DEFLATE_HASH_BITS, 0);
+
+    size_t i = 0;
+    while (i < size)
+    {
+        int matchLength = 0;
+        size_t matchDistance = 0;
+
+        if (i + DEFLATE_MIN_MATCH <= size)
+        {
+            Uint32 hash = Hash3(data + i);
+            size_t candidate = lastSeen[hash];
+            lastSeen[hash] = (Uint32)(i + 1);
+
+            if (candidate > 0 && i - (candidate - 1) <= DEFLATE_WINDOW)
+            {
+                const Uint8* a = data + candidate - 1;
+                const Uint8* b = data + i;
+                int limit = (int)SDL_min(size - i, (size_t)DEFLATE_MAX_MATCH);
+                int length = 0;
+                while (length < limit && a[length] == b[length])
+                {
+                    ++length;
+                }
+
+                if (length >= DEFLATE_MIN_MATCH)
+                {
+                    matchLength = length;
+                    matchDistance = i - (candidate - 1);
+                }
+            }
+        }
+
+        if (matchLength == 0)
+        {
+            writer.Put(fixedTables.literalCodes[data[i]], fixedTables.literalLengths[data[i]]);
+            ++i;
+            continue;
+        }
+
+        int lengthSymbol = fixedTables.lengthSymbols[matchLength];
+        writer.Put(fixedTables.literalCodes[257 + lengthSymbol], fixedTables.literalLengths[257 + lengthSymbol]);
+        writer.Put(matchLength - lengthBase[lengthSymbol], lengthExtra[lengthSymbol]);
+
+        int distanceSymbol = DistanceSymbol((int)matchDistance);
+        writer.Put(fixedTables.distanceCodes[distanceSymbol], 5);
+        writer.Put((Uint32)matchDistance - distanceBase[distanceSymbol], distanceExtra[distanceSymbol]);
+
+        // Only the start of the match gets hashed in, skipping the rest is most of what keeps this fast
+        // on long runs, at the cost of finding a few less matches
+        i += matchLength;
+    }
+
+    // End of block
+    writer.Put(fixedTables.literalCodes[256], fixedTables.literalLengths[256]);
+
+    // An empty stored block gets us back onto a byte boundary without ending the stream
+    if (!final)
+    {
+        writer.Put(0, 3);
+        writer.Align();
+        out.push_back(0x00);
+        out.push_back(0x00);
+        out.push_back(0xFF);
+        out.push_back(0xFF);
+    }
+
+    writer.Align();
+}
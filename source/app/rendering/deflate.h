@@ -0,0 +1,21 @@
+#ifndef RENDERING_DEFLATE_H
+#define RENDERING_DEFLATE_H
+
+#include <SDL/SDL.h>
+#include <vector>
+
+// The checksums zlib streams and png chunks need
+Uint32 Adler32(Uint32 adler, const Uint8* data, size_t size);
+Uint32 Crc32(Uint32 crc, const Uint8* data, size_t size);
+
+// Works out the adler of two pieces of data stuck together from the adlers of each piece, so pieces
+// compressed on different threads can still be checked as one stream
+Uint32 Adler32Combine(Uint32 first, Uint32 second, size_t secondSize);
+
+// A fast deflate, about what zlib does at level 1. Matches come from a single hash lookup instead of searching
+// and everything is coded with the fixed huffman tables, so there's no second pass over the data
+// The output is raw deflate blocks, appended to out. Unless it's the final piece of the stream it ends on a byte
+// boundary, which lets pieces compressed separately be joined end to end
+void Deflate(const Uint8* data, size_t size, bool final, std::vector<Uint8>& out);
+
+#endif
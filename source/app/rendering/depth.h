@@ -0,0 +1,253 @@
+#ifndef RENDERING_DEPTH_H
+#define RENDERING_DEPTH_H
+
+#include <SDL/SDL.h>
+#include <float.h>
+#include "simd.h"
+
+// How values are stored in the depth buffer, picking a smaller format trades precision for memory bandwidth
+enum DepthFormat
+{
+    // Plain floats straight out of projection, cleared to FLT_MAX
+    DEPTH_FLOAT32,
+
+    // Floats stored as one minus the normalized depth, cleared to 0 and tested with greater or equal
+    // Floats are most precise near 0, so flipping them puts that precision out at the far plane where we need it
+    DEPTH_FLOAT32_REVERSED,
+
+    // Normalized depth as 16 bit fixed point, half the bandwidth of floats
+    DEPTH_UNORM16,
+
+    // Normalized depth as 24 bit fixed point packed into the low bits of a 32 bit word
+    DEPTH_UNORM24,
+
+    DEPTH_FORMAT_COUNT
+};
+
+// Compressed depth is tracked in square tiles this many pixels wide
+const int DEPTH_TILE_SIZE = 8;
+
+// What a depth tile is currently holding
+enum DepthTileState
+{
+    // Nothing has been drawn since the last clear, so every pixel holds the clear value
+    DEPTH_TILE_CLEARED,
+
+    // One triangle covers the whole tile, so its depth is just that triangle's plane
+    DEPTH_TILE_PLANE,
+
+    // Values are stored per pixel in the depth buffer like normal
+    DEPTH_TILE_EXPANDED
+};
+
+// What a triangle should do with the pixels it draws inside a depth tile
+enum DepthTileVerdict
+{
+    DEPTH_PASS_ALL,
+    DEPTH_FAIL_ALL,
+    DEPTH_TEST_PIXELS
+};
+
+// A triangle's depth written as a plane across the screen, z = a * x + b * y + c, along with its edges
+// so we can tell when it covers a whole depth tile
+struct TrianglePlane
+{
+    void Setup(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, Uint32 triangleId)
+    {
+        id = triangleId;
+
+        // Twice the signed area, tiny triangles never cover a tile so we don't bother with them
+        float area = (x2 - x1) * (y3 - y1) - (x3 - x1) * (y2 - y1);
+        valid = area > 1.0f || area < -1.0f;
+        if (!valid)
+        {
+            return;
+        }
+
+        a = ((z2 - z1) * (y3 - y1) - (z3 - z1) * (y2 - y1)) / area;
+        b = ((x2 - x1) * (z3 - z1) - (x3 - x1) * (z2 - z1)) / area;
+        c = z1 - a * x1 - b * y1;
+
+        // Each edge is positive on the inside, flipping them for triangles wound the other way
+        float sign = area > 0 ? 1.0f : -1.0f;
+        SetupEdge(0, x1, y1, x2, y2, sign);
+        SetupEdge(1, x2, y2, x3, y3, sign);
+        SetupEdge(2, x3, y3, x1, y1, sign);
+    }
+
+    float Depth(float x, float y) const
+    {
+        return a * x + b * y + c;
+    }
+
+    // True if the whole box is inside the triangle, which for a convex shape just means all four corners are
+    bool Covers(float left, float top, float right, float bottom) const
+    {
+        if (!valid)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            if (edgeX[i] * left + edgeY[i] * top + edgeC[i] < 0 ||
+                edgeX[i] * right + edgeY[i] * top + edgeC[i] < 0 ||
+                edgeX[i] * left + edgeY[i] * bottom + edgeC[i] < 0 ||
+                edgeX[i] * right + edgeY[i] * bottom + edgeC[i] < 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    float a;
+    float b;
+    float c;
+
+    float edgeX[3];
+    float edgeY[3];
+    float edgeC[3];
+
+    Uint32 id;
+    bool valid;
+
+private:
+    void SetupEdge(int i, float x1, float y1, float x2, float y2, float sign)
+    {
+        edgeX[i] = -(y2 - y1) * sign;
+        edgeY[i] = (x2 - x1) * sign;
+        edgeC[i] = ((y2 - y1) * x1 - (x2 - x1) * y1) * sign;
+    }
+};
+
+// Bookkeeping for one compressed depth tile
+struct DepthTile
+{
+    Uint8 state;
+
+    // The last triangle to look at this tile and what it decided, so the rest of its pixels here don't redo the work
+    Uint8 verdict;
+    Uint32 triangle;
+
+    // The plane when state is DEPTH_TILE_PLANE
+    float a;
+    float b;
+    float c;
+};
+
+// Converts projected depth from -1 to 1 into 0 to 1 so it can be stored in fixed point
+inline float NormalizeDepth(float z)
+{
+    float depth = z * 0.5f + 0.5f;
+    return SDL_min(SDL_max(depth, 0.0f), 1.0f);
+}
+
+#if RENDERING_AVX2
+inline __m256 NormalizeDepthWide(__m256 z)
+{
+    __m256 depth = _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(0.5f)), _mm256_set1_ps(0.5f));
+    return _mm256_min_ps(_mm256_max_ps(depth, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+#endif
+
+// Depth traits, one per format, so depth tests and clears get compiled for the format instead of switching per pixel
+// Encode turns a projected depth into what gets stored, Passes says whether an incoming value beats the stored one
+struct DepthFloat32
+{
+    typedef float Stored;
+    static const DepthFormat Format = DEPTH_FLOAT32;
+
+    static Stored ClearValue() { return FLT_MAX; }
+    static Stored Encode(float z) { return z; }
+    static bool Passes(Stored incoming, Stored current) { return incoming <= current; }
+
+#if RENDERING_AVX2
+    // Tests eight depths at once against the buffer, storing and returning the lanes that pass
+    static __m256i TestWide(Stored* row, __m256 z, __m256i covered)
+    {
+        __m256 current = _mm256_maskload_ps(row, covered);
+        __m256i pass = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(z, current, _CMP_LE_OQ)), covered);
+        _mm256_maskstore_ps(row, pass, z);
+        return pass;
+    }
+#endif
+};
+
+struct DepthFloat32Reversed
+{
+    typedef float Stored;
+    static const DepthFormat Format = DEPTH_FLOAT32_REVERSED;
+
+    static Stored ClearValue() { return 0.0f; }
+    static Stored Encode(float z) { return 1.0f - NormalizeDepth(z); }
+    static bool Passes(Stored incoming, Stored current) { return incoming >= current; }
+
+#if RENDERING_AVX2
+    static __m256i TestWide(Stored* row, __m256 z, __m256i covered)
+    {
+        __m256 depth = NormalizeDepthWide(z);
+        __m256 incoming = _mm256_sub_ps(_mm256_set1_ps(1.0f), depth);
+
+        __m256 current = _mm256_maskload_ps(row, covered);
+        __m256i pass = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(incoming, current, _CMP_GE_OQ)), covered);
+        _mm256_maskstore_ps(row, pass, incoming);
+        return pass;
+    }
+#endif
+};
+
+struct DepthUnorm16
+{
+    typedef Uint16 Stored;
+    static const DepthFormat Format = DEPTH_UNORM16;
+
+    static Stored ClearValue() { return 0xFFFF; }
+    static Stored Encode(float z) { return (Stored)(NormalizeDepth(z) * 65535.0f + 0.5f); }
+    static bool Passes(Stored incoming, Stored current) { return incoming <= current; }
+
+#if RENDERING_AVX2
+    // There's no masked store for 16 bit values, so we blend the old values back into the lanes that fail and
+    // write the whole group. Groups always sit inside one tile row so reading all of it is safe
+    static __m256i TestWide(Stored* row, __m256 z, __m256i covered)
+    {
+        __m256 depth = NormalizeDepthWide(z);
+        __m256i incoming = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(depth, _mm256_set1_ps(65535.0f)), _mm256_set1_ps(0.5f)));
+
+        __m256i current = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)row));
+        __m256i pass = _mm256_andnot_si256(_mm256_cmpgt_epi32(incoming, current), covered);
+        __m256i merged = _mm256_blendv_epi8(current, incoming, pass);
+
+        // Packing works within each 128 bit half, so pull the two useful quarters back together
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(merged, merged), 0x08);
+        _mm_storeu_si128((__m128i*)row, _mm256_castsi256_si128(packed));
+        return pass;
+    }
+#endif
+};
+
+struct DepthUnorm24
+{
+    typedef Uint32 Stored;
+    static const DepthFormat Format = DEPTH_UNORM24;
+
+    static Stored ClearValue() { return 0xFFFFFF; }
+    static Stored Encode(float z) { return (Stored)(NormalizeDepth(z) * 16777215.0f + 0.5f); }
+    static bool Passes(Stored incoming, Stored current) { return incoming <= current; }
+
+#if RENDERING_AVX2
+    static __m256i TestWide(Stored* row, __m256 z, __m256i covered)
+    {
+        __m256 depth = NormalizeDepthWide(z);
+        __m256i incoming = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(depth, _mm256_set1_ps(16777215.0f)), _mm256_set1_ps(0.5f)));
+
+        __m256i current = _mm256_maskload_epi32((const int*)row, covered);
+        __m256i pass = _mm256_andnot_si256(_mm256_cmpgt_epi32(incoming, current), covered);
+        _mm256_maskstore_epi32((int*)row, pass, incoming);
+        return pass;
+    }
+#endif
+};
+
+#endif
@@ -1,217 +1,661 @@
 #include "device.h"
 #include <float.h>
+#include <string.h>
+#include "simd.h"
+#include "image.h"
+#include "../jobs.h"
+#include "../profiler.h"
+
+// Compressed depth keeps its bookkeeping per framebuffer tile
+static_assert(DEPTH_TILE_SIZE == FRAMEBUFFER_TILE_SIZE, "Depth tiles need to match the framebuffer tiles");
 
 Device::Device(SDL_Surface* _screen)
-    :screen(_screen), renderWidth(screen->w), renderHeight(screen->h)
+    :screen(_screen), depthBuffer(NULL), depthCompression(false), triangleCounter(0), bytesCleared(0),
+    dirtyTracking(false), clearColor(0), fullClear(true), renderWidth(screen->w), renderHeight(screen->h)
 {
-    depthBuffer = new float[renderWidth * renderHeight];
+    // Tiles along the right and bottom edges can hang off the screen
+    tilesX = (renderWidth + FRAMEBUFFER_TILE_SIZE - 1) / FRAMEBUFFER_TILE_SIZE;
+    tilesY = (renderHeight + FRAMEBUFFER_TILE_SIZE - 1) / FRAMEBUFFER_TILE_SIZE;
+    bufferSize = tilesX * tilesY * FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+
+    colorBuffer = new Uint32[bufferSize];
+    dirtyTiles.Reset(tilesX, tilesY, FRAMEBUFFER_TILE_SHIFT);
+    depthTiles = new DepthTile[tilesX * tilesY];
+    SetDepthFormat(DEPTH_FLOAT32);
 }
 
 Device::~Device()
 {
+    if (colorBuffer)
+    {
+        delete[] colorBuffer;
+    }
+
     if (depthBuffer)
     {
         delete[] depthBuffer;
     }
+
+    if (depthTiles)
+    {
+        delete[] depthTiles;
+    }
+}
+
+void Device::SetDepthFormat(DepthFormat format)
+{
+    if (depthBuffer)
+    {
+        delete[] depthBuffer;
+    }
+
+    int bytesPerValue = 4;
+    if (format == DEPTH_UNORM16)
+    {
+        bytesPerValue = 2;
+    }
+
+    // The wide rasterizer reads and writes whole tile rows, which is safe since the buffer covers every tile completely
+    depthFormat = format;
+    depthBuffer = new Uint8[bufferSize * bytesPerValue];
+    fullClear = true;
 }
 
 // Clears the screen buffer to the given color
 void Device::Clear(Color color)
 {
-    Uint32* pixels = (Uint32 *)screen->pixels;
+    PROFILE_ZONE("Clear");
+
     Uint32 screenColor = SDL_MapRGBA(screen->format, color.r, color.g, color.b, color.a);
 
-    for (int i = 0; i < renderWidth * renderHeight; ++i)
+    // Everything outside the marked tiles still holds the last clear, so only the marked ones need doing
+    bool partial = dirtyTracking && !fullClear && screenColor == clearColor;
+    const DirtyTiles* tiles = partial ? &dirtyTiles : NULL;
+    const int tilePixels = FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+
+    int tilesCleared = 0;
+    for (int tile = 0; tile < tilesX * tilesY; ++tile)
     {
-        pixels[i] = screenColor;
-        depthBuffer[i] = FLT_MAX;
+        if (tiles && !tiles->Marked(tile))
+        {
+            continue;
+        }
+
+        Uint32* pixels = colorBuffer + tile * tilePixels;
+        for (int i = 0; i < tilePixels; ++i)
+        {
+            pixels[i] = screenColor;
+        }
+        ++tilesCleared;
     }
+
+    triangleCounter = 0;
+    bytesCleared = (Uint64)tilesCleared * tilePixels * sizeof(Uint32);
+
+    // With compression every tile just gets flagged as cleared, the values get written if they're ever needed
+    if (depthCompression)
+    {
+        for (int i = 0; i < tilesX * tilesY; ++i)
+        {
+            if (!tiles || tiles->Marked(i))
+            {
+                depthTiles[i].state = DEPTH_TILE_CLEARED;
+                depthTiles[i].triangle = 0;
+            }
+        }
+
+        bytesCleared += tilesCleared * sizeof(DepthTile);
+    }
+    else
+    {
+        switch (depthFormat)
+        {
+        case DEPTH_FLOAT32_REVERSED: ClearDepth<DepthFloat32Reversed>(tiles); break;
+        case DEPTH_UNORM16: ClearDepth<DepthUnorm16>(tiles); break;
+        case DEPTH_UNORM24: ClearDepth<DepthUnorm24>(tiles); break;
+        default: ClearDepth<DepthFloat32>(tiles); break;
+        }
+    }
+
+    clearColor = screenColor;
+    fullClear = false;
+    dirtyTiles.ClearAll();
 }
 
-Color Device::GetPixel(int x, int y)
+template <class Depth>
+void Device::ClearDepth(const DirtyTiles* tiles)
 {
-	Uint32 index = x + y * renderWidth;
-	Uint32* pixels = (Uint32 *)screen->pixels;
-	Color ret;
-	SDL_GetRGBA(pixels[index], screen->format, &(ret.r), &(ret.g), &(ret.b), &(ret.a));
-	return ret;
+    typename Depth::Stored* depth = DepthBuffer<Depth>();
+    typename Depth::Stored value = Depth::ClearValue();
+    const int tilePixels = FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+
+    for (int tile = 0; tile < tilesX * tilesY; ++tile)
+    {
+        if (tiles && !tiles->Marked(tile))
+        {
+            continue;
+        }
+
+        typename Depth::Stored* values = depth + tile * tilePixels;
+        for (int i = 0; i < tilePixels; ++i)
+        {
+            values[i] = value;
+        }
+
+        bytesCleared += tilePixels * sizeof(typename Depth::Stored);
+    }
 }
 
-// Draws a pixel to the screen ignoring the depthbuffer
-void Device::PutPixel(int x, int y, Color c)
+void Device::SetDepthCompression(bool enabled)
 {
-    Uint32* pixels = (Uint32 *)screen->pixels;
-    Uint32 index = x + y * renderWidth;
-    pixels[index] = SDL_MapRGBA(screen->format, c.r, c.g, c.b, c.a);
+    // Tiles that were never drawn to only hold real values when compression was off for their last clear
+    fullClear = fullClear || enabled != depthCompression;
+    depthCompression = enabled;
 }
 
-// Draws a pixel to the screen only if it passes our depth buffer test
-void Device::PutPixel(int x, int y, float z, Color c)
+void Device::SetDirtyTracking(bool enabled)
+{
+    dirtyTracking = enabled;
+}
+
+bool Device::TestDepth(int x, int y, float z)
 {
-    Uint32* pixels = (Uint32 *)screen->pixels;
-    Uint32 index = x + y * renderWidth;
-    if (depthBuffer[index] < z)
+    switch (depthFormat)
     {
-        return;
+    case DEPTH_FLOAT32_REVERSED: return TestDepthExpanded<DepthFloat32Reversed>(x, y, z);
+    case DEPTH_UNORM16: return TestDepthExpanded<DepthUnorm16>(x, y, z);
+    case DEPTH_UNORM24: return TestDepthExpanded<DepthUnorm24>(x, y, z);
+    default: return TestDepthExpanded<DepthFloat32>(x, y, z);
     }
+}
 
-    depthBuffer[index] = z;
-    pixels[index] = SDL_MapRGBA(screen->format, c.r, c.g, c.b, c.a);
+// Single pixels don't know anything about triangles, so they always need the tile stored per pixel
+template <class Depth>
+bool Device::TestDepthExpanded(int x, int y, float z)
+{
+    if (depthCompression)
+    {
+        int tileX = x / DEPTH_TILE_SIZE;
+        int tileY = y / DEPTH_TILE_SIZE;
+        DepthTile& tile = depthTiles[tileX + tileY * tilesX];
+        if (tile.state != DEPTH_TILE_EXPANDED)
+        {
+            ExpandDepthTile<Depth>(tile, tileX, tileY);
+        }
+    }
+
+    return TestDepth<Depth>(x, y, z);
 }
 
-// Draws a point to the screen if it is within the viewport
-void Device::DrawPoint(float x, float y, float z, Color color)
+template <class Depth>
+DepthTileVerdict Device::ClassifyCompressedTile(DepthTile& tile, int tileX, int tileY, const TrianglePlane& plane)
 {
-    // Clipping what's visible on screen
-    if (x >= 0 && y >= 0 && x < renderWidth && y < renderHeight)
+    int left = tileX * DEPTH_TILE_SIZE;
+    int top = tileY * DEPTH_TILE_SIZE;
+    int right = left + DEPTH_TILE_SIZE - 1;
+    int bottom = top + DEPTH_TILE_SIZE - 1;
+
+    // The scanlines cover a pixel when the right edge is at least a pixel past it, so the box we check reaches
+    // one past the last column, with a little slack on every side for rounding
+    bool onScreen = right < renderWidth && bottom < renderHeight;
+    if (onScreen && plane.Covers(left - 0.5f, top - 0.5f, right + 1.5f, bottom + 0.5f))
     {
-        // Drawing a point
-        PutPixel((int)x, (int)y, z, color);
+        tile.triangle = plane.id;
+
+        if (tile.state == DEPTH_TILE_CLEARED)
+        {
+            tile.verdict = DEPTH_PASS_ALL;
+        }
+        else
+        {
+            // Both depths are planes so the difference between them is too, meaning if the new one is in front
+            // at all four corners it's in front everywhere, and the same goes for behind
+            int inFront = 0;
+            int behind = 0;
+            float cornersX[4] = { (float)left, (float)right, (float)left, (float)right };
+            float cornersY[4] = { (float)top, (float)top, (float)bottom, (float)bottom };
+            for (int i = 0; i < 4; ++i)
+            {
+                float incoming = plane.Depth(cornersX[i], cornersY[i]);
+                float current = tile.a * cornersX[i] + tile.b * cornersY[i] + tile.c;
+                if (incoming <= current)
+                {
+                    ++inFront;
+                }
+                else
+                {
+                    ++behind;
+                }
+            }
+
+            if (inFront == 4)
+            {
+                tile.verdict = DEPTH_PASS_ALL;
+            }
+            else if (behind == 4)
+            {
+                tile.verdict = DEPTH_FAIL_ALL;
+                return DEPTH_FAIL_ALL;
+            }
+            else
+            {
+                ExpandDepthTile<Depth>(tile, tileX, tileY);
+                return DEPTH_TEST_PIXELS;
+            }
+        }
+
+        // The whole tile is this triangle now, so all we need to keep is its plane
+        tile.state = DEPTH_TILE_PLANE;
+        tile.a = plane.a;
+        tile.b = plane.b;
+        tile.c = plane.c;
+        return DEPTH_PASS_ALL;
     }
+
+    // Only part of the tile is changing, so we need real values for every pixel
+    ExpandDepthTile<Depth>(tile, tileX, tileY);
+    return DEPTH_TEST_PIXELS;
 }
 
-void Device::DrawPoint(int x, int y, const Color& c)
+template <class Depth>
+void Device::ExpandDepthTile(DepthTile& tile, int tileX, int tileY)
 {
-    if (x >= 0 && x < screen->w && y >= 0 && y < screen->h)
+    int left = tileX * DEPTH_TILE_SIZE;
+    int top = tileY * DEPTH_TILE_SIZE;
+
+    // The whole tile is contiguous in the buffer, including any part hanging off the screen
+    typename Depth::Stored* values = DepthBuffer<Depth>() + PixelIndex(left, top);
+    for (int y = top; y < top + DEPTH_TILE_SIZE; ++y)
     {
-        PutPixel(x, y, c);
+        for (int x = left; x < left + DEPTH_TILE_SIZE; ++x)
+        {
+            if (tile.state == DEPTH_TILE_PLANE)
+            {
+                *values++ = Depth::Encode(tile.a * x + tile.b * y + tile.c);
+            }
+            else
+            {
+                *values++ = Depth::ClearValue();
+            }
+        }
     }
+
+    tile.state = DEPTH_TILE_EXPANDED;
 }
 
-Vector3 Device::Project(const Vector3& v, const Matrix& transform) const
+// The rasterizers are compiled per format, so they need every version of the tile functions
+template DepthTileVerdict Device::ClassifyCompressedTile<DepthFloat32>(DepthTile&, int, int, const TrianglePlane&);
+template DepthTileVerdict Device::ClassifyCompressedTile<DepthFloat32Reversed>(DepthTile&, int, int, const TrianglePlane&);
+template DepthTileVerdict Device::ClassifyCompressedTile<DepthUnorm16>(DepthTile&, int, int, const TrianglePlane&);
+template DepthTileVerdict Device::ClassifyCompressedTile<DepthUnorm24>(DepthTile&, int, int, const TrianglePlane&);
+
+bool Device::HasPackedFormat() const
 {
-    Vector3 projectedVector = transform.Transform(v);
-    return Vector3(
-        ((screen->w / 2) * projectedVector.x) + (screen->w / 2),
-        -(((screen->h / 2) * projectedVector.y) - (screen->h / 2)),
-        projectedVector.z );
+    const SDL_PixelFormat* format = screen->format;
+    return format->BytesPerPixel == 4 && format->Rloss == 0 && format->Gloss == 0 && format->Bloss == 0;
 }
 
-void WriteHexString(SDL_RWops* file, char *s)
+// Walks the screen a row at a time copying a tile row's worth of pixels in each go
+void Device::Present()
 {
-    Uint32 value;
-    char hex[3];
+    PROFILE_ZONE("Resolve");
 
-    for (int i = 0; i < SDL_strlen(s); i += 2) {
-        hex[0] = s[i];
-        hex[1] = s[i + 1];
-        hex[2] = '\0';
-        SDL_sscanf(hex, "%X", &value);
-        SDL_WriteU8(file, value);
+    for (int y = 0; y < renderHeight; ++y)
+    {
+        Uint32* dest = (Uint32 *)((Uint8 *)screen->pixels + y * screen->pitch);
+        const Uint32* source = colorBuffer + PixelIndex(0, y);
+
+        int x = 0;
+        for (; x + FRAMEBUFFER_TILE_SIZE <= renderWidth; x += FRAMEBUFFER_TILE_SIZE)
+        {
+#if RENDERING_AVX2
+            _mm256_storeu_si256((__m256i*)(dest + x), _mm256_loadu_si256((const __m256i*)source));
+#else
+            memcpy(dest + x, source, FRAMEBUFFER_TILE_SIZE * sizeof(Uint32));
+#endif
+            source += FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+        }
+
+        // Whatever's left of a tile that hangs off the right side
+        for (int i = 0; x < renderWidth; ++x, ++i)
+        {
+            dest[x] = source[i];
+        }
     }
 }
 
-void Device::WriteToFile(const char* filename)
+void Device::Present(PresentedScreen& presented)
 {
-    SDL_RWops* file = SDL_RWFromFile(filename, "w+b");
-    if (file)
-    {
-        // Writing out a tiff (Code taken from http://paulbourke.net/dataformats/tiff/) switch with a lib later
-        Uint32 numbytes = renderWidth * renderHeight * 3;
+    bool partial = dirtyTracking && presented.valid && presented.background == clearColor
+        && presented.tiles.TileCount() == dirtyTiles.TileCount();
 
-        // Header of the file
-        SDL_RWwrite(file, "MM", 2, 1);
-        SDL_WriteBE16(file, 42);
-        Uint32 offset = numbytes + 8; // 8 bytes are from the header including this offset
-        SDL_WriteBE32(file, offset);
-
-        // Then the actual data
-        Uint32* pixels = (Uint32 *)screen->pixels;
+    if (!partial)
+    {
+        Present();
+        SDL_Rect everything = { 0, 0, renderWidth, renderHeight };
+        presented.rects.assign(1, everything);
+    }
+    else
+    {
+        PROFILE_ZONE("Resolve dirty");
 
-        // to avoid a bunch of file io and hopefully speed up the function we're gonna buffer pixel writes and do them at once
-        Uint8* buffer = new Uint8[numbytes];
-        Uint32 bufferOffset = 0;
+        // What's on screen differs from this frame in the tiles either of them drew to
+        DirtyTiles& changed = presented.tiles;
+        changed.Add(dirtyTiles);
 
-        for (int y = 0; y < renderHeight; ++y)
+        const int tilePixels = FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+        for (int tile = 0; tile < tilesX * tilesY; ++tile)
         {
-            for (int x = 0; x < renderWidth; ++x)
+            if (!changed.Marked(tile))
             {
-                Uint32 pixelIndex = x + y * renderWidth;
+                continue;
+            }
 
-                Uint32 pixel = pixels[pixelIndex];
-                Color color = Color(pixel);
+            // Tiles along the right and bottom edges only copy the part that's on the screen
+            int left = (tile % tilesX) * FRAMEBUFFER_TILE_SIZE;
+            int top = (tile / tilesX) * FRAMEBUFFER_TILE_SIZE;
+            int width = SDL_min(FRAMEBUFFER_TILE_SIZE, renderWidth - left);
+            int height = SDL_min(FRAMEBUFFER_TILE_SIZE, renderHeight - top);
 
-                buffer[bufferOffset++] = color.r;
-                buffer[bufferOffset++] = color.g;
-                buffer[bufferOffset++] = color.b;
+            const Uint32* source = colorBuffer + tile * tilePixels;
+            for (int row = 0; row < height; ++row)
+            {
+                Uint32* dest = (Uint32 *)((Uint8 *)screen->pixels + (top + row) * screen->pitch) + left;
+                memcpy(dest, source + row * FRAMEBUFFER_TILE_SIZE, width * sizeof(Uint32));
             }
         }
 
-        SDL_RWwrite(file, buffer, numbytes, 1);
-        delete buffer;
+        changed.GetRects(renderWidth, renderHeight, presented.rects);
+    }
 
-        // Finally the IFD
-        // The number of directory entries
-        SDL_WriteBE16(file, 14);  
+    presented.tiles = dirtyTiles;
+    presented.background = clearColor;
+    presented.valid = true;
+}
+
+Color Device::GetPixel(int x, int y)
+{
+	Color ret;
+	SDL_GetRGBA(colorBuffer[PixelIndex(x, y)], screen->format, &(ret.r), &(ret.g), &(ret.b), &(ret.a));
+	return ret;
+}
+
+// Draws a pixel to the screen ignoring the depthbuffer
+void Device::PutPixel(int x, int y, Color c)
+{
+    colorBuffer[PixelIndex(x, y)] = SDL_MapRGBA(screen->format, c.r, c.g, c.b, c.a);
+    dirtyTiles.Mark((y >> FRAMEBUFFER_TILE_SHIFT) * tilesX + (x >> FRAMEBUFFER_TILE_SHIFT));
+}
+
+// Draws a pixel to the screen only if it passes our depth buffer test
+void Device::PutPixel(int x, int y, float z, Color c)
+{
+    if (TestDepth(x, y, z))
+    {
+        PutPixel(x, y, c);
+    }
+}
+
+// Draws a point to the screen if it is within the viewport
+void Device::DrawPoint(float x, float y, float z, Color color)
+{
+    // Clipping what's visible on screen
+    if (x >= 0 && y >= 0 && x < renderWidth && y < renderHeight)
+    {
+        // Drawing a point
+        PutPixel((int)x, (int)y, z, color);
+    }
+}
+
+void Device::FillSpanMapped(int y, int x0, int x1, Uint32 pixel)
+{
+    if (y < 0 || y >= renderHeight)
+    {
+        return;
+    }
+
+    x0 = SDL_max(x0, 0);
+    x1 = SDL_min(x1, renderWidth - 1);
+    if (x0 > x1)
+    {
+        return;
+    }
+
+    MarkDirty(x0, y, x1, y);
+
+    // Each tile holds eight pixels of the row next to each other, then the row carries on in the next tile
+    Uint32* row = colorBuffer + PixelIndex(0, y);
+    const int tileStride = FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+
+    // Up to the first tile edge a pixel at a time
+    int x = x0;
+    for (; x <= x1 && (x & (FRAMEBUFFER_TILE_SIZE - 1)); ++x)
+    {
+        row[(x >> FRAMEBUFFER_TILE_SHIFT) * tileStride + (x & (FRAMEBUFFER_TILE_SIZE - 1))] = pixel;
+    }
 
-        /* Width tag, short int */
-        WriteHexString(file, "0100000300000001");
-        SDL_WriteBE16(file, renderWidth);
-        WriteHexString(file, "0000");
+    // Then whole tile rows
+#if RENDERING_AVX2
+    __m256i wide = _mm256_set1_epi32(pixel);
+#endif
+    for (; x + FRAMEBUFFER_TILE_SIZE - 1 <= x1; x += FRAMEBUFFER_TILE_SIZE)
+    {
+        Uint32* dest = row + (x >> FRAMEBUFFER_TILE_SHIFT) * tileStride;
+#if RENDERING_AVX2
+        _mm256_storeu_si256((__m256i*)dest, wide);
+#else
+        for (int i = 0; i < FRAMEBUFFER_TILE_SIZE; ++i)
+        {
+            dest[i] = pixel;
+        }
+#endif
+    }
 
-        /* Height tag, short int */
-        WriteHexString(file, "0101000300000001");
-        SDL_WriteBE16(file, renderHeight);
-        WriteHexString(file, "0000");
+    // And whatever's left
+    for (; x <= x1; ++x)
+    {
+        row[(x >> FRAMEBUFFER_TILE_SHIFT) * tileStride + (x & (FRAMEBUFFER_TILE_SIZE - 1))] = pixel;
+    }
+}
 
-        /* Bits per sample tag, short int */
-        WriteHexString(file, "0102000300000003");
-        SDL_WriteBE32(file, numbytes + 182);
+void Device::FillRect(int x, int y, int width, int height, const Color& c)
+{
+    int top = SDL_max(y, 0);
+    int bottom = SDL_min(y + height, renderHeight);
+    Uint32 pixel = MapColor(c);
+
+    for (int row = top; row < bottom; ++row)
+    {
+        FillSpanMapped(row, x, x + width - 1, pixel);
+    }
+}
+
+void Device::BlendSpan(int y, int x0, int x1, const Color& c, Uint8 alpha)
+{
+    if (alpha == 255)
+    {
+        FillSpan(y, x0, x1, c);
+        return;
+    }
 
-        /* Compression flag, short int */
-        WriteHexString(file, "010300030000000100010000");
+    if (alpha == 0 || y < 0 || y >= renderHeight)
+    {
+        return;
+    }
 
-        /* Photometric interpolation tag, short int */
-        WriteHexString(file, "010600030000000100020000");
+    x0 = SDL_max(x0, 0);
+    x1 = SDL_min(x1, renderWidth - 1);
+    if (x0 > x1)
+    {
+        return;
+    }
 
-        /* Strip offset tag, long int */
-        WriteHexString(file, "011100040000000100000008");
+    MarkDirty(x0, y, x1, y);
 
-        /* Orientation flag, short int */
-        WriteHexString(file, "011200030000000100010000");
+    PixelBlender blender(screen->format, HasPackedFormat());
+    Uint32* row = colorBuffer + PixelIndex(0, y);
+    const int tileStride = FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+    for (int x = x0; x <= x1; ++x)
+    {
+        Uint32& pixel = row[(x >> FRAMEBUFFER_TILE_SHIFT) * tileStride + (x & (FRAMEBUFFER_TILE_SIZE - 1))];
+        pixel = blender.Blend(pixel, c, alpha);
+    }
+}
 
-        /* Sample per pixel tag, short int */
-        WriteHexString(file, "011500030000000100030000");
+void Device::BlendCoverage(int y, int x, int count, const Uint8* alpha, const Color& c)
+{
+    BlendCoverage(y, x, count, 1, alpha, count, c);
+}
 
-        /* Rows per strip tag, short int */
-        WriteHexString(file, "0116000300000001");
-        SDL_WriteBE16(file, renderHeight);
-        WriteHexString(file, "0000");
+void Device::BlendCoverage(int y, int x, int width, int height, const Uint8* alpha, int stride, const Color& c)
+{
+    // Clipping moves along the alphas as well as the start
+    int top = SDL_max(0, -y);
+    int bottom = SDL_min(height, renderHeight - y);
+    int first = SDL_max(0, -x);
+    int last = SDL_min(width, renderWidth - x);
+    if (top >= bottom || first >= last)
+    {
+        return;
+    }
 
-        /* Strip byte count flag, long int */
-        WriteHexString(file, "0117000400000001");
-        SDL_WriteBE32(file, numbytes);
+    MarkDirty(x + first, y + top, x + last - 1, y + bottom - 1);
 
-        /* Minimum sample value flag, short int */
-        WriteHexString(file, "0118000300000003");
-        SDL_WriteBE32(file, numbytes + 188);
+    PixelBlender blender(screen->format, HasPackedFormat());
+    const int tileStride = FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
 
-        /* Maximum sample value tag, short int */
-        WriteHexString(file, "0119000300000003");
-        SDL_WriteBE32(file, numbytes + 194);
+#if RENDERING_AVX2
+    if (blender.packed)
+    {
+        // Every channel is a byte, so the color goes in the same way as the pixels and gets mixed in 16 bit lanes
+        __m256i zero = _mm256_setzero_si256();
+        __m256i color = _mm256_unpacklo_epi8(_mm256_set1_epi32(MapColor(c)), zero);
+        __m256i full = _mm256_set1_epi16(255);
+        __m256i half = _mm256_set1_epi16(128);
+        __m256i spread = _mm256_set1_epi32(0x01010101);
+        __m256i keep = _mm256_set1_epi32(blender.amask);
+
+        // The whole tile row is read and written back, with the alphas outside the run left at zero so those pixels
+        // come out exactly as they went in. The buffer covers whole tiles so there's always a full row to read
+        int start = x + first;
+        int end = x + last;
+        for (int j = top; j < bottom; ++j)
+        {
+            Uint32* row = colorBuffer + PixelIndex(0, y + j);
+            const Uint8* rowAlpha = alpha + j * stride;
+            for (int tileX = start & ~(FRAMEBUFFER_TILE_SIZE - 1); tileX < end; tileX += FRAMEBUFFER_TILE_SIZE)
+            {
+                Uint64 lanes = 0;
+                int from = SDL_max(start, tileX);
+                int to = SDL_min(end, tileX + FRAMEBUFFER_TILE_SIZE);
+                memcpy((Uint8*)&lanes + (from - tileX), rowAlpha + (from - x), to - from);
+                if (lanes == 0)
+                {
+                    continue;
+                }
+
+                Uint32* dest = row + (tileX >> FRAMEBUFFER_TILE_SHIFT) * tileStride;
+                __m256i pixels = _mm256_loadu_si256((const __m256i*)dest);
+
+                // Each alpha copied into all four bytes of its pixel, then split up the same way as the pixels
+                __m256i alphas = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&lanes)), spread);
+                __m256i alphaLow = _mm256_unpacklo_epi8(alphas, zero);
+                __m256i alphaHigh = _mm256_unpackhi_epi8(alphas, zero);
+                __m256i low = _mm256_unpacklo_epi8(pixels, zero);
+                __m256i high = _mm256_unpackhi_epi8(pixels, zero);
+
+                // The same sums as MixChannel
+                low = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(color, alphaLow), _mm256_mullo_epi16(low, _mm256_sub_epi16(full, alphaLow))), half);
+                high = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(color, alphaHigh), _mm256_mullo_epi16(high, _mm256_sub_epi16(full, alphaHigh))), half);
+                low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+                high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+                __m256i mixed = _mm256_packus_epi16(low, high);
+                mixed = _mm256_or_si256(_mm256_andnot_si256(keep, mixed), _mm256_and_si256(keep, pixels));
+                _mm256_storeu_si256((__m256i*)dest, mixed);
+            }
+        }
 
-        /* Planar configuration tag, short int */
-        WriteHexString(file, "011c00030000000100010000");
+        return;
+    }
+#endif
 
-        /* Sample format tag, short int */
-        WriteHexString(file, "0153000300000003");
-        SDL_WriteBE32(file, numbytes + 200);
+    for (int j = top; j < bottom; ++j)
+    {
+        Uint32* row = colorBuffer + PixelIndex(0, y + j);
+        const Uint8* rowAlpha = alpha + j * stride;
+        for (int i = first; i < last; ++i)
+        {
+            if (rowAlpha[i] == 0)
+            {
+                continue;
+            }
 
-        /* End of the directory entry */
-        WriteHexString(file, "00000000");
+            int px = x + i;
+            Uint32& pixel = row[(px >> FRAMEBUFFER_TILE_SHIFT) * tileStride + (px & (FRAMEBUFFER_TILE_SIZE - 1))];
+            pixel = blender.Blend(pixel, c, rowAlpha[i]);
+        }
+    }
+}
 
-        /* Bits for each colour channel */
-        WriteHexString(file, "000800080008");
+void Device::DrawPoint(int x, int y, const Color& c)
+{
+    if (x >= 0 && x < screen->w && y >= 0 && y < screen->h)
+    {
+        PutPixel(x, y, c);
+    }
+}
 
-        /* Minimum value for each component */
-        WriteHexString(file, "000000000000");
+Vector3 Device::Project(const Vector3& v, const Matrix& transform) const
+{
+    Vector3 projectedVector = transform.Transform(v);
+    return Vector3(
+        ((screen->w / 2) * projectedVector.x) + (screen->w / 2),
+        -(((screen->h / 2) * projectedVector.y) - (screen->h / 2)),
+        projectedVector.z );
+}
 
-        /* Maximum value per channel */
-        WriteHexString(file, "00ff00ff00ff");
+void Device::TiledToRgb(const Uint32* tiled, int width, int startRow, int endRow, const SDL_PixelFormat* format, Uint8* rgb)
+{
+    int tilesX = (width + FRAMEBUFFER_TILE_SIZE - 1) / FRAMEBUFFER_TILE_SIZE;
+    bool packed = format->BytesPerPixel == 4 && format->Rloss == 0 && format->Gloss == 0 && format->Bloss == 0;
 
-        /* Samples per pixel for each channel */
-        WriteHexString(file, "000100010001");
+    for (int y = startRow; y < endRow; ++y)
+    {
+        Uint8* row = rgb + y * width * 3;
+        int tileRow = (y >> FRAMEBUFFER_TILE_SHIFT) * tilesX;
+        int inside = (y & (FRAMEBUFFER_TILE_SIZE - 1)) << FRAMEBUFFER_TILE_SHIFT;
+        for (int x = 0; x < width; ++x)
+        {
+            int tile = tileRow + (x >> FRAMEBUFFER_TILE_SHIFT);
+            Uint32 pixel = tiled[(tile << (FRAMEBUFFER_TILE_SHIFT * 2)) + inside + (x & (FRAMEBUFFER_TILE_SIZE - 1))];
 
-        SDL_RWclose(file);
+            // Whole byte channels can be shifted straight out, anything else goes through SDL
+            if (packed)
+            {
+                *row++ = (Uint8)(pixel >> format->Rshift);
+                *row++ = (Uint8)(pixel >> format->Gshift);
+                *row++ = (Uint8)(pixel >> format->Bshift);
+            }
+            else
+            {
+                SDL_GetRGB(pixel, format, row, row + 1, row + 2);
+                row += 3;
+            }
+        }
     }
 }
+
+void Device::WriteToFile(const char* filename, ImageFormat format)
+{
+    Uint8* buffer = new Uint8[renderWidth * renderHeight * 3];
+
+    // Every row converts on its own, so they're spread across the job system
+    Jobs::ParallelFor(renderHeight, 16, [this, buffer](int start, int end)
+    {
+        TiledToRgb(colorBuffer, renderWidth, start, end, screen->format, buffer);
+    });
+
+    WriteImage(filename, buffer, renderWidth, renderHeight, format);
+    delete[] buffer;
+}
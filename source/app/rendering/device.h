@@ -3,9 +3,90 @@
 
 #include <SDL/SDL.h>
 #include "color.h"
+#include "depth.h"
+#include "dirtytiles.h"
+#include "image.h"
 #include "math/vector3.h"
 #include "math/matrix.h"
 
+// The color and depth buffers are stored as square tiles of this many pixels, one after another, with each tile
+// stored row by row. Neighbouring rows of a triangle then land in the same few cache lines instead of a whole
+// screen width apart, and the screen only sees a normal linear layout once Present copies it out
+const int FRAMEBUFFER_TILE_SHIFT = 3;
+const int FRAMEBUFFER_TILE_SIZE = 1 << FRAMEBUFFER_TILE_SHIFT;
+
+// What the last present left on a window surface, shared by every device that presents to it
+// so a present only has to copy what's different from the frame already showing
+struct PresentedScreen
+{
+    PresentedScreen()
+        : background(0), valid(false)
+    {}
+
+    // The tiles the frame on screen drew into, everything else is the background color
+    DirtyTiles tiles;
+    Uint32 background;
+
+    // Cleared whenever the surface gets changed some other way, the next present then copies everything
+    bool valid;
+
+    // The parts of the surface the last present changed, ready for SDL_UpdateWindowSurfaceRects
+    std::vector<SDL_Rect> rects;
+};
+
+// Mixes two channel values as (source * alpha + dest * (255 - alpha)) / 255 rounded to the nearest, without a divide
+// The wide blends in the device do exactly the same sums, so they match this pixel for pixel
+inline Uint8 MixChannel(int source, int dest, int alpha)
+{
+    int mixed = source * alpha + dest * (255 - alpha) + 128;
+    return (Uint8)((mixed + (mixed >> 8)) >> 8);
+}
+
+// Moves each channel of a pixel alpha / 255 of the way toward c. Packed formats just shift the channels in and out,
+// and they're the ones worth keeping fast, anything else goes through SDL. Set one up per draw with the screen's
+// Format and HasPackedFormat, for drawing code that writes into the color buffer itself
+struct PixelBlender
+{
+    PixelBlender(const SDL_PixelFormat* _format, bool _packed)
+        : format(_format), packed(_packed), rshift(_format->Rshift), gshift(_format->Gshift), bshift(_format->Bshift), amask(_format->Amask)
+    {}
+
+    inline Uint32 Blend(Uint32 pixel, const Color& c, int alpha) const
+    {
+        if (packed)
+        {
+            return BlendMapped(pixel, ((Uint32)c.r << rshift) | ((Uint32)c.g << gshift) | ((Uint32)c.b << bshift), alpha);
+        }
+
+        Uint8 r, g, b;
+        SDL_GetRGB(pixel, format, &r, &g, &b);
+        r = MixChannel(c.r, r, alpha);
+        g = MixChannel(c.g, g, alpha);
+        b = MixChannel(c.b, b, alpha);
+        return SDL_MapRGB(format, r, g, b);
+    }
+
+    // The same for packed formats with the color already mapped, for drawing that maps it once up front
+    // MixChannel's sums on two channels at a time, each gets 16 bits of the word so they can't run into each other.
+    // The pixel keeps its own alpha bits, whatever the mapped color has there is ignored
+    inline Uint32 BlendMapped(Uint32 pixel, Uint32 mapped, int alpha) const
+    {
+        Uint32 inverse = 255 - alpha;
+        Uint32 low = (mapped & 0x00FF00FF) * alpha + (pixel & 0x00FF00FF) * inverse + 0x00800080;
+        Uint32 high = ((mapped >> 8) & 0x00FF00FF) * alpha + ((pixel >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+        low = ((low + ((low >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+        high = (high + ((high >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+        return (pixel & amask) | ((low | high) & ~amask);
+    }
+
+    const SDL_PixelFormat* format;
+    bool packed;
+    Uint32 rshift;
+    Uint32 gshift;
+    Uint32 bshift;
+    Uint32 amask;
+};
+
 class Device
 {
 public:
@@ -13,8 +94,33 @@ public:
     ~Device();
 
     // Clears the screen buffer to the given color
+    // With dirty tracking on and the same color as last time, only the tiles drawn since the last clear get cleared
     void Clear(Color color);
 
+    // Keeps the clears and presents down to the tiles that were drawn to. Drawing marks tiles either way,
+    // this only decides whether Clear and Present make use of them
+    void SetDirtyTracking(bool enabled);
+    bool DirtyTracking() const { return dirtyTracking; }
+
+    // The tiles drawn to since the last clear
+    const DirtyTiles& Dirty() const { return dirtyTiles; }
+
+    // Marks the tiles under a block of pixels, from left, top to right, bottom inclusive and already on the screen
+    // Anything that writes to the buffers without going through PutPixel needs to call this. Threads can mark at the
+    // same time as long as they stick to their own tiles, which the binner already makes sure of
+    void MarkDirty(int left, int top, int right, int bottom) { dirtyTiles.MarkPixels(left, top, right, bottom); }
+
+    // How much memory the last clear wrote to
+    Uint64 BytesCleared() const { return bytesCleared; }
+
+    // Copies the tiled framebuffer out to the screen surface, this needs to happen before the surface is shown
+    void Present();
+
+    // Copies only the tiles that changed from the frame on screen, which is the ones this frame drew plus
+    // the ones the last frame drew, then fills in screen.rects with what changed
+    // Copies everything when dirty tracking is off, or the screen was left with a different background
+    void Present(PresentedScreen& presented);
+
 	// Grabs the color from the screen at the given coordinates
 	Color GetPixel(int x, int y);
 
@@ -24,6 +130,60 @@ public:
     // Puts a pixel on the screen only if it passes our depth buffer test and ignoring clipping
     void PutPixel(int x, int y, float z, Color c = Color(0xFFFFFF));
 
+    // Tests the depth against the depth buffer ignoring clip checks, if it's closer we store it and return true
+    // Depth has to match the format the buffer is currently in, and with compression on the tile has to be expanded
+    template <class Depth>
+    inline bool TestDepth(int x, int y, float z)
+    {
+        typename Depth::Stored& depth = DepthBuffer<Depth>()[PixelIndex(x, y)];
+        typename Depth::Stored incoming = Depth::Encode(z);
+        if (!Depth::Passes(incoming, depth))
+        {
+            return false;
+        }
+
+        depth = incoming;
+        return true;
+    }
+
+    // Switches how depth is stored, the buffer is reallocated so it needs a clear before being used
+    void SetDepthFormat(DepthFormat format);
+    DepthFormat GetDepthFormat() const { return depthFormat; }
+
+    // Compressed depth keeps track of 8x8 tiles that are either fast cleared, covered by one triangle's plane,
+    // or stored per pixel. Clears only touch the tiles, and tiles only get expanded when a triangle partially covers them
+    // Changing this needs a clear before the buffer is used again
+    void SetDepthCompression(bool enabled);
+    bool DepthCompression() const { return depthCompression; }
+
+    // Hands out a block of ids for TrianglePlane, one per triangle, so a draw can number its triangles up front
+    // and fill them from any thread. These restart on every clear
+    Uint32 ReserveTriangleIds(int count)
+    {
+        Uint32 first = triangleCounter + 1;
+        triangleCounter += count;
+        return first;
+    }
+
+    // Works out how a triangle's pixels inside a compressed depth tile should be tested
+    // If they need testing per pixel the tile is expanded first, so TestDepth can be used on it
+    template <class Depth>
+    inline DepthTileVerdict ClassifyDepthTile(int tileX, int tileY, const TrianglePlane& plane)
+    {
+        DepthTile& tile = depthTiles[tileX + tileY * tilesX];
+        if (tile.state == DEPTH_TILE_EXPANDED)
+        {
+            return DEPTH_TEST_PIXELS;
+        }
+
+        if (tile.triangle == plane.id)
+        {
+            return (DepthTileVerdict)tile.verdict;
+        }
+
+        return ClassifyCompressedTile<Depth>(tile, tileX, tileY, plane);
+    }
+
     // Draws a point on the screen if it's within the viewport, taking into account depth
     void DrawPoint(float x, float y, float z, Color color);
     inline void DrawPoint(Vector3 point, Color color) { DrawPoint(point.x, point.y, point.z, color); }
@@ -31,17 +191,103 @@ public:
     // Draws a point on the screen if it's within the viewport, ignoring depth
     void DrawPoint(int x, int y, const Color& c);
 
+    // Turns a color into the screen's pixel format, for filling lots of spans with one color
+    Uint32 MapColor(const Color& c) const { return SDL_MapRGBA(screen->format, c.r, c.g, c.b, c.a); }
+
+    // Fills the pixels from x0 to x1 inclusive on row y, ignoring depth. The span is clipped to the screen once,
+    // then whole tile rows are filled eight pixels at a time. The mapped version takes a color from MapColor
+    void FillSpan(int y, int x0, int x1, const Color& c) { FillSpanMapped(y, x0, x1, MapColor(c)); }
+    void FillSpanMapped(int y, int x0, int x1, Uint32 pixel);
+
+    // Fills a width by height block with its top left corner at x, y, clipped to the screen
+    void FillRect(int x, int y, int width, int height, const Color& c);
+
+    // The span compositor for anti-aliased 2D drawing. Mixes c over x0 to x1 inclusive on row y by alpha out of 255,
+    // where 255 just fills the span. The color's own alpha is ignored, the same as everywhere else
+    void BlendSpan(int y, int x0, int x1, const Color& c, Uint8 alpha);
+
+    // Mixes c over count pixels from x, y, each by its own alpha. With AVX2 and a packed format it works on
+    // whole tile rows, eight pixels at a time
+    void BlendCoverage(int y, int x, int count, const Uint8* alpha, const Color& c);
+
+    // The same for a block of rows, stride alphas apart, so a glyph or sprite only sets up the blend once
+    void BlendCoverage(int y, int x, int width, int height, const Uint8* alpha, int stride, const Color& c);
+
     // Returns a new vector projected onto the screen using the completed transformation matrix
     Vector3 Project(const Vector3& v, const Matrix& transform) const;
 
     int Width(){ return renderWidth; }
     int Height(){ return renderHeight; }
 
-    void WriteToFile(const char* filename);
+    // Where a pixel lives in the tiled buffers. Rows of a tile are contiguous, so a run of
+    // pixels inside one tile row (like a SIMD group lined up on the tile) can be read and written in one go
+    inline int PixelIndex(int x, int y) const
+    {
+        int tile = (y >> FRAMEBUFFER_TILE_SHIFT) * tilesX + (x >> FRAMEBUFFER_TILE_SHIFT);
+        int inside = ((y & (FRAMEBUFFER_TILE_SIZE - 1)) << FRAMEBUFFER_TILE_SHIFT) + (x & (FRAMEBUFFER_TILE_SIZE - 1));
+        return (tile << (FRAMEBUFFER_TILE_SHIFT * 2)) + inside;
+    }
+
+    // Raw access to the buffers, for rasterizers that want to work on more than one pixel at a time
+    // Index them with PixelIndex
+    Uint32* ColorBuffer() { return colorBuffer; }
+    template <class Depth>
+    typename Depth::Stored* DepthBuffer() { return (typename Depth::Stored *)depthBuffer; }
+    const SDL_PixelFormat* Format() const { return screen->format; }
+
+    // True when every channel is a full byte in a 32 bit pixel, so colors can be packed with plain shifts
+    bool HasPackedFormat() const;
+
+    // How many pixels the color buffer holds, it covers whole tiles so this can be more than the screen
+    int ColorBufferSize() const { return bufferSize; }
+
+    // Turns rows of a tiled color buffer (this one or a copy of it) into plain rgb rows, rgb points at the start of the whole image
+    static void TiledToRgb(const Uint32* tiled, int width, int startRow, int endRow, const SDL_PixelFormat* format, Uint8* rgb);
+
+    // Writes the color buffer out straight away, FrameCapture does the same thing without holding up the caller
+    void WriteToFile(const char* filename, ImageFormat format = IMAGE_TIFF);
 
 private:
+    // Runs the depth test for whatever format we're in, for the single pixel functions
+    bool TestDepth(int x, int y, float z);
+
+    // Clears the whole depth buffer, or just the marked tiles when given some
+    template <class Depth>
+    void ClearDepth(const DirtyTiles* tiles);
+
+    template <class Depth>
+    bool TestDepthExpanded(int x, int y, float z);
+
+
+    template <class Depth>
+    DepthTileVerdict ClassifyCompressedTile(DepthTile& tile, int tileX, int tileY, const TrianglePlane& plane);
+
+    // Writes out the per pixel values a cleared or plane tile stands for
+    template <class Depth>
+    void ExpandDepthTile(DepthTile& tile, int tileX, int tileY);
+
     SDL_Surface* screen;
-    float* depthBuffer;
+    Uint32* colorBuffer;
+    Uint8* depthBuffer;
+    DepthFormat depthFormat;
+
+    // The buffers cover whole tiles, so they can be a little bigger than the screen
+    int tilesX;
+    int tilesY;
+    int bufferSize;
+
+    DepthTile* depthTiles;
+    bool depthCompression;
+    Uint32 triangleCounter;
+    Uint64 bytesCleared;
+
+    DirtyTiles dirtyTiles;
+    bool dirtyTracking;
+
+    // What the color buffer was last cleared to in the screen's format, and whether the next clear has to
+    // cover everything anyway, like after the depth buffer's been reallocated
+    Uint32 clearColor;
+    bool fullClear;
     int renderWidth;
     int renderHeight;
 };
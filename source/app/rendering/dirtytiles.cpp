@@ -0,0 +1,96 @@
+#include "dirtytiles.h"
+#include <algorithm>
+
+void DirtyTiles::Reset(int _tilesX, int _tilesY, int _tileShift)
+{
+    tilesX = _tilesX;
+    tilesY = _tilesY;
+    tileShift = _tileShift;
+    flags.assign(tilesX * tilesY, 0);
+}
+
+void DirtyTiles::MarkAll()
+{
+    std::fill(flags.begin(), flags.end(), 1);
+}
+
+void DirtyTiles::ClearAll()
+{
+    std::fill(flags.begin(), flags.end(), 0);
+}
+
+void DirtyTiles::Add(const DirtyTiles& other)
+{
+    for (size_t i = 0; i < flags.size(); ++i)
+    {
+        flags[i] |= other.flags[i];
+    }
+}
+
+int DirtyTiles::MarkedCount() const
+{
+    int count = 0;
+    for (size_t i = 0; i < flags.size(); ++i)
+    {
+        count += flags[i];
+    }
+    return count;
+}
+
+void DirtyTiles::GetRects(int width, int height, std::vector<SDL_Rect>& rects) const
+{
+    rects.clear();
+
+    // The rectangles that reached the bottom of the last row, any that don't carry on into this row are finished
+    std::vector<int> open;
+    std::vector<int> stillOpen;
+    int tileSize = 1 << tileShift;
+
+    for (int tileY = 0; tileY < tilesY; ++tileY)
+    {
+        int y = tileY * tileSize;
+        int rowHeight = SDL_min(tileSize, height - y);
+        stillOpen.clear();
+
+        int tileX = 0;
+        while (tileX < tilesX)
+        {
+            if (!flags[tileY * tilesX + tileX])
+            {
+                ++tileX;
+                continue;
+            }
+
+            int start = tileX;
+            while (tileX < tilesX && flags[tileY * tilesX + tileX])
+            {
+                ++tileX;
+            }
+
+            int x = start * tileSize;
+            int runWidth = SDL_min(tileX * tileSize, width) - x;
+
+            bool merged = false;
+            for (size_t i = 0; i < open.size(); ++i)
+            {
+                SDL_Rect& rect = rects[open[i]];
+                if (rect.x == x && rect.w == runWidth)
+                {
+                    rect.h += rowHeight;
+                    stillOpen.push_back(open[i]);
+                    merged = true;
+                    break;
+                }
+            }
+
+            if (!merged)
+            {
+                SDL_Rect rect = { x, y, runWidth, rowHeight };
+                stillOpen.push_back((int)rects.size());
+                rects.push_back(rect);
+            }
+        }
+
+        open.swap(stillOpen);
+    }
+}
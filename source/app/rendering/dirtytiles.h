@@ -0,0 +1,55 @@
+#ifndef RENDERING_DIRTYTILES_H
+#define RENDERING_DIRTYTILES_H
+
+#include <SDL/SDL.h>
+#include <string.h>
+#include <vector>
+
+// One flag per framebuffer tile saying something was drawn there. Tiles are what the buffers are made of, so clearing
+// or copying a marked tile is one contiguous block, and a flag is cheap enough to set for every pixel a 2D draw puts down
+class DirtyTiles
+{
+public:
+    DirtyTiles()
+        : tilesX(0), tilesY(0), tileShift(0)
+    {}
+
+    // Sizes the flags for a grid of tiles 1 << tileShift pixels wide, with every tile unmarked
+    void Reset(int _tilesX, int _tilesY, int _tileShift);
+
+    void Mark(int tile) { flags[tile] = 1; }
+
+    // Marks every tile touching the pixels from left, top to right, bottom inclusive. The caller keeps them on the screen
+    void MarkPixels(int left, int top, int right, int bottom)
+    {
+        int firstX = left >> tileShift;
+        int lastX = right >> tileShift;
+        for (int tileY = top >> tileShift; tileY <= bottom >> tileShift; ++tileY)
+        {
+            memset(&flags[tileY * tilesX + firstX], 1, lastX - firstX + 1);
+        }
+    }
+
+    void MarkAll();
+    void ClearAll();
+    bool Marked(int tile) const { return flags[tile] != 0; }
+
+    // Marks everything that's marked in other as well, both have to be the same size
+    void Add(const DirtyTiles& other);
+
+    int TileCount() const { return (int)flags.size(); }
+    int MarkedCount() const;
+    int TilesX() const { return tilesX; }
+
+    // Covers the marked tiles with rectangles clipped to a width by height screen. Each row of tiles is cut into
+    // runs, and a run that lines up exactly with one in the row above is merged into it, so a solid block is one rectangle
+    void GetRects(int width, int height, std::vector<SDL_Rect>& rects) const;
+
+private:
+    std::vector<Uint8> flags;
+    int tilesX;
+    int tilesY;
+    int tileShift;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "font.h"
+
+struct Glyph
+{
+    char character;
+
+    // One row per entry from the top down, the highest of the three bits is the left column
+    Uint8 rows[FONT_GLYPH_HEIGHT];
+};
+
+static const Glyph glyphs[] =
+{
+    { '0', { 7, 5, 5, 5, 7 } },
+    { '1', { 2, 6, 2, 2, 7 } },
+    { '2', { 7, 1, 7, 4, 7 } },
+    { '3', { 7, 1, 7, 1, 7 } },
+    { '4', { 5, 5, 7, 1, 1 } },
+    { '5', { 7, 4, 7, 1, 7 } },
+    { '6', { 7, 4, 7, 5, 7 } },
+    { '7', { 7, 1, 1, 1, 1 } },
+    { '8', { 7, 5, 7, 5, 7 } },
+    { '9', { 7, 5, 7, 1, 7 } },
+    { 'A', { 2, 5, 7, 5, 5 } },
+    { 'B', { 6, 5, 6, 5, 6 } },
+    { 'C', { 3, 4, 4, 4, 3 } },
+    { 'D', { 6, 5, 5, 5, 6 } },
+    { 'E', { 7, 4, 6, 4, 7 } },
+    { 'F', { 7, 4, 6, 4, 4 } },
+    { 'G', { 3, 4, 5, 5, 3 } },
+    { 'H', { 5, 5, 7, 5, 5 } },
+    { 'I', { 7, 2, 2, 2, 7 } },
+    { 'J', { 1, 1, 1, 5, 2 } },
+    { 'K', { 5, 5, 6, 5, 5 } },
+    { 'L', { 4, 4, 4, 4, 7 } },
+    { 'M', { 5, 7, 7, 5, 5 } },
+    { 'N', { 6, 5, 5, 5, 5 } },
+    { 'O', { 2, 5, 5, 5, 2 } },
+    { 'P', { 6, 5, 6, 4, 4 } },
+    { 'Q', { 2, 5, 5, 6, 3 } },
+    { 'R', { 6, 5, 6, 5, 5 } },
+    { 'S', { 3, 4, 2, 1, 6 } },
+    { 'T', { 7, 2, 2, 2, 2 } },
+    { 'U', { 5, 5, 5, 5, 7 } },
+    { 'V', { 5, 5, 5, 5, 2 } },
+    { 'W', { 5, 5, 7, 7, 5 } },
+    { 'X', { 5, 5, 2, 5, 5 } },
+    { 'Y', { 5, 5, 2, 2, 2 } },
+    { 'Z', { 7, 1, 2, 4, 7 } },
+    { '.', { 0, 0, 0, 0, 2 } },
+    { ',', { 0, 0, 0, 2, 4 } },
+    { ':', { 0, 2, 0, 2, 0 } },
+    { '-', { 0, 0, 7, 0, 0 } },
+    { '+', { 0, 2, 7, 2, 0 } },
+    { '%', { 5, 1, 2, 4, 5 } },
+    { '/', { 1, 1, 2, 4, 4 } },
+    { '(', { 1, 2, 2, 2, 1 } },
+    { ')', { 4, 2, 2, 2, 4 } },
+};
+
+static const Glyph* FindGlyph(char character)
+{
+    if (character >= 'a' && character <= 'z')
+    {
+        character = character - 'a' + 'A';
+    }
+
+    // There's few enough of these that a search is plenty fast for a few lines of text
+    for (size_t i = 0; i < sizeof(glyphs) / sizeof(glyphs[0]); ++i)
+    {
+        if (glyphs[i].character == character)
+        {
+            return &glyphs[i];
+        }
+    }
+
+    return NULL;
+}
+
+const Uint8* FindGlyphRows(char character)
+{
+    const Glyph* glyph = FindGlyph(character);
+    return glyph ? glyph->rows : NULL;
+}
+
+void DrawString(Device* screen, int x, int y, const char* text, Color color, int scale)
+{
+    for (; *text; ++text, x += FONT_ADVANCE * scale)
+    {
+        const Glyph* glyph = FindGlyph(*text);
+        if (!glyph)
+        {
+            continue;
+        }
+
+        for (int row = 0; row < FONT_GLYPH_HEIGHT; ++row)
+        {
+            for (int column = 0; column < FONT_GLYPH_WIDTH; ++column)
+            {
+                if (!(glyph->rows[row] & (4 >> column)))
+                {
+                    continue;
+                }
+
+                // DrawPoint throws away anything off the screen, so text can run off the edge
+                for (int py = 0; py < scale; ++py)
+                {
+                    for (int px = 0; px < scale; ++px)
+                    {
+                        screen->DrawPoint(x + column * scale + px, y + row * scale + py, color);
+                    }
+                }
+            }
+        }
+    }
+}
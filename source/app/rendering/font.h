@@ -0,0 +1,22 @@
+#ifndef RENDERING_FONT_H
+#define RENDERING_FONT_H
+
+#include "device.h"
+#include "color.h"
+
+// A tiny built in bitmap font, every glyph is 3 pixels wide and 5 tall with a pixel of space around it
+// It only has upper case letters, digits and a bit of punctuation, lower case gets drawn as upper case
+const int FONT_GLYPH_WIDTH = 3;
+const int FONT_GLYPH_HEIGHT = 5;
+const int FONT_ADVANCE = FONT_GLYPH_WIDTH + 1;
+const int FONT_LINE_HEIGHT = FONT_GLYPH_HEIGHT + 2;
+
+// The rows of a character's glyph from the top down, the highest of the three bits is the left column
+// Lower case gives the upper case glyph, and anything we don't have a glyph for gives NULL
+const Uint8* FindGlyphRows(char character);
+
+// Draws a line of text with its top left corner at x, y, every font pixel becomes a scale by scale square
+// Anything we don't have a glyph for is left blank
+void DrawString(Device* screen, int x, int y, const char* text, Color color, int scale = 1);
+
+#endif
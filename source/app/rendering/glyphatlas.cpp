@@ -0,0 +1,140 @@
+#include "glyphatlas.h"
+#include <math.h>
+#include <string.h>
+
+// Scales are rounded to this fraction of a pixel, so text drawn at nearly the same size shares its glyphs
+const int GLYPH_SCALE_STEPS = 16;
+
+// How much of the span from start to end falls inside the pixel at position
+static float Overlap(int position, float start, float end)
+{
+    return SDL_max(0.0f, SDL_min(end, position + 1.0f) - SDL_max(start, (float)position));
+}
+
+// Each font pixel is a square scale pixels wide, so a screen pixel's coverage is just how much of each square it overlaps
+// Rows and columns overlap separately, so the area is one times the other
+static void RasterizeGlyph(const Uint8* rows, float scale, float shift, Uint8* coverage, int& width, int& height)
+{
+    width = SDL_min((int)ceilf(shift + FONT_GLYPH_WIDTH * scale), GLYPH_SLOT_SIZE);
+    height = SDL_min((int)ceilf(FONT_GLYPH_HEIGHT * scale), GLYPH_SLOT_SIZE);
+
+    for (int y = 0; y < height; ++y)
+    {
+        float columns[FONT_GLYPH_WIDTH] = {};
+        for (int row = 0; row < FONT_GLYPH_HEIGHT; ++row)
+        {
+            float down = Overlap(y, row * scale, (row + 1) * scale);
+            for (int column = 0; column < FONT_GLYPH_WIDTH && down > 0.0f; ++column)
+            {
+                if (rows[row] & (4 >> column))
+                {
+                    columns[column] += down;
+                }
+            }
+        }
+
+        Uint8* line = coverage + y * GLYPH_SLOT_SIZE;
+        for (int x = 0; x < width; ++x)
+        {
+            float covered = 0.0f;
+            for (int column = 0; column < FONT_GLYPH_WIDTH; ++column)
+            {
+                if (columns[column] > 0.0f)
+                {
+                    covered += columns[column] * Overlap(x, shift + column * scale, shift + (column + 1) * scale);
+                }
+            }
+
+            line[x] = (Uint8)(SDL_min(covered, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+GlyphAtlas::GlyphAtlas()
+    : drawCount(0), rasterizeCount(0)
+{
+    coverage.resize(GLYPH_ATLAS_SLOTS * GLYPH_SLOT_SIZE * GLYPH_SLOT_SIZE);
+}
+
+void GlyphAtlas::Clear()
+{
+    slots.clear();
+    lookup.clear();
+}
+
+float GlyphAtlas::Width(const char* text, float scale)
+{
+    return strlen(text) * FONT_ADVANCE * SDL_min(scale, GLYPH_MAX_SCALE);
+}
+
+int GlyphAtlas::FindSlot(char character, const Uint8* rows, float scale, int subpixel)
+{
+    int scaleSteps = (int)(scale * GLYPH_SCALE_STEPS + 0.5f);
+    Uint32 key = (Uint8)character | (subpixel << 8) | (scaleSteps << 10);
+
+    std::map<Uint32, int>::iterator found = lookup.find(key);
+    if (found != lookup.end())
+    {
+        slots[found->second].lastUsed = drawCount;
+        return found->second;
+    }
+
+    int index = (int)slots.size();
+    if (slots.size() >= GLYPH_ATLAS_SLOTS)
+    {
+        index = 0;
+        for (size_t i = 1; i < slots.size(); ++i)
+        {
+            if (slots[i].lastUsed < slots[index].lastUsed)
+            {
+                index = (int)i;
+            }
+        }
+
+        lookup.erase(slots[index].key);
+    }
+    else
+    {
+        slots.resize(slots.size() + 1);
+    }
+
+    GlyphSlot& slot = slots[index];
+    slot.key = key;
+    slot.lastUsed = drawCount;
+    RasterizeGlyph(rows, scaleSteps / (float)GLYPH_SCALE_STEPS, subpixel / (float)GLYPH_SUBPIXEL_STEPS,
+        &coverage[index * GLYPH_SLOT_SIZE * GLYPH_SLOT_SIZE], slot.width, slot.height);
+    lookup[key] = index;
+    ++rasterizeCount;
+
+    return index;
+}
+
+void GlyphAtlas::Draw(Device* screen, float x, float y, const char* text, Color color, float scale)
+{
+    scale = SDL_min(scale, GLYPH_MAX_SCALE);
+    if (!(scale > 0.0f))
+    {
+        return;
+    }
+
+    ++drawCount;
+    int top = (int)floorf(y + 0.5f);
+    float advance = FONT_ADVANCE * scale;
+
+    for (; *text; ++text, x += advance)
+    {
+        const Uint8* rows = FindGlyphRows(*text);
+        if (!rows)
+        {
+            continue;
+        }
+
+        int left = (int)floorf(x);
+        int subpixel = SDL_min((int)((x - left) * GLYPH_SUBPIXEL_STEPS), GLYPH_SUBPIXEL_STEPS - 1);
+        int index = FindSlot(*text, rows, scale, subpixel);
+
+        // BlendCoverage clips the glyph to the screen, so text can run off the edge
+        const GlyphSlot& slot = slots[index];
+        screen->BlendCoverage(top, left, slot.width, slot.height, &coverage[index * GLYPH_SLOT_SIZE * GLYPH_SLOT_SIZE], GLYPH_SLOT_SIZE, color);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef RENDERING_GLYPHATLAS_H
+#define RENDERING_GLYPHATLAS_H
+
+#include <map>
+#include <vector>
+#include "device.h"
+#include "color.h"
+#include "font.h"
+
+// Every glyph gets a square slot this many pixels wide in the atlas, which is what caps how big text can get
+const int GLYPH_SLOT_SIZE = 32;
+
+// How many glyphs the atlas holds before it throws out the one drawn longest ago
+const int GLYPH_ATLAS_SLOTS = 256;
+
+// Text can start a quarter of a pixel apart, each quarter is its own glyph in the atlas
+const int GLYPH_SUBPIXEL_STEPS = 4;
+
+// The biggest scale that still fits a glyph and its subpixel shift in a slot, bigger text is drawn at this
+const float GLYPH_MAX_SCALE = (GLYPH_SLOT_SIZE - 1) / (float)FONT_GLYPH_HEIGHT;
+
+// Draws text out of the built in font at any scale, not just whole ones, with smooth edges
+// Each glyph is worked out once for its scale and where it sits within a pixel, and kept as coverage in the atlas.
+// Drawing a string after that is just blending the coverage rows onto the screen
+class GlyphAtlas
+{
+public:
+    GlyphAtlas();
+
+    // Draws a line of text with its top left corner at x, y, with every font pixel scale screen pixels wide
+    // Text is placed to a quarter pixel across and to the nearest pixel down
+    void Draw(Device* screen, float x, float y, const char* text, Color color, float scale = 1.0f);
+
+    // How wide a string comes out at a scale, up to the end of the last glyph's spacing
+    static float Width(const char* text, float scale = 1.0f);
+
+    // Throws out every glyph, they get rasterized again as they're drawn
+    void Clear();
+
+    // How many glyphs have been rasterized into the atlas, which should stop going up once the text in use settles
+    int RasterizeCount() const { return rasterizeCount; }
+
+private:
+    struct GlyphSlot
+    {
+        Uint32 key;
+        Uint32 lastUsed;
+        int width;
+        int height;
+    };
+
+    // Finds the glyph in the atlas, rasterizing it over the one drawn longest ago if it isn't there
+    int FindSlot(char character, const Uint8* rows, float scale, int subpixel);
+
+    std::vector<GlyphSlot> slots;
+    std::vector<Uint8> coverage;
+    std::map<Uint32, int> lookup;
+    Uint32 drawCount;
+    int rasterizeCount;
+};
+
+#endif
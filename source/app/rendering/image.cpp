@@ -0,0 +1,525 @@
+#include "image.h"
+#include <string.h>
+#include <algorithm>
+#include "deflate.h"
+#include "../jobs.h"
+#include "../profiler.h"
+
+// How many rows go into each strip of a compressed image. Strips compress on their own so they can be spread
+// across threads, and smaller strips spread better but compress a little worse since matches can't reach back into the last one
+const int IMAGE_STRIP_ROWS = 32;
+
+const char* ImageExtension(ImageFormat format)
+{
+    return format == IMAGE_PNG ? "png" : "tif";
+}
+
+const char* ImageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+    case IMAGE_TIFF: return "tiff";
+    case IMAGE_TIFF_PACKBITS: return "tiff-packbits";
+    case IMAGE_TIFF_LZW: return "tiff-lzw";
+    case IMAGE_TIFF_DEFLATE: return "tiff-deflate";
+    case IMAGE_PNG: return "png";
+    default: return "unknown";
+    }
+}
+
+static void PutBE16(std::vector<Uint8>& out, Uint16 value)
+{
+    out.push_back((Uint8)(value >> 8));
+    out.push_back((Uint8)value);
+}
+
+static void PutBE32(std::vector<Uint8>& out, Uint32 value)
+{
+    PutBE16(out, (Uint16)(value >> 16));
+    PutBE16(out, (Uint16)value);
+}
+
+static void Append(std::vector<Uint8>& out, const Uint8* data, size_t size)
+{
+    if (size > 0)
+    {
+        size_t start = out.size();
+        out.resize(start + size);
+        memcpy(&out[start], data, size);
+    }
+}
+
+// Each strip is encoded into its own buffer on whichever thread picks it up, then they're stitched together in order
+template <class Encode>
+static void EncodeStrips(std::vector<std::vector<Uint8> >& strips, int height, Encode encode)
+{
+    strips.resize((height + IMAGE_STRIP_ROWS - 1) / IMAGE_STRIP_ROWS);
+    Jobs::ParallelFor((int)strips.size(), 1, [&](int start, int end)
+    {
+        PROFILE_ZONE("Encode strip");
+        for (int strip = start; strip < end; ++strip)
+        {
+            int firstRow = strip * IMAGE_STRIP_ROWS;
+            int lastRow = SDL_min(firstRow + IMAGE_STRIP_ROWS, height);
+            strips[strip].clear();
+            encode(strips[strip], strip, firstRow, lastRow);
+        }
+    });
+}
+
+// Runs of three or more of the same byte become a count and the byte, everything else is copied across
+// in chunks of up to 128 with a count in front
+static void PackBits(const Uint8* data, int size, std::vector<Uint8>& out)
+{
+    int i = 0;
+    while (i < size)
+    {
+        int run = 1;
+        while (i + run < size && run < 128 && data[i + run] == data[i])
+        {
+            ++run;
+        }
+
+        if (run >= 3)
+        {
+            out.push_back((Uint8)(1 - run));
+            out.push_back(data[i]);
+            i += run;
+            continue;
+        }
+
+        int start = i;
+        while (i < size && i - start < 128)
+        {
+            if (i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2])
+            {
+                break;
+            }
+            ++i;
+        }
+
+        out.push_back((Uint8)(i - start - 1));
+        Append(out, data + start, i - start);
+    }
+}
+
+const int LZW_CLEAR = 256;
+const int LZW_END = 257;
+const int LZW_FIRST_CODE = 258;
+
+// Tiff decoders clear the table once it holds this many codes, so we have to as well
+const int LZW_LAST_CODE = 4094;
+
+const int LZW_HASH_BITS = 13;
+
+// Lzw codes go out highest bit first, the other way around from deflate
+struct LzwWriter
+{
+    LzwWriter(std::vector<Uint8>& _out)
+        : out(_out), bits(0), count(0)
+    {}
+
+    void Put(Uint32 code, int width)
+    {
+        bits = (bits << width) | code;
+        count += width;
+        while (count >= 8)
+        {
+            count -= 8;
+            out.push_back((Uint8)(bits >> count));
+        }
+        bits &= (1 << count) - 1;
+    }
+
+    void Finish()
+    {
+        if (count > 0)
+        {
+            out.push_back((Uint8)(bits << (8 - count)));
+        }
+    }
+
+    std::vector<Uint8>& out;
+    Uint32 bits;
+    int count;
+};
+
+// Lzw the way tiff does it, codes start at 9 bits and grow to 12, and they grow one code earlier
+// than plain lzw would, which every tiff reader expects
+static void Lzw(const Uint8* data, size_t size, std::vector<Uint8>& out)
+{
+    // The table maps a code followed by a byte to the code for the two together. Keys are stored
+    // one higher so zero can mark an empty slot
+    std::vector<Uint32> keys(1 << LZW_HASH_BITS, 0);
+    std::vector<Uint16> codes(1 << LZW_HASH_BITS);
+
+    LzwWriter writer(out);
+    int width = 9;
+    int nextCode = LZW_FIRST_CODE;
+    writer.Put(LZW_CLEAR, width);
+
+    if (size == 0)
+    {
+        writer.Put(LZW_END, width);
+        writer.Finish();
+        return;
+    }
+
+    Uint32 prefix = data[0];
+    for (size_t i = 1; i < size; ++i)
+    {
+        Uint32 key = ((prefix << 8) | data[i]) + 1;
+        Uint32 slot = (key * 2654435761u) >> (32 - LZW_HASH_BITS);
+        while (keys[slot] != 0 && keys[slot] != key)
+        {
+            slot = (slot + 1) & ((1 << LZW_HASH_BITS) - 1);
+        }
+
+        if (keys[slot] == key)
+        {
+            prefix = codes[slot];
+            continue;
+        }
+
+        writer.Put(prefix, width);
+        keys[slot] = key;
+        codes[slot] = (Uint16)nextCode++;
+
+        if (nextCode == LZW_LAST_CODE)
+        {
+            writer.Put(LZW_CLEAR, width);
+            std::fill(keys.begin(), keys.end(), 0);
+            width = 9;
+            nextCode = LZW_FIRST_CODE;
+        }
+        else if (nextCode > (1 << width) - 1)
+        {
+            ++width;
+        }
+
+        prefix = data[i];
+    }
+
+    // The reader adds a code for the last one it reads too, so the width can still grow before the end code
+    writer.Put(prefix, width);
+    if (++nextCode > (1 << width) - 1 && width < 12)
+    {
+        ++width;
+    }
+
+    writer.Put(LZW_END, width);
+    writer.Finish();
+}
+
+// A zlib stream is a two byte header, the deflate data and the adler32 of what went in
+static void PutZlibHeader(std::vector<Uint8>& out)
+{
+    // Deflate with a 32k window, flagged as the fastest compression level
+    out.push_back(0x78);
+    out.push_back(0x01);
+}
+
+// One entry of the image file directory. Values that fit in four bytes are stored in the entry itself,
+// shorts sit in the first two bytes, anything bigger is an offset to where it's stored after the directory
+static void PutEntry(std::vector<Uint8>& out, Uint16 tag, Uint16 type, Uint32 count, Uint32 value)
+{
+    const Uint16 TIFF_SHORT = 3;
+    PutBE16(out, tag);
+    PutBE16(out, type);
+    PutBE32(out, count);
+    if (type == TIFF_SHORT && count == 1)
+    {
+        PutBE16(out, (Uint16)value);
+        PutBE16(out, 0);
+    }
+    else
+    {
+        PutBE32(out, value);
+    }
+}
+
+static void EncodeTiff(std::vector<Uint8>& out, const Uint8* rgb, int width, int height, ImageFormat format)
+{
+    // Based on the layout from http://paulbourke.net/dataformats/tiff/, header first, then the pixels,
+    // then the directory and the per channel values
+    const Uint16 SHORT = 3;
+    const Uint16 LONG = 4;
+    int rowBytes = width * 3;
+    Uint32 numbytes = rowBytes * height;
+
+    Uint16 compression = 1;
+    std::vector<std::vector<Uint8> > strips;
+    if (format == IMAGE_TIFF_PACKBITS)
+    {
+        compression = 32773;
+        EncodeStrips(strips, height, [&](std::vector<Uint8>& strip, int, int firstRow, int lastRow)
+        {
+            // Packbits works a row at a time, runs never carry on into the next row
+            for (int y = firstRow; y < lastRow; ++y)
+            {
+                PackBits(rgb + y * rowBytes, rowBytes, strip);
+            }
+        });
+    }
+    else if (format == IMAGE_TIFF_LZW || format == IMAGE_TIFF_DEFLATE)
+    {
+        compression = format == IMAGE_TIFF_LZW ? 5 : 8;
+        EncodeStrips(strips, height, [&](std::vector<Uint8>& strip, int, int firstRow, int lastRow)
+        {
+            // The predictor stores each channel as the change from the pixel to its left,
+            // smooth shading turns into long runs of the same few values that way
+            std::vector<Uint8> differences(rgb + firstRow * rowBytes, rgb + lastRow * rowBytes);
+            for (int y = 0; y < lastRow - firstRow; ++y)
+            {
+                Uint8* row = &differences[y * rowBytes];
+                for (int x = rowBytes - 1; x >= 3; --x)
+                {
+                    row[x] -= row[x - 3];
+                }
+            }
+
+            if (format == IMAGE_TIFF_LZW)
+            {
+                Lzw(&differences[0], differences.size(), strip);
+            }
+            else
+            {
+                PutZlibHeader(strip);
+                Deflate(&differences[0], differences.size(), true, strip);
+                PutBE32(strip, Adler32(1, &differences[0], differences.size()));
+            }
+        });
+    }
+
+    // Uncompressed images are one strip of every row, which keeps the pixels in one piece after the header
+    int rowsPerStrip = strips.empty() ? height : IMAGE_STRIP_ROWS;
+    Uint32 stripCount = strips.empty() ? 1 : (Uint32)strips.size();
+    bool predictor = compression == 5 || compression == 8;
+
+    std::vector<Uint32> stripOffsets;
+    std::vector<Uint32> stripSizes;
+    Uint32 offset = 8; // 8 bytes are from the header
+    if (strips.empty())
+    {
+        stripOffsets.push_back(offset);
+        stripSizes.push_back(numbytes);
+        offset += numbytes;
+    }
+    else
+    {
+        for (size_t i = 0; i < strips.size(); ++i)
+        {
+            stripOffsets.push_back(offset);
+            stripSizes.push_back((Uint32)strips[i].size());
+            offset += (Uint32)strips[i].size();
+        }
+    }
+
+    // The directory comes after the pixels and has to start on an even byte
+    Uint32 directoryOffset = offset + (offset & 1);
+    Uint16 entryCount = predictor ? 15 : 14;
+    Uint32 extra = directoryOffset + 2 + entryCount * 12 + 4;
+
+    // Strips only need lists of offsets and sizes when there's more than one
+    Uint32 stripOffsetsValue = stripCount == 1 ? stripOffsets[0] : extra + 24;
+    Uint32 stripSizesValue = stripCount == 1 ? stripSizes[0] : extra + 24 + stripCount * 4;
+
+    out.clear();
+    out.reserve(directoryOffset + 256 + stripCount * 8);
+    out.push_back('M');
+    out.push_back('M');
+    PutBE16(out, 42);
+    PutBE32(out, directoryOffset);
+
+    if (strips.empty())
+    {
+        Append(out, rgb, numbytes);
+    }
+    else
+    {
+        for (size_t i = 0; i < strips.size(); ++i)
+        {
+            Append(out, strips[i].empty() ? NULL : &strips[i][0], strips[i].size());
+        }
+    }
+
+    if (offset & 1)
+    {
+        out.push_back(0);
+    }
+
+    PutBE16(out, entryCount);
+    PutEntry(out, 0x0100, SHORT, 1, width);
+    PutEntry(out, 0x0101, SHORT, 1, height);
+    PutEntry(out, 0x0102, SHORT, 3, extra);                     // Bits per sample
+    PutEntry(out, 0x0103, SHORT, 1, compression);
+    PutEntry(out, 0x0106, SHORT, 1, 2);                         // Photometric interpretation, rgb
+    PutEntry(out, 0x0111, LONG, stripCount, stripOffsetsValue);
+    PutEntry(out, 0x0112, SHORT, 1, 1);                         // Orientation, top left
+    PutEntry(out, 0x0115, SHORT, 1, 3);                         // Samples per pixel
+    PutEntry(out, 0x0116, SHORT, 1, rowsPerStrip);
+    PutEntry(out, 0x0117, LONG, stripCount, stripSizesValue);   // Strip byte counts
+    PutEntry(out, 0x0118, SHORT, 3, extra + 6);                 // Minimum sample value
+    PutEntry(out, 0x0119, SHORT, 3, extra + 12);                // Maximum sample value
+    PutEntry(out, 0x011c, SHORT, 1, 1);                         // Planar configuration, interleaved
+    if (predictor)
+    {
+        PutEntry(out, 0x013d, SHORT, 1, 2);                     // Predictor, horizontal differences
+    }
+    PutEntry(out, 0x0153, SHORT, 3, extra + 18);                // Sample format
+    PutBE32(out, 0);                                            // End of the directory
+
+    const Uint16 channelValues[4] = { 8, 0, 255, 1 };
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            PutBE16(out, channelValues[i]);
+        }
+    }
+
+    if (stripCount > 1)
+    {
+        for (Uint32 i = 0; i < stripCount; ++i)
+        {
+            PutBE32(out, stripOffsets[i]);
+        }
+
+        for (Uint32 i = 0; i < stripCount; ++i)
+        {
+            PutBE32(out, stripSizes[i]);
+        }
+    }
+}
+
+// Png filters each row before it's compressed. We try no filter, the difference from the pixel to the left,
+// and the difference from the pixel above, and keep whichever has the smallest differences, the usual rule of thumb
+// Paeth and average get skipped, they cost more than they save on the kind of pictures we draw
+// Filtered bytes are differences, so they're measured as how far they are from zero either way
+static inline Uint32 Magnitude(Uint8 value)
+{
+    return value < 128 ? value : 256 - value;
+}
+
+static void FilterRow(const Uint8* row, const Uint8* above, int rowBytes, Uint8* out)
+{
+    Uint32 noneSum = 0;
+    Uint32 subSum = 0;
+    Uint32 upSum = 0;
+    for (int x = 0; x < rowBytes; ++x)
+    {
+        Uint8 left = x >= 3 ? row[x - 3] : 0;
+        Uint8 up = above ? above[x] : 0;
+        noneSum += Magnitude(row[x]);
+        subSum += Magnitude(row[x] - left);
+        upSum += Magnitude(row[x] - up);
+    }
+
+    Uint8 filter = 0;
+    if (subSum < noneSum && subSum <= upSum)
+    {
+        filter = 1;
+    }
+    else if (upSum < noneSum)
+    {
+        filter = 2;
+    }
+
+    out[0] = filter;
+    ++out;
+    for (int x = 0; x < rowBytes; ++x)
+    {
+        Uint8 left = x >= 3 ? row[x - 3] : 0;
+        Uint8 up = above ? above[x] : 0;
+        out[x] = filter == 1 ? row[x] - left : filter == 2 ? row[x] - up : row[x];
+    }
+}
+
+static void PutChunk(std::vector<Uint8>& out, const char* type, const Uint8* data, size_t size)
+{
+    PutBE32(out, (Uint32)size);
+    size_t start = out.size();
+    Append(out, (const Uint8*)type, 4);
+    Append(out, data, size);
+    PutBE32(out, Crc32(0, &out[start], size + 4));
+}
+
+static void EncodePng(std::vector<Uint8>& out, const Uint8* rgb, int width, int height)
+{
+    int rowBytes = width * 3;
+
+    // Every strip is filtered and deflated on its own, only the last one finishes the stream
+    // The adler32 of each strip is worked out alongside, and they're combined into one for the whole stream after
+    std::vector<Uint32> adlers((height + IMAGE_STRIP_ROWS - 1) / IMAGE_STRIP_ROWS);
+    std::vector<size_t> filteredSizes(adlers.size());
+    std::vector<std::vector<Uint8> > strips;
+    EncodeStrips(strips, height, [&](std::vector<Uint8>& strip, int index, int firstRow, int lastRow)
+    {
+        std::vector<Uint8> filtered((lastRow - firstRow) * (rowBytes + 1));
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            const Uint8* row = rgb + y * rowBytes;
+            FilterRow(row, y > 0 ? row - rowBytes : NULL, rowBytes, &filtered[(y - firstRow) * (rowBytes + 1)]);
+        }
+
+        Deflate(&filtered[0], filtered.size(), lastRow == height, strip);
+        adlers[index] = Adler32(1, &filtered[0], filtered.size());
+        filteredSizes[index] = filtered.size();
+    });
+
+    std::vector<Uint8> idat;
+    PutZlibHeader(idat);
+    Uint32 adler = 1;
+    for (size_t i = 0; i < strips.size(); ++i)
+    {
+        Append(idat, &strips[i][0], strips[i].size());
+        adler = Adler32Combine(adler, adlers[i], filteredSizes[i]);
+    }
+    PutBE32(idat, adler);
+
+    std::vector<Uint8> header;
+    PutBE32(header, width);
+    PutBE32(header, height);
+    header.push_back(8);    // Bits per channel
+    header.push_back(2);    // Rgb
+    header.push_back(0);    // Deflate
+    header.push_back(0);    // Filtered a row at a time
+    header.push_back(0);    // Not interlaced
+
+    static const Uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.clear();
+    out.reserve(idat.size() + 64);
+    Append(out, signature, sizeof(signature));
+    PutChunk(out, "IHDR", &header[0], header.size());
+    PutChunk(out, "IDAT", &idat[0], idat.size());
+    PutChunk(out, "IEND", NULL, 0);
+}
+
+void EncodeImage(std::vector<Uint8>& out, const Uint8* rgb, int width, int height, ImageFormat format)
+{
+    PROFILE_ZONE("Encode image");
+    if (format == IMAGE_PNG)
+    {
+        EncodePng(out, rgb, width, height);
+    }
+    else
+    {
+        EncodeTiff(out, rgb, width, height, format);
+    }
+}
+
+bool WriteImage(const char* filename, const Uint8* rgb, int width, int height, ImageFormat format)
+{
+    std::vector<Uint8> encoded;
+    EncodeImage(encoded, rgb, width, height, format);
+
+    SDL_RWops* file = SDL_RWFromFile(filename, "w+b");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool written = SDL_RWwrite(file, &encoded[0], encoded.size(), 1) == 1;
+    SDL_RWclose(file);
+    return written;
+}
@@ -0,0 +1,31 @@
+#ifndef RENDERING_IMAGE_H
+#define RENDERING_IMAGE_H
+
+#include <SDL/SDL.h>
+#include <vector>
+
+enum ImageFormat
+{
+    // Uncompressed, the pixels come straight after the 8 byte header
+    IMAGE_TIFF,
+
+    // Tiffs cut into strips that each compress on their own
+    IMAGE_TIFF_PACKBITS,
+    IMAGE_TIFF_LZW,
+    IMAGE_TIFF_DEFLATE,
+
+    IMAGE_PNG,
+
+    IMAGE_FORMAT_COUNT
+};
+
+// The file extension for a format, without the dot
+const char* ImageExtension(ImageFormat format);
+const char* ImageFormatName(ImageFormat format);
+
+// Turns 8 bit rgb rows into a whole file in memory. The compressed formats work on strips of rows spread across the job system
+void EncodeImage(std::vector<Uint8>& out, const Uint8* rgb, int width, int height, ImageFormat format);
+
+bool WriteImage(const char* filename, const Uint8* rgb, int width, int height, ImageFormat format = IMAGE_TIFF);
+
+#endif
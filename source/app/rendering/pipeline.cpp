@@ -0,0 +1,290 @@
+#include "pipeline.h"
+#include "../jobs.h"
+#include "../profiler.h"
+#include "../debug.h"
+
+// Everything the geometry stage needs, kept alive on the stack while the job runs
+struct BuildJob
+{
+    FrameGeometry* frame;
+    int width;
+    int height;
+    Mesh* mesh;
+    const DrawState* state;
+};
+
+static void RunBuildJob(void* data)
+{
+    BuildJob* job = (BuildJob *)data;
+    BuildGeometry(*job->frame, job->width, job->height, *job->mesh, *job->state);
+}
+
+FramePipeline::FramePipeline(SDL_Window* _window, SDL_Surface* surface)
+    : window(_window), current(0), pipelined(true), built(false),
+    statsOverlay(false), statsFile(NULL), statsFrame(0),
+    capturing(false), captureFrame(0), presenting(NULL), quitting(false)
+{
+    devices[0] = new Device(surface);
+    devices[1] = new Device(surface);
+    devices[0]->SetDirtyTracking(true);
+    devices[1]->SetDirtyTracking(true);
+
+    // A frame of png is a small fraction of the raw pixels, which matters a lot more than the time to compress it
+    capture.SetFormat(IMAGE_PNG);
+    presentThread = std::thread(&FramePipeline::PresentLoop, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        std::lock_guard<std::mutex> guard(presentLock);
+        quitting = true;
+    }
+    presentSignal.notify_all();
+    presentThread.join();
+
+    StopStatsRecording();
+
+    delete devices[0];
+    delete devices[1];
+}
+
+void FramePipeline::RunFrame(Mesh& mesh, const DrawState& state)
+{
+    PROFILE_ZONE("Frame");
+
+    Device* target = devices[current];
+
+    if (!pipelined)
+    {
+        BuildGeometry(frames[current], target->Width(), target->Height(), mesh, state);
+        target->Clear(Color(0x000000));
+        RasterizeGeometry(target, frames[current], stats);
+        DrawClock(target);
+        FinishFrame(target);
+        PresentFrame(target);
+        return;
+    }
+
+    // The last frame has usually been copied out by now, so it can go up on the window without waiting for the next one
+    ShowPresented();
+
+    // The very first frame doesn't have anything built ahead of time, so it has to wait on its geometry
+    if (!built)
+    {
+        BuildGeometry(frames[current], target->Width(), target->Height(), mesh, state);
+        built = true;
+    }
+
+    // Start building the next frame. It's just another job, so the workers pick it up in between filling bins
+    int next = 1 - current;
+    BuildJob job;
+    job.frame = &frames[next];
+    job.width = target->Width();
+    job.height = target->Height();
+    job.mesh = &mesh;
+    job.state = &state;
+
+    JobCounter geometryDone;
+    Jobs::Run(RunBuildJob, &job, &geometryDone);
+
+    // This framebuffer was last shown two frames ago, and that finished before the previous frame got handed off
+    target->Clear(Color(0x000000));
+    RasterizeGeometry(target, frames[current], stats);
+    DrawClock(target);
+    FinishFrame(target);
+    Jobs::Wait(&geometryDone);
+
+    SubmitPresent(target);
+    current = next;
+}
+
+void FramePipeline::Flush()
+{
+    WaitForPresent();
+    ShowPresented();
+}
+
+void FramePipeline::SetPipelined(bool enabled)
+{
+    Flush();
+    pipelined = enabled;
+    built = false;
+}
+
+void FramePipeline::SetDepthFormat(DepthFormat format)
+{
+    Flush();
+    devices[0]->SetDepthFormat(format);
+    devices[1]->SetDepthFormat(format);
+}
+
+void FramePipeline::SetDepthCompression(bool enabled)
+{
+    Flush();
+    devices[0]->SetDepthCompression(enabled);
+    devices[1]->SetDepthCompression(enabled);
+}
+
+void FramePipeline::SetDirtyRects(bool enabled)
+{
+    Flush();
+    devices[0]->SetDirtyTracking(enabled);
+    devices[1]->SetDirtyTracking(enabled);
+}
+
+void FramePipeline::InvalidateWindow()
+{
+    Flush();
+    presented.valid = false;
+}
+
+bool FramePipeline::StartStatsRecording(const char* filename)
+{
+    StopStatsRecording();
+
+    statsFile = fopen(filename, "w");
+    if (!statsFile)
+    {
+        Debug::console("Unable to write stats %s\n", filename);
+        return false;
+    }
+
+    RenderStats::WriteCsvHeader(statsFile);
+    statsFrame = 0;
+    return true;
+}
+
+void FramePipeline::StopStatsRecording()
+{
+    if (statsFile)
+    {
+        fclose(statsFile);
+        statsFile = NULL;
+    }
+}
+
+bool FramePipeline::StartStreaming(const char* filename, VideoFormat format, int framesPerSecond)
+{
+    return capture.OpenStream(filename, format, devices[0]->Width(), devices[0]->Height(), framesPerSecond);
+}
+
+void FramePipeline::StopStreaming()
+{
+    capture.CloseStream();
+}
+
+void FramePipeline::SetCapturing(bool enabled)
+{
+    if (capturing && !enabled)
+    {
+        capture.Flush();
+    }
+
+    capturing = enabled;
+    captureFrame = 0;
+}
+
+void FramePipeline::FinishFrame(Device* target)
+{
+    if (statsOverlay)
+    {
+        DrawStatsOverlay(target, stats);
+    }
+
+    if (statsFile)
+    {
+        stats.WriteCsvRow(statsFile, statsFrame++);
+    }
+
+    if (capturing)
+    {
+        char filename[64];
+        SDL_snprintf(filename, sizeof(filename), "capture_%05d.%s", captureFrame++, ImageExtension(capture.Format()));
+        capture.Capture(target, filename);
+    }
+
+    if (capture.Streaming())
+    {
+        capture.Capture(target, NULL);
+    }
+}
+
+// Copies finished frames out to the window surface. The surface is plain memory, and the main thread only hands
+// it to SDL in between frames, so resolving the tiles into it is fine from here. Telling the window is left to the main thread
+void FramePipeline::PresentLoop()
+{
+    Profiler::SetThreadName("Present");
+
+    std::unique_lock<std::mutex> guard(presentLock);
+    while (true)
+    {
+        presentSignal.wait(guard, [this]() { return presenting != NULL || quitting; });
+        if (!presenting)
+        {
+            break;
+        }
+
+        Device* device = presenting;
+        guard.unlock();
+
+        {
+            PROFILE_ZONE("Present");
+            device->Present(presented);
+        }
+
+        guard.lock();
+        windowRects = presented.rects;
+        presenting = NULL;
+        presentSignal.notify_all();
+    }
+}
+
+void FramePipeline::PresentFrame(Device* device)
+{
+    PROFILE_ZONE("Present");
+    device->Present(presented);
+
+    // A frame that looks just like the last one has nothing to show
+    if (!presented.rects.empty())
+    {
+        SDL_UpdateWindowSurfaceRects(window, &presented.rects[0], (int)presented.rects.size());
+    }
+}
+
+void FramePipeline::ShowPresented()
+{
+    std::vector<SDL_Rect> rects;
+    {
+        std::lock_guard<std::mutex> guard(presentLock);
+        if (presenting)
+        {
+            return;
+        }
+
+        rects.swap(windowRects);
+    }
+
+    // The present thread is idle until the next frame is handed off, so the surface holds still while SDL reads it
+    if (!rects.empty())
+    {
+        SDL_UpdateWindowSurfaceRects(window, &rects[0], (int)rects.size());
+    }
+}
+
+void FramePipeline::SubmitPresent(Device* device)
+{
+    // The previous frame has to reach the window before the next one starts overwriting the surface
+    WaitForPresent();
+    ShowPresented();
+
+    std::lock_guard<std::mutex> guard(presentLock);
+    presenting = device;
+    presentSignal.notify_all();
+}
+
+void FramePipeline::WaitForPresent()
+{
+    std::unique_lock<std::mutex> guard(presentLock);
+    presentSignal.wait(guard, [this]() { return presenting == NULL; });
+}
@@ -0,0 +1,121 @@
+#ifndef RENDERING_PIPELINE_H
+#define RENDERING_PIPELINE_H
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "device.h"
+#include "tests.h"
+#include "stats.h"
+#include "capture.h"
+
+// Runs frames through three stages: building geometry, filling it in, and showing it on the window
+// When pipelining is on, the geometry for the next frame is built while the workers fill the current one,
+// and a separate thread copies finished frames out to the window surface. Every stage has two copies of its data so they never share,
+// which means a frame takes about as long as the slowest stage instead of all of them added together
+class FramePipeline
+{
+public:
+    FramePipeline(SDL_Window* window, SDL_Surface* surface);
+    ~FramePipeline();
+
+    // Fills one frame and hands it off to be shown. When pipelining, the frame being filled is the one
+    // that was built last time around, so what's on screen is one frame behind the input
+    void RunFrame(Mesh& mesh, const DrawState& state);
+
+    // Waits for everything in flight to make it to the window
+    void Flush();
+
+    void SetPipelined(bool enabled);
+    bool Pipelined() const { return pipelined; }
+
+    // These change both framebuffers, so they wait for anything in flight first
+    void SetDepthFormat(DepthFormat format);
+    DepthFormat GetDepthFormat() const { return devices[0]->GetDepthFormat(); }
+    void SetDepthCompression(bool enabled);
+    bool DepthCompression() const { return devices[0]->DepthCompression(); }
+
+    // Only clears and copies out the tiles that were drawn this frame or last, and only tells the window about those
+    void SetDirtyRects(bool enabled);
+    bool DirtyRects() const { return devices[0]->DirtyTracking(); }
+
+    // The next present updates the whole window, for when the window's been covered up or resized
+    void InvalidateWindow();
+
+    // The counters from the last frame that was filled
+    const RenderStats& Stats() const { return stats; }
+
+    // Draws the counters on top of every frame
+    void SetStatsOverlay(bool enabled) { statsOverlay = enabled; }
+    bool StatsOverlay() const { return statsOverlay; }
+
+    // Appends a line of counters to a csv file for every frame until recording is stopped
+    bool StartStatsRecording(const char* filename);
+    void StopStatsRecording();
+    bool RecordingStats() const { return statsFile != NULL; }
+
+    // Writes every frame out to capture_00000.png and on, counting up from zero each time capturing starts
+    // Stopping waits for the frames that are still being written
+    void SetCapturing(bool enabled);
+    bool Capturing() const { return capturing; }
+    FrameCapture& Capture() { return capture; }
+
+    // Appends every frame to one video stream until it's stopped, "-" streams to standard output
+    bool StartStreaming(const char* filename, VideoFormat format, int framesPerSecond = 60);
+    void StopStreaming();
+    bool Streaming() const { return capture.Streaming(); }
+
+private:
+    // Draws the overlays on the frame that was just filled, then records its counters and captures it
+    void FinishFrame(Device* target);
+
+    void PresentLoop();
+
+    // Copies a frame out to the window surface and shows it, all on the calling thread
+    void PresentFrame(Device* device);
+
+    // Tells the window about whatever the present thread has finished copying out. SDL's video calls are only safe
+    // on the main thread, so this gets called from there, and it leaves a frame that's still being copied alone
+    void ShowPresented();
+
+    // Hands a filled frame to the present thread, waiting for it to finish the previous one and showing that first
+    void SubmitPresent(Device* device);
+    void WaitForPresent();
+
+    SDL_Window* window;
+
+    Device* devices[2];
+    FrameGeometry frames[2];
+    int current;
+
+    bool pipelined;
+
+    // Set once frames[current] holds geometry that hasn't been filled yet
+    bool built;
+
+    RenderStats stats;
+    bool statsOverlay;
+    FILE* statsFile;
+    int statsFrame;
+
+    FrameCapture capture;
+    bool capturing;
+    int captureFrame;
+
+    // Only used by whichever thread is presenting
+    PresentedScreen presented;
+
+    // What the present thread copied out last, waiting for the main thread to show it. Guarded by presentLock
+    std::vector<SDL_Rect> windowRects;
+
+    std::thread presentThread;
+    std::mutex presentLock;
+    std::condition_variable presentSignal;
+    Device* presenting;
+    bool quitting;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef RENDERING_SIMD_H
+#define RENDERING_SIMD_H
+
+// The wide code paths only get compiled in when the compiler is allowed to emit AVX2 (/arch:AVX2 or -mavx2)
+// Everything else falls back to the plain scalar loops, so non x86 builds keep working
+#if defined(__AVX2__)
+#define RENDERING_AVX2 1
+#include <immintrin.h>
+#else
+#define RENDERING_AVX2 0
+#endif
+
+// How many pixels the wide paths work on at once
+const int SIMD_WIDTH = 8;
+
+#endif
@@ -0,0 +1,55 @@
+#include "stats.h"
+
+void RenderStats::Reset()
+{
+    verticesTransformed = 0;
+    trianglesSubmitted = 0;
+    trianglesCulled = 0;
+    trianglesClipped = 0;
+    trianglesRasterized = 0;
+    fragmentsGenerated = 0;
+    fragmentsDepthRejected = 0;
+    fragmentsWritten = 0;
+    bytesCleared = 0;
+    screenPixels = 0;
+}
+
+void RenderStats::Add(const RenderStats& other)
+{
+    verticesTransformed += other.verticesTransformed;
+    trianglesSubmitted += other.trianglesSubmitted;
+    trianglesCulled += other.trianglesCulled;
+    trianglesClipped += other.trianglesClipped;
+    trianglesRasterized += other.trianglesRasterized;
+    fragmentsGenerated += other.fragmentsGenerated;
+    fragmentsDepthRejected += other.fragmentsDepthRejected;
+    fragmentsWritten += other.fragmentsWritten;
+    bytesCleared += other.bytesCleared;
+    screenPixels = SDL_max(screenPixels, other.screenPixels);
+}
+
+float RenderStats::Overdraw() const
+{
+    if (screenPixels == 0)
+    {
+        return 0.0f;
+    }
+
+    return (float)((double)fragmentsGenerated / screenPixels);
+}
+
+void RenderStats::WriteCsvHeader(FILE* file)
+{
+    fprintf(file, "frame,vertices_transformed,triangles_submitted,triangles_culled,triangles_clipped,triangles_rasterized,"
+        "fragments_generated,fragments_depth_rejected,fragments_written,overdraw,bytes_cleared\n");
+}
+
+void RenderStats::WriteCsvRow(FILE* file, int frame) const
+{
+    fprintf(file, "%d,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%.4f,%llu\n", frame,
+        (unsigned long long)verticesTransformed, (unsigned long long)trianglesSubmitted,
+        (unsigned long long)trianglesCulled, (unsigned long long)trianglesClipped,
+        (unsigned long long)trianglesRasterized, (unsigned long long)fragmentsGenerated,
+        (unsigned long long)fragmentsDepthRejected, (unsigned long long)fragmentsWritten,
+        Overdraw(), (unsigned long long)bytesCleared);
+}
@@ -0,0 +1,47 @@
+#ifndef RENDERING_STATS_H
+#define RENDERING_STATS_H
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+
+// Counts of the work that went into a frame, so we can see where the time goes and catch regressions
+struct RenderStats
+{
+    RenderStats() { Reset(); }
+
+    void Reset();
+    void Add(const RenderStats& other);
+
+    // Fragments generated per pixel on the screen, 1 means every pixel was touched once on average
+    float Overdraw() const;
+
+    // One line per frame, the header names every column in the same order
+    static void WriteCsvHeader(FILE* file);
+    void WriteCsvRow(FILE* file, int frame) const;
+
+    Uint64 verticesTransformed;
+
+    Uint64 trianglesSubmitted;
+
+    // Triangles completely off the screen, these never make it into a bin
+    Uint64 trianglesCulled;
+
+    // Triangles hanging over the edge of the screen, only the part on screen gets filled
+    Uint64 trianglesClipped;
+
+    // Triangles that went into at least one bin
+    Uint64 trianglesRasterized;
+
+    // Pixels inside triangles, the ones that fail the depth test are rejected and the rest get written
+    Uint64 fragmentsGenerated;
+    Uint64 fragmentsDepthRejected;
+    Uint64 fragmentsWritten;
+
+    // Memory touched by the clear, which is a lot less with compressed depth
+    Uint64 bytesCleared;
+
+    // The size of the screen, so the overdraw means something
+    Uint64 screenPixels;
+};
+
+#endif
@@ -35,45 +35,47 @@ void StrokeCircle(Device* screen, int cx, int cy, Uint32 radius, Color c)
 	}
 }
 
-void DrawScanLineClipped(Device* screen, int sx, int ex, int y, Color c)
-{
-	if (y >= 0 && y < screen->Height())
-	{
-		sx = SDL_max(sx, 0);
-		ex = SDL_min(ex, screen->Width() - 1);
-
-		for (int x = sx; x <= ex; ++x)
-		{
-			screen->PutPixel(x, y, c);
-		}
-	}
-}
-
 // To draw a circle we use a modified form of the besenham algorithm above
-// instead of drawing just points, we draw lines between the points
+// instead of drawing just points, we fill the spans between the points
+// Rows at cy +- x come up once each, but rows at cy +- y come up again for every x until y moves on,
+// so those only get filled once they've reached their widest
 void FillCircle(Device* screen, int cx, int cy, Uint32 radius, Color c)
 {
+	Uint32 pixel = screen->MapColor(c);
 	int determinant = 3 - 2 * radius;
 	int x = 0;
 	int y = radius;
+	bool widestFilled = false;
 
 	while (x <= y)
 	{
-		DrawScanLineClipped(screen, cx - x, cx + x, cy + y, c);
-		DrawScanLineClipped(screen, cx - x, cx + x, cy - y, c);
-		DrawScanLineClipped(screen, cx - y, cx + y, cy + x, c);
-		DrawScanLineClipped(screen, cx - y, cx + y, cy - x, c);
+		screen->FillSpanMapped(cy + x, cx - y, cx + y, pixel);
+		if (x > 0)
+		{
+			screen->FillSpanMapped(cy - x, cx - y, cx + y, pixel);
+		}
 
 		if (determinant < 0)
 		{
 			determinant += (4 * x) + 6;
+			widestFilled = false;
 		}
 		else
 		{
+			screen->FillSpanMapped(cy + y, cx - x, cx + x, pixel);
+			screen->FillSpanMapped(cy - y, cx - x, cx + x, pixel);
 			determinant += 4 * (x - y) + 10;
 			--y;
+			widestFilled = true;
 		}
 
 		++x;
 	}
+
+	// The last rows at cy +- y still need doing if y didn't move on the final step
+	if (!widestFilled)
+	{
+		screen->FillSpanMapped(cy + y, cx - (x - 1), cx + (x - 1), pixel);
+		screen->FillSpanMapped(cy - y, cx - (x - 1), cx + (x - 1), pixel);
+	}
 }
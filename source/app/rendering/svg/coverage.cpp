@@ -0,0 +1,172 @@
+#include "coverage.h"
+#include <math.h>
+#include <algorithm>
+
+void AddPolygonEdges(std::vector<PathEdge>& edges, const PolygonPoint* points, int count)
+{
+	if (count < 3)
+	{
+		return;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		const PolygonPoint& a = points[i];
+		const PolygonPoint& b = points[(i + 1) % count];
+		if (a.y == b.y)
+		{
+			continue;
+		}
+
+		PathEdge edge;
+		if (a.y < b.y)
+		{
+			edge.x0 = a.x;
+			edge.y0 = a.y;
+			edge.x1 = b.x;
+			edge.y1 = b.y;
+			edge.winding = 1;
+		}
+		else
+		{
+			edge.x0 = b.x;
+			edge.y0 = b.y;
+			edge.x1 = a.x;
+			edge.y1 = a.y;
+			edge.winding = -1;
+		}
+
+		edges.push_back(edge);
+	}
+}
+
+void CoverageRasterizer::Fill(Device* screen, const ClipRect& clip, const PathEdge* edges, int count, const Color& c, FillRule rule, Uint8 opacity)
+{
+	int left = SDL_max(clip.left, 0);
+	int right = SDL_min(clip.right, screen->Width());
+	if (count <= 0 || opacity == 0 || left >= right)
+	{
+		return;
+	}
+
+	// The edge table, every edge in the order its top reaches a row
+	edgeTable.resize(count);
+	float minY = edges[0].y0;
+	float maxY = edges[0].y1;
+	for (int i = 0; i < count; ++i)
+	{
+		edgeTable[i] = i;
+		minY = SDL_min(minY, edges[i].y0);
+		maxY = SDL_max(maxY, edges[i].y1);
+	}
+
+	std::sort(edgeTable.begin(), edgeTable.end(), [edges](int a, int b) { return edges[a].y0 < edges[b].y0; });
+
+	int top = SDL_max(SDL_max(clip.top, 0), (int)floorf(minY));
+	int bottom = SDL_min(SDL_min(clip.bottom, screen->Height()), (int)ceilf(maxY));
+
+	activeEdges.clear();
+	int nextEdge = 0;
+
+	for (int y = top; y < bottom; ++y)
+	{
+		float rowTop = (float)y;
+		float rowBottom = rowTop + 1.0f;
+
+		while (nextEdge < count && edges[edgeTable[nextEdge]].y0 < rowBottom)
+		{
+			activeEdges.push_back(edgeTable[nextEdge++]);
+		}
+
+		cells.clear();
+		for (size_t i = 0; i < activeEdges.size();)
+		{
+			const PathEdge& edge = edges[activeEdges[i]];
+			if (edge.y1 <= rowTop)
+			{
+				activeEdges[i] = activeEdges.back();
+				activeEdges.pop_back();
+				continue;
+			}
+
+			float ya = SDL_max(edge.y0, rowTop);
+			float yb = SDL_min(edge.y1, rowBottom);
+			float slope = (edge.x1 - edge.x0) / (edge.y1 - edge.y0);
+			SplitRowSegment(edge.x0 + (ya - edge.y0) * slope, ya, edge.x0 + (yb - edge.y0) * slope, yb, edge.winding, left, right,
+				[this](int x, float cover, float area)
+				{
+					Cell cell;
+					cell.x = x;
+					cell.cover = cover;
+					cell.area = area;
+					cells.push_back(cell);
+				});
+			++i;
+		}
+
+		if (cells.empty())
+		{
+			continue;
+		}
+
+		// Edges sharing a pixel all add into the one cell
+		std::sort(cells.begin(), cells.end());
+		size_t cellCount = 0;
+		for (size_t i = 0; i < cells.size(); ++i)
+		{
+			if (cellCount > 0 && cells[cellCount - 1].x == cells[i].x)
+			{
+				cells[cellCount - 1].cover += cells[i].cover;
+				cells[cellCount - 1].area += cells[i].area;
+			}
+			else
+			{
+				cells[cellCount++] = cells[i];
+			}
+		}
+
+		// Walking left to right, the cover of every cell passed so far is what fills the pixels between cells,
+		// so those come out as one span each and only the cells themselves need blending one at a time
+		float winding = 0.0f;
+		int runStart = 0;
+		alphas.clear();
+
+		for (size_t i = 0; i < cellCount; ++i)
+		{
+			const Cell& cell = cells[i];
+			if (alphas.empty())
+			{
+				runStart = cell.x;
+			}
+
+			alphas.push_back(CoverageAlpha(winding + cell.cover - cell.area, rule, opacity));
+			winding += cell.cover;
+
+			int nextX = i + 1 < cellCount ? cells[i + 1].x : right;
+			if (nextX > cell.x + 1)
+			{
+				screen->BlendCoverage(y, runStart, (int)alphas.size(), &alphas[0], c);
+				alphas.clear();
+
+				Uint8 spanAlpha = CoverageAlpha(winding, rule, opacity);
+				if (spanAlpha > 0)
+				{
+					screen->BlendSpan(y, cell.x + 1, nextX - 1, c, spanAlpha);
+				}
+			}
+		}
+
+		if (!alphas.empty())
+		{
+			screen->BlendCoverage(y, runStart, (int)alphas.size(), &alphas[0], c);
+		}
+	}
+}
+
+void CoverageRasterizer::Fill(Device* screen, const ClipRect& clip, const std::vector<PathEdge>& edges, const Color& c, FillRule rule, Uint8 opacity)
+{
+	if (!edges.empty())
+	{
+		Fill(screen, clip, &edges[0], (int)edges.size(), c, rule, opacity);
+	}
+}
@@ -0,0 +1,124 @@
+#ifndef RENDERING_SVG_COVERAGE_H
+#define RENDERING_SVG_COVERAGE_H
+
+#include <math.h>
+#include <vector>
+#include "polygon.h"
+#include "../device.h"
+#include "../color.h"
+#include "../3d/rasterizer.h"
+
+// One straight piece of an outline, stored top end first. The winding says which way it originally went,
+// 1 for downwards and -1 for upwards
+struct PathEdge
+{
+	float x0;
+	float y0;
+	float x1;
+	float y1;
+	int winding;
+};
+
+// Adds the edges of a closed polygon, flat ones are left out since they never cross a row
+void AddPolygonEdges(std::vector<PathEdge>& edges, const PolygonPoint* points, int count);
+
+// Turns the winding left over in a pixel into how much of it is inside, scaled by opacity
+inline Uint8 CoverageAlpha(float value, FillRule rule, Uint8 opacity)
+{
+	value = fabsf(value);
+	if (rule == FILL_EVEN_ODD)
+	{
+		// Every second time round is a hole, and coverage between them fades in and out
+		value -= 2.0f * floorf(value * 0.5f);
+		if (value > 1.0f)
+		{
+			value = 2.0f - value;
+		}
+	}
+	else
+	{
+		value = SDL_min(value, 1.0f);
+	}
+
+	return (Uint8)(value * opacity + 0.5f);
+}
+
+// Takes a piece of an edge that sits inside one row and cuts it up at every pixel boundary it crosses, handing
+// each pixel the height it covers and how much of that was left of the edge as cell(x, cover, area)
+// Anything left of the columns from left to right gets pushed onto the left one, where it still covers everything to its right,
+// and anything past the right side can't change a pixel we draw so it's dropped
+template <class CellFunction>
+inline void SplitRowSegment(float xa, float ya, float xb, float yb, int winding, int left, int right, const CellFunction& cell)
+{
+	float dydx = xb != xa ? (yb - ya) / (xb - xa) : 0.0f;
+	float x = xa;
+	float y = ya;
+
+	while (true)
+	{
+		float nextX = xb;
+		if (xb > x)
+		{
+			float boundary = x < left ? (float)left : (x >= right ? xb : floorf(x) + 1.0f);
+			nextX = SDL_min(boundary, xb);
+		}
+		else if (xb < x)
+		{
+			float boundary = x > right ? (float)right : (x <= left ? xb : ceilf(x) - 1.0f);
+			nextX = SDL_max(boundary, xb);
+		}
+
+		float nextY = nextX == xb ? yb : ya + (nextX - xa) * dydx;
+		float middle = (x + nextX) * 0.5f;
+		float height = (nextY - y) * winding;
+
+		if (middle < left)
+		{
+			cell(left, height, 0.0f);
+		}
+		else if (middle < right)
+		{
+			int column = (int)middle;
+			cell(column, height, height * (middle - column));
+		}
+
+		if (nextX == xb)
+		{
+			break;
+		}
+
+		x = nextX;
+		y = nextY;
+	}
+}
+
+// Fills shapes with anti-aliased edges by working out how much of each pixel's area is inside
+// Rows are walked top to bottom with an active edge list, and every edge only leaves coverage in the few cells it
+// passes through, so the cost goes with the number of edges and spans rather than edges times pixels
+// One of these keeps its working memory between fills, so keep one around per thread
+class CoverageRasterizer
+{
+public:
+	// Blends c over everything inside the edges and the clip rect, opacity scales the coverage
+	void Fill(Device* screen, const ClipRect& clip, const PathEdge* edges, int count, const Color& c, FillRule rule, Uint8 opacity = 255);
+	void Fill(Device* screen, const ClipRect& clip, const std::vector<PathEdge>& edges, const Color& c, FillRule rule, Uint8 opacity = 255);
+
+private:
+	// What the edges leave behind in one pixel of the current row. Cover is how much height they crossed,
+	// area is how much of that height was left of them
+	struct Cell
+	{
+		int x;
+		float cover;
+		float area;
+
+		bool operator<(const Cell& other) const { return x < other.x; }
+	};
+
+	std::vector<int> edgeTable;
+	std::vector<int> activeEdges;
+	std::vector<Cell> cells;
+	std::vector<Uint8> alphas;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "line.h"
+#include <math.h>
+#include <algorithm>
+
+// Where the line sits across the minor axis is kept in 16.16 fixed point, so each step is one add
+// and the blend between the two pixels is just the top byte of the fraction
+const int LINE_FRACTION_BITS = 16;
+const float LINE_FIXED_ONE = (float)(1 << LINE_FRACTION_BITS);
+
+// Which side of the clip box a point is off of, one bit per side
+enum LineOutcode
+{
+	LINE_INSIDE = 0,
+	LINE_LEFT = 1,
+	LINE_RIGHT = 2,
+	LINE_TOP = 4,
+	LINE_BOTTOM = 8
+};
+
+static int Outcode(float x, float y, float left, float top, float right, float bottom)
+{
+	int code = LINE_INSIDE;
+	if (x < left)
+	{
+		code |= LINE_LEFT;
+	}
+	else if (x > right)
+	{
+		code |= LINE_RIGHT;
+	}
+
+	if (y < top)
+	{
+		code |= LINE_TOP;
+	}
+	else if (y > bottom)
+	{
+		code |= LINE_BOTTOM;
+	}
+
+	return code;
+}
+
+// Moves whichever end is outside onto the edge it's past, until both ends are in or both are past the same edge
+bool ClipLine(LineSegment& segment, float left, float top, float right, float bottom)
+{
+	float x0 = segment.x0;
+	float y0 = segment.y0;
+	float x1 = segment.x1;
+	float y1 = segment.y1;
+	int code0 = Outcode(x0, y0, left, top, right, bottom);
+	int code1 = Outcode(x1, y1, left, top, right, bottom);
+
+	while (true)
+	{
+		if (!(code0 | code1))
+		{
+			segment = LineSegment(x0, y0, x1, y1);
+			return true;
+		}
+
+		if (code0 & code1)
+		{
+			return false;
+		}
+
+		int code = code0 ? code0 : code1;
+		float x, y;
+		if (code & LINE_TOP)
+		{
+			x = x0 + (x1 - x0) * (top - y0) / (y1 - y0);
+			y = top;
+		}
+		else if (code & LINE_BOTTOM)
+		{
+			x = x0 + (x1 - x0) * (bottom - y0) / (y1 - y0);
+			y = bottom;
+		}
+		else if (code & LINE_LEFT)
+		{
+			y = y0 + (y1 - y0) * (left - x0) / (x1 - x0);
+			x = left;
+		}
+		else
+		{
+			y = y0 + (y1 - y0) * (right - x0) / (x1 - x0);
+			x = right;
+		}
+
+		if (code == code0)
+		{
+			x0 = x;
+			y0 = y;
+			code0 = Outcode(x0, y0, left, top, right, bottom);
+		}
+		else
+		{
+			x1 = x;
+			y1 = y;
+			code1 = Outcode(x1, y1, left, top, right, bottom);
+		}
+	}
+}
+
+// Walks lines straight into the color buffer for one batch, with the color mapped and the pixel format looked up once
+class LineWriter
+{
+public:
+	LineWriter(Device* _screen, const ClipRect& _clip, const Color& _color)
+		: screen(_screen), clip(_clip), color(_color), blender(_screen->Format(), _screen->HasPackedFormat()), lastTile(-1)
+	{
+		buffer = screen->ColorBuffer();
+		pixel = screen->MapColor(color);
+	}
+
+	void Draw(const LineSegment& line)
+	{
+		// The box is a pixel bigger than the clip all round so the faded edge of a line just outside still gets drawn
+		LineSegment clipped = line;
+		if (!ClipLine(clipped, (float)clip.left - 1, (float)clip.top - 1, (float)clip.right + 1, (float)clip.bottom + 1))
+		{
+			return;
+		}
+
+		// Moving pixel centers onto whole numbers makes the rounding below plain floors
+		float x0 = clipped.x0 - 0.5f;
+		float y0 = clipped.y0 - 0.5f;
+		float x1 = clipped.x1 - 0.5f;
+		float y1 = clipped.y1 - 0.5f;
+
+		if (fabsf(y1 - y0) > fabsf(x1 - x0))
+		{
+			Walk<true>(y0, x0, y1, x1);
+		}
+		else
+		{
+			Walk<false>(x0, y0, x1, y1);
+		}
+	}
+
+private:
+	// Steps along the major axis a, with b across it. Steep lines have them swapped, and Plot swaps them back
+	template <bool Steep>
+	void Walk(float a0, float b0, float a1, float b1)
+	{
+		if (a0 > a1)
+		{
+			std::swap(a0, a1);
+			std::swap(b0, b1);
+		}
+
+		float length = a1 - a0;
+		float gradient = length > 0 ? (b1 - b0) / length : 0;
+
+		// The end pixels only get as much as the part of them the line actually reaches
+		int first = (int)floorf(a0 + 0.5f);
+		int last = (int)floorf(a1 + 0.5f);
+		if (first == last)
+		{
+			EndPixel<Steep>(first, b0 + gradient * (first - a0), length);
+			return;
+		}
+
+		EndPixel<Steep>(first, b0 + gradient * (first - a0), first + 0.5f - a0);
+		EndPixel<Steep>(last, b1 + gradient * (last - a1), a1 + 0.5f - last);
+
+		// Everything past the clip along the major axis would be thrown away anyway
+		int minA = Steep ? clip.top : clip.left;
+		int maxA = (Steep ? clip.bottom : clip.right) - 1;
+		int start = SDL_max(first + 1, minA);
+		int end = SDL_min(last - 1, maxA);
+		if (start > end)
+		{
+			return;
+		}
+
+		Sint32 b = (Sint32)floorf((b0 + gradient * (start - a0)) * LINE_FIXED_ONE + 0.5f);
+		Sint32 step = (Sint32)floorf(gradient * LINE_FIXED_ONE + 0.5f);
+		for (int a = start; a <= end; ++a)
+		{
+			int across = b >> LINE_FRACTION_BITS;
+			int alpha = (b >> (LINE_FRACTION_BITS - 8)) & 255;
+			Plot<Steep>(a, across, 255 - alpha);
+			Plot<Steep>(a, across + 1, alpha);
+			b += step;
+		}
+	}
+
+	template <bool Steep>
+	void EndPixel(int a, float b, float weight)
+	{
+		float across = floorf(b);
+		float fraction = b - across;
+		Plot<Steep>(a, (int)across, (int)((1 - fraction) * weight * 255 + 0.5f));
+		Plot<Steep>(a, (int)across + 1, (int)(fraction * weight * 255 + 0.5f));
+	}
+
+	template <bool Steep>
+	inline void Plot(int a, int b, int alpha)
+	{
+		int x = Steep ? b : a;
+		int y = Steep ? a : b;
+		if (alpha <= 0 || x < clip.left || x >= clip.right || y < clip.top || y >= clip.bottom)
+		{
+			return;
+		}
+
+		// A line stays in one tile for a few steps at a time, so tiles only get marked as the line moves into them
+		int index = screen->PixelIndex(x, y);
+		int tile = index >> (FRAMEBUFFER_TILE_SHIFT * 2);
+		if (tile != lastTile)
+		{
+			screen->MarkDirty(x, y, x, y);
+			lastTile = tile;
+		}
+
+		// The same blend as the fills, so a line and a fill over the same background round the same way
+		// A full alpha comes out as exactly the line's color, with the pixel's own alpha bits kept like any other
+		alpha = SDL_min(alpha, 255);
+		if (blender.packed)
+		{
+			buffer[index] = blender.BlendMapped(buffer[index], pixel, alpha);
+		}
+		else
+		{
+			buffer[index] = blender.Blend(buffer[index], color, alpha);
+		}
+	}
+
+	Device* screen;
+	ClipRect clip;
+	Color color;
+	PixelBlender blender;
+	Uint32* buffer;
+	Uint32 pixel;
+	int lastTile;
+};
+
+void DrawLineSmooth(Device* screen, float x0, float y0, float x1, float y1, Color c)
+{
+	LineSegment line(x0, y0, x1, y1);
+	DrawLines(screen, &line, 1, c);
+}
+
+void DrawLines(Device* screen, const LineSegment* segments, int count, Color c)
+{
+	DrawLines(screen, ClipRect(0, 0, screen->Width(), screen->Height()), segments, count, c);
+}
+
+void DrawLines(Device* screen, const std::vector<LineSegment>& segments, Color c)
+{
+	if (!segments.empty())
+	{
+		DrawLines(screen, &segments[0], (int)segments.size(), c);
+	}
+}
+
+void DrawLines(Device* screen, const ClipRect& clip, const LineSegment* segments, int count, Color c)
+{
+	// Whatever clip we're given still has to stay on the screen
+	ClipRect bounds(SDL_max(clip.left, 0), SDL_max(clip.top, 0), SDL_min(clip.right, screen->Width()), SDL_min(clip.bottom, screen->Height()));
+	if (bounds.left >= bounds.right || bounds.top >= bounds.bottom)
+	{
+		return;
+	}
+
+	LineWriter writer(screen, bounds, c);
+	for (int i = 0; i < count; ++i)
+	{
+		writer.Draw(segments[i]);
+	}
+}
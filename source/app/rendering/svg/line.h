@@ -0,0 +1,39 @@
+#ifndef RENDERING_SVG_LINE_H
+#define RENDERING_SVG_LINE_H
+
+#include <vector>
+#include "../device.h"
+#include "../color.h"
+#include "../3d/rasterizer.h"
+
+// A line from one point to another in screen pixels, where a pixel's center is at x + 0.5, y + 0.5
+struct LineSegment
+{
+	LineSegment()
+		: x0(0), y0(0), x1(0), y1(0)
+	{}
+
+	LineSegment(float _x0, float _y0, float _x1, float _y1)
+		: x0(_x0), y0(_y0), x1(_x1), y1(_y1)
+	{}
+
+	float x0;
+	float y0;
+	float x1;
+	float y1;
+};
+
+// Cuts a segment down to the part inside left, top to right, bottom using Cohen-Sutherland
+// Returns false when none of it is inside, and the segment is left as it was
+bool ClipLine(LineSegment& segment, float left, float top, float right, float bottom);
+
+// Draws a one pixel wide anti-aliased line using Wu's algorithm, each step along the line blends the two pixels it falls between
+void DrawLineSmooth(Device* screen, float x0, float y0, float x1, float y1, Color c);
+
+// Draws a whole batch of lines in one color, for wireframes and charts with thousands of segments. The color and pixel
+// format are set up once for the batch and every segment is clipped to the screen or clip before it's walked
+void DrawLines(Device* screen, const LineSegment* segments, int count, Color c);
+void DrawLines(Device* screen, const std::vector<LineSegment>& segments, Color c);
+void DrawLines(Device* screen, const ClipRect& clip, const LineSegment* segments, int count, Color c);
+
+#endif
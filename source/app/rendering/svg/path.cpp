@@ -0,0 +1,563 @@
+#include "path.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+float Transform2D::Scale() const
+{
+	// The biggest singular value of the 2x2 part
+	float sum = a * a + b * b + c * c + d * d;
+	float determinant = a * d - b * c;
+	float root = sqrtf(SDL_max(sum * sum - 4.0f * determinant * determinant, 0.0f));
+	return sqrtf((sum + root) * 0.5f);
+}
+
+static bool IsSeparator(char c)
+{
+	return c == ' ' || c == ',' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void SkipSeparators(const char*& s)
+{
+	while (*s && IsSeparator(*s))
+	{
+		++s;
+	}
+}
+
+// Numbers in svg can run straight into each other, like "1.5.5" or "10-20", strtod stops in the right places for those
+static bool ReadNumber(const char*& s, float& value)
+{
+	SkipSeparators(s);
+	if (!(*s == '-' || *s == '+' || *s == '.' || (*s >= '0' && *s <= '9')))
+	{
+		return false;
+	}
+
+	char* end = NULL;
+	value = (float)strtod(s, &end);
+	if (end == s)
+	{
+		return false;
+	}
+
+	s = end;
+	return true;
+}
+
+// Arc flags are a single digit and are allowed to have nothing after them, so "a5 5 0 0110 10" is fine
+static bool ReadFlag(const char*& s, bool& flag)
+{
+	SkipSeparators(s);
+	if (*s != '0' && *s != '1')
+	{
+		return false;
+	}
+
+	flag = *s++ == '1';
+	return true;
+}
+
+bool ParseTransform(const char* text, Transform2D& transform)
+{
+	const char* s = text;
+	while (true)
+	{
+		SkipSeparators(s);
+		if (!*s)
+		{
+			return true;
+		}
+
+		const char* name = s;
+		while (*s && *s != '(' && !IsSeparator(*s))
+		{
+			++s;
+		}
+		size_t nameLength = s - name;
+
+		SkipSeparators(s);
+		if (*s != '(')
+		{
+			return false;
+		}
+		++s;
+
+		float args[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		int count = 0;
+		while (count < 6 && ReadNumber(s, args[count]))
+		{
+			++count;
+		}
+
+		SkipSeparators(s);
+		if (*s != ')')
+		{
+			return false;
+		}
+		++s;
+
+		Transform2D step;
+		if (nameLength == 6 && strncmp(name, "matrix", 6) == 0 && count == 6)
+		{
+			step = Transform2D(args[0], args[1], args[2], args[3], args[4], args[5]);
+		}
+		else if (nameLength == 9 && strncmp(name, "translate", 9) == 0 && count >= 1)
+		{
+			step.e = args[0];
+			step.f = count > 1 ? args[1] : 0.0f;
+		}
+		else if (nameLength == 5 && strncmp(name, "scale", 5) == 0 && count >= 1)
+		{
+			step.a = args[0];
+			step.d = count > 1 ? args[1] : args[0];
+		}
+		else if (nameLength == 6 && strncmp(name, "rotate", 6) == 0 && count >= 1)
+		{
+			float radians = args[0] * (float)M_PI / 180.0f;
+			float cosine = cosf(radians);
+			float sine = sinf(radians);
+			Transform2D rotation(cosine, sine, -sine, cosine, 0.0f, 0.0f);
+
+			// Rotating about a point is moving there, rotating, and moving back
+			if (count >= 3)
+			{
+				step = Transform2D(1.0f, 0.0f, 0.0f, 1.0f, args[1], args[2]) * rotation * Transform2D(1.0f, 0.0f, 0.0f, 1.0f, -args[1], -args[2]);
+			}
+			else
+			{
+				step = rotation;
+			}
+		}
+		else if (nameLength == 5 && strncmp(name, "skewX", 5) == 0 && count >= 1)
+		{
+			step.c = tanf(args[0] * (float)M_PI / 180.0f);
+		}
+		else if (nameLength == 5 && strncmp(name, "skewY", 5) == 0 && count >= 1)
+		{
+			step.b = tanf(args[0] * (float)M_PI / 180.0f);
+		}
+		else
+		{
+			return false;
+		}
+
+		transform = transform * step;
+	}
+}
+
+void VectorPath::MoveTo(float x, float y)
+{
+	commands.push_back(PATH_MOVE);
+	current.x = x;
+	current.y = y;
+	start = current;
+	points.push_back(current);
+}
+
+void VectorPath::LineTo(float x, float y)
+{
+	commands.push_back(PATH_LINE);
+	current.x = x;
+	current.y = y;
+	points.push_back(current);
+}
+
+void VectorPath::QuadTo(float cx, float cy, float x, float y)
+{
+	commands.push_back(PATH_QUAD);
+	PolygonPoint control = { cx, cy };
+	points.push_back(control);
+	current.x = x;
+	current.y = y;
+	points.push_back(current);
+}
+
+void VectorPath::CubicTo(float c1x, float c1y, float c2x, float c2y, float x, float y)
+{
+	commands.push_back(PATH_CUBIC);
+	PolygonPoint control1 = { c1x, c1y };
+	PolygonPoint control2 = { c2x, c2y };
+	points.push_back(control1);
+	points.push_back(control2);
+	current.x = x;
+	current.y = y;
+	points.push_back(current);
+}
+
+// Follows the endpoint to center conversion from the svg spec's implementation notes, then
+// covers the sweep with one cubic per quarter turn or less
+void VectorPath::ArcTo(float rx, float ry, float rotation, bool largeArc, bool sweep, float x, float y)
+{
+	float x0 = current.x;
+	float y0 = current.y;
+	rx = fabsf(rx);
+	ry = fabsf(ry);
+	if (rx == 0.0f || ry == 0.0f || (x0 == x && y0 == y))
+	{
+		LineTo(x, y);
+		return;
+	}
+
+	float radians = rotation * (float)M_PI / 180.0f;
+	float cosine = cosf(radians);
+	float sine = sinf(radians);
+
+	float dx = (x0 - x) * 0.5f;
+	float dy = (y0 - y) * 0.5f;
+	float x1 = cosine * dx + sine * dy;
+	float y1 = -sine * dx + cosine * dy;
+
+	// Radii too small to reach the end point get scaled up until they just do
+	float lambda = (x1 * x1) / (rx * rx) + (y1 * y1) / (ry * ry);
+	if (lambda > 1.0f)
+	{
+		float grow = sqrtf(lambda);
+		rx *= grow;
+		ry *= grow;
+	}
+
+	float numerator = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+	float denominator = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+	float factor = sqrtf(SDL_max(numerator, 0.0f) / denominator);
+	if (largeArc == sweep)
+	{
+		factor = -factor;
+	}
+
+	float centerX1 = factor * rx * y1 / ry;
+	float centerY1 = -factor * ry * x1 / rx;
+	float centerX = cosine * centerX1 - sine * centerY1 + (x0 + x) * 0.5f;
+	float centerY = sine * centerX1 + cosine * centerY1 + (y0 + y) * 0.5f;
+
+	float startAngle = atan2f((y1 - centerY1) / ry, (x1 - centerX1) / rx);
+	float endAngle = atan2f((-y1 - centerY1) / ry, (-x1 - centerX1) / rx);
+	float delta = endAngle - startAngle;
+	if (sweep && delta < 0.0f)
+	{
+		delta += 2.0f * (float)M_PI;
+	}
+	else if (!sweep && delta > 0.0f)
+	{
+		delta -= 2.0f * (float)M_PI;
+	}
+
+	int segments = SDL_max((int)ceilf(fabsf(delta) / ((float)M_PI * 0.5f) - 0.001f), 1);
+	float step = delta / segments;
+	float handle = 4.0f / 3.0f * tanf(step * 0.25f);
+
+	float angle = startAngle;
+	for (int i = 0; i < segments; ++i)
+	{
+		float cos1 = cosf(angle);
+		float sin1 = sinf(angle);
+		float cos2 = cosf(angle + step);
+		float sin2 = sinf(angle + step);
+
+		// Points on the unrotated unit circle, stretched by the radii then turned and moved into place
+		float ux[4] = { cos1, cos1 - handle * sin1, cos2 + handle * sin2, cos2 };
+		float uy[4] = { sin1, sin1 + handle * cos1, sin2 - handle * cos2, sin2 };
+		float px[4];
+		float py[4];
+		for (int p = 1; p < 4; ++p)
+		{
+			px[p] = cosine * rx * ux[p] - sine * ry * uy[p] + centerX;
+			py[p] = sine * rx * ux[p] + cosine * ry * uy[p] + centerY;
+		}
+
+		// Land exactly on the end point so the next command starts where it should
+		if (i == segments - 1)
+		{
+			px[3] = x;
+			py[3] = y;
+		}
+
+		CubicTo(px[1], py[1], px[2], py[2], px[3], py[3]);
+		angle += step;
+	}
+}
+
+void VectorPath::Close()
+{
+	commands.push_back(PATH_CLOSE);
+	current = start;
+}
+
+void VectorPath::Transform(const Transform2D& transform)
+{
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		points[i] = transform.Apply(points[i]);
+	}
+
+	start = transform.Apply(start);
+	current = transform.Apply(current);
+}
+
+bool ParsePathData(const char* text, VectorPath& path)
+{
+	const char* s = text;
+	char command = 0;
+
+	// The second control point of the last curve, mirrored by the smooth curve commands
+	PolygonPoint lastControl = path.current;
+	char lastCommand = 0;
+
+	while (true)
+	{
+		SkipSeparators(s);
+		if (!*s)
+		{
+			return true;
+		}
+
+		if ((*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z'))
+		{
+			command = *s++;
+		}
+		else if (!command)
+		{
+			return false;
+		}
+
+		bool relative = command >= 'a' && command <= 'z';
+		char upper = relative ? command - 'a' + 'A' : command;
+		float baseX = relative ? path.current.x : 0.0f;
+		float baseY = relative ? path.current.y : 0.0f;
+		float v[7];
+
+		switch (upper)
+		{
+		case 'M':
+			if (!ReadNumber(s, v[0]) || !ReadNumber(s, v[1]))
+			{
+				return false;
+			}
+			path.MoveTo(baseX + v[0], baseY + v[1]);
+
+			// More points after a move are lines
+			command = relative ? 'l' : 'L';
+			break;
+		case 'L':
+			if (!ReadNumber(s, v[0]) || !ReadNumber(s, v[1]))
+			{
+				return false;
+			}
+			path.LineTo(baseX + v[0], baseY + v[1]);
+			break;
+		case 'H':
+			if (!ReadNumber(s, v[0]))
+			{
+				return false;
+			}
+			path.LineTo(baseX + v[0], path.current.y);
+			break;
+		case 'V':
+			if (!ReadNumber(s, v[0]))
+			{
+				return false;
+			}
+			path.LineTo(path.current.x, baseY + v[0]);
+			break;
+		case 'C':
+		case 'S':
+		{
+			int controls = upper == 'C' ? 6 : 4;
+			for (int i = 0; i < controls; ++i)
+			{
+				if (!ReadNumber(s, v[i]))
+				{
+					return false;
+				}
+			}
+
+			float c1x = path.current.x;
+			float c1y = path.current.y;
+			int next = 0;
+			if (upper == 'C')
+			{
+				c1x = baseX + v[0];
+				c1y = baseY + v[1];
+				next = 2;
+			}
+			else if (lastCommand == 'C' || lastCommand == 'S')
+			{
+				c1x = 2.0f * path.current.x - lastControl.x;
+				c1y = 2.0f * path.current.y - lastControl.y;
+			}
+
+			lastControl.x = baseX + v[next];
+			lastControl.y = baseY + v[next + 1];
+			path.CubicTo(c1x, c1y, lastControl.x, lastControl.y, baseX + v[next + 2], baseY + v[next + 3]);
+			break;
+		}
+		case 'Q':
+		case 'T':
+		{
+			int controls = upper == 'Q' ? 4 : 2;
+			for (int i = 0; i < controls; ++i)
+			{
+				if (!ReadNumber(s, v[i]))
+				{
+					return false;
+				}
+			}
+
+			int next = 0;
+			if (upper == 'Q')
+			{
+				lastControl.x = baseX + v[0];
+				lastControl.y = baseY + v[1];
+				next = 2;
+			}
+			else if (lastCommand == 'Q' || lastCommand == 'T')
+			{
+				lastControl.x = 2.0f * path.current.x - lastControl.x;
+				lastControl.y = 2.0f * path.current.y - lastControl.y;
+			}
+			else
+			{
+				lastControl = path.current;
+			}
+
+			path.QuadTo(lastControl.x, lastControl.y, baseX + v[next], baseY + v[next + 1]);
+			break;
+		}
+		case 'A':
+		{
+			bool largeArc = false;
+			bool sweep = false;
+			if (!ReadNumber(s, v[0]) || !ReadNumber(s, v[1]) || !ReadNumber(s, v[2]) ||
+				!ReadFlag(s, largeArc) || !ReadFlag(s, sweep) || !ReadNumber(s, v[3]) || !ReadNumber(s, v[4]))
+			{
+				return false;
+			}
+			path.ArcTo(v[0], v[1], v[2], largeArc, sweep, baseX + v[3], baseY + v[4]);
+			break;
+		}
+		case 'Z':
+			path.Close();
+
+			// Close doesn't take any numbers, so one straight after it has no command to go with
+			command = 0;
+			break;
+		default:
+			return false;
+		}
+
+		lastCommand = upper;
+	}
+}
+
+static void AddFlatPoint(FlatPath& flat, int contourStart, const PolygonPoint& from, const PolygonPoint& p)
+{
+	// A contour that carries on after a close starts again from wherever the pen is
+	if ((int)flat.points.size() == contourStart)
+	{
+		flat.points.push_back(from);
+	}
+
+	flat.points.push_back(p);
+}
+
+static void EndContour(FlatPath& flat, int& contourStart, bool closed)
+{
+	int count = (int)flat.points.size() - contourStart;
+	if (count >= 2)
+	{
+		flat.ends.push_back((int)flat.points.size());
+		flat.closed.push_back(closed);
+	}
+	else
+	{
+		flat.points.resize(contourStart);
+	}
+
+	contourStart = (int)flat.points.size();
+}
+
+// A curve's points never stray from the lines between them by more than an eighth of its second derivative
+// over the square of the number of steps, so that tells us how many steps keep inside the tolerance
+void FlattenPath(const VectorPath& path, float tolerance, FlatPath& flat)
+{
+	flat.Clear();
+	tolerance = SDL_max(tolerance, 0.001f);
+
+	int contourStart = 0;
+	size_t next = 0;
+	PolygonPoint current = { 0.0f, 0.0f };
+	PolygonPoint start = current;
+
+	for (size_t i = 0; i < path.commands.size(); ++i)
+	{
+		switch (path.commands[i])
+		{
+		case PATH_MOVE:
+			EndContour(flat, contourStart, false);
+			current = path.points[next++];
+			start = current;
+			flat.points.push_back(current);
+			break;
+		case PATH_LINE:
+			AddFlatPoint(flat, contourStart, current, path.points[next]);
+			current = path.points[next++];
+			break;
+		case PATH_QUAD:
+		{
+			const PolygonPoint& p1 = path.points[next];
+			const PolygonPoint& p2 = path.points[next + 1];
+			float ddx = current.x - 2.0f * p1.x + p2.x;
+			float ddy = current.y - 2.0f * p1.y + p2.y;
+			int steps = SDL_max((int)ceilf(sqrtf(0.25f * sqrtf(ddx * ddx + ddy * ddy) / tolerance)), 1);
+			for (int step = 1; step <= steps; ++step)
+			{
+				float t = (float)step / steps;
+				float u = 1.0f - t;
+				PolygonPoint p;
+				p.x = u * u * current.x + 2.0f * u * t * p1.x + t * t * p2.x;
+				p.y = u * u * current.y + 2.0f * u * t * p1.y + t * t * p2.y;
+				AddFlatPoint(flat, contourStart, current, p);
+			}
+
+			current = p2;
+			next += 2;
+			break;
+		}
+		case PATH_CUBIC:
+		{
+			const PolygonPoint& p1 = path.points[next];
+			const PolygonPoint& p2 = path.points[next + 1];
+			const PolygonPoint& p3 = path.points[next + 2];
+			float ddx1 = current.x - 2.0f * p1.x + p2.x;
+			float ddy1 = current.y - 2.0f * p1.y + p2.y;
+			float ddx2 = p1.x - 2.0f * p2.x + p3.x;
+			float ddy2 = p1.y - 2.0f * p2.y + p3.y;
+			float dd = sqrtf(SDL_max(ddx1 * ddx1 + ddy1 * ddy1, ddx2 * ddx2 + ddy2 * ddy2));
+			int steps = SDL_max((int)ceilf(sqrtf(0.75f * dd / tolerance)), 1);
+			for (int step = 1; step <= steps; ++step)
+			{
+				float t = (float)step / steps;
+				float u = 1.0f - t;
+				float w0 = u * u * u;
+				float w1 = 3.0f * u * u * t;
+				float w2 = 3.0f * u * t * t;
+				float w3 = t * t * t;
+				PolygonPoint p;
+				p.x = w0 * current.x + w1 * p1.x + w2 * p2.x + w3 * p3.x;
+				p.y = w0 * current.y + w1 * p1.y + w2 * p2.y + w3 * p3.y;
+				AddFlatPoint(flat, contourStart, current, p);
+			}
+
+			current = p3;
+			next += 3;
+			break;
+		}
+		case PATH_CLOSE:
+			EndContour(flat, contourStart, true);
+			current = start;
+			break;
+		}
+	}
+
+	EndContour(flat, contourStart, false);
+}
@@ -0,0 +1,112 @@
+#ifndef RENDERING_SVG_PATH_H
+#define RENDERING_SVG_PATH_H
+
+#include <vector>
+#include <SDL/SDL.h>
+#include "polygon.h"
+
+// A 2D affine transform laid out the way svg writes matrix(a b c d e f)
+// x' = a * x + c * y + e, y' = b * x + d * y + f
+struct Transform2D
+{
+	Transform2D()
+		: a(1.0f), b(0.0f), c(0.0f), d(1.0f), e(0.0f), f(0.0f)
+	{}
+
+	Transform2D(float _a, float _b, float _c, float _d, float _e, float _f)
+		: a(_a), b(_b), c(_c), d(_d), e(_e), f(_f)
+	{}
+
+	PolygonPoint Apply(const PolygonPoint& p) const
+	{
+		PolygonPoint out;
+		out.x = a * p.x + c * p.y + e;
+		out.y = b * p.x + d * p.y + f;
+		return out;
+	}
+
+	// How much the transform stretches lengths at most, used to scale stroke widths
+	float Scale() const;
+
+	// Applies other first and then this
+	friend Transform2D operator*(const Transform2D& t, const Transform2D& other)
+	{
+		return Transform2D(
+			t.a * other.a + t.c * other.b, t.b * other.a + t.d * other.b,
+			t.a * other.c + t.c * other.d, t.b * other.c + t.d * other.d,
+			t.a * other.e + t.c * other.f + t.e, t.b * other.e + t.d * other.f + t.f);
+	}
+
+	float a;
+	float b;
+	float c;
+	float d;
+	float e;
+	float f;
+};
+
+// Reads an svg transform list like "translate(10 20) rotate(45)" and puts it after the given transform
+bool ParseTransform(const char* text, Transform2D& transform);
+
+enum PathCommand
+{
+	PATH_MOVE,
+	PATH_LINE,
+	PATH_QUAD,
+	PATH_CUBIC,
+	PATH_CLOSE
+};
+
+// An outline made of lines and curves, every point already in absolute coordinates
+// Moves and lines use one point, quads two and cubics three, closes none. Arcs get turned into cubics on the way in
+struct VectorPath
+{
+	VectorPath()
+	{
+		start.x = 0.0f;
+		start.y = 0.0f;
+		current = start;
+	}
+
+	void MoveTo(float x, float y);
+	void LineTo(float x, float y);
+	void QuadTo(float cx, float cy, float x, float y);
+	void CubicTo(float c1x, float c1y, float c2x, float c2y, float x, float y);
+	void ArcTo(float rx, float ry, float rotation, bool largeArc, bool sweep, float x, float y);
+	void Close();
+
+	// Moves every point through the transform, which is fine for curves too since they're affine
+	void Transform(const Transform2D& transform);
+
+	bool Empty() const { return commands.empty(); }
+
+	std::vector<Uint8> commands;
+	std::vector<PolygonPoint> points;
+
+	// Where the current subpath started and where the pen is, for closes and relative commands
+	PolygonPoint start;
+	PolygonPoint current;
+};
+
+// Reads svg path data, the d attribute. Whatever was read before a mistake is kept
+bool ParsePathData(const char* text, VectorPath& path);
+
+// The straight line version of a path, each contour is a run of points that ends at the matching entry in ends
+struct FlatPath
+{
+	void Clear()
+	{
+		points.clear();
+		ends.clear();
+		closed.clear();
+	}
+
+	std::vector<PolygonPoint> points;
+	std::vector<int> ends;
+	std::vector<bool> closed;
+};
+
+// Cuts the curves up into lines that never stray further than tolerance from the real curve
+void FlattenPath(const VectorPath& path, float tolerance, FlatPath& flat);
+
+#endif
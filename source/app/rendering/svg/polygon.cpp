@@ -0,0 +1,110 @@
+#include "polygon.h"
+#include "coverage.h"
+#include <math.h>
+#include <algorithm>
+
+struct PolygonCrossing
+{
+	float x;
+	int winding;
+
+	bool operator<(const PolygonCrossing& other) const { return x < other.x; }
+};
+
+// Every row looks for the edges crossing the middle of it, then fills between the crossings that are inside
+void FillPolygon(Device* screen, const PolygonPoint* points, int count, Color c, FillRule rule)
+{
+	if (count < 3)
+	{
+		return;
+	}
+
+	float minY = points[0].y;
+	float maxY = points[0].y;
+	for (int i = 1; i < count; ++i)
+	{
+		minY = SDL_min(minY, points[i].y);
+		maxY = SDL_max(maxY, points[i].y);
+	}
+
+	// The rows whose centers are between the top and bottom
+	int top = SDL_max((int)ceilf(minY - 0.5f), 0);
+	int bottom = SDL_min((int)ceilf(maxY - 0.5f) - 1, screen->Height() - 1);
+
+	Uint32 pixel = screen->MapColor(c);
+	std::vector<PolygonCrossing> crossings;
+
+	for (int y = top; y <= bottom; ++y)
+	{
+		float sampleY = y + 0.5f;
+		crossings.clear();
+
+		for (int i = 0; i < count; ++i)
+		{
+			const PolygonPoint& a = points[i];
+			const PolygonPoint& b = points[(i + 1) % count];
+
+			// Edges count when they cover the sample from their top end down to just short of their bottom end,
+			// so where two edges meet at a point the crossing is only counted once
+			bool down = a.y <= sampleY && b.y > sampleY;
+			bool up = b.y <= sampleY && a.y > sampleY;
+			if (!down && !up)
+			{
+				continue;
+			}
+
+			PolygonCrossing crossing;
+			crossing.x = a.x + (sampleY - a.y) * (b.x - a.x) / (b.y - a.y);
+			crossing.winding = down ? 1 : -1;
+			crossings.push_back(crossing);
+		}
+
+		std::sort(crossings.begin(), crossings.end());
+
+		int winding = 0;
+		for (size_t i = 0; i + 1 < crossings.size(); ++i)
+		{
+			winding += rule == FILL_EVEN_ODD ? 1 : crossings[i].winding;
+			bool inside = rule == FILL_EVEN_ODD ? (winding & 1) != 0 : winding != 0;
+			if (!inside)
+			{
+				continue;
+			}
+
+			// Pixels whose centers land between this crossing and the next
+			int x0 = (int)ceilf(crossings[i].x - 0.5f);
+			int x1 = (int)ceilf(crossings[i + 1].x - 0.5f) - 1;
+			if (x0 <= x1)
+			{
+				screen->FillSpanMapped(y, x0, x1, pixel);
+			}
+		}
+	}
+}
+
+void FillPolygon(Device* screen, const std::vector<PolygonPoint>& points, Color c, FillRule rule)
+{
+	if (!points.empty())
+	{
+		FillPolygon(screen, &points[0], (int)points.size(), c, rule);
+	}
+}
+
+void FillPolygonSmooth(Device* screen, const PolygonPoint* points, int count, Color c, FillRule rule, Uint8 opacity)
+{
+	// Kept around so drawing lots of shapes doesn't allocate every time
+	static thread_local std::vector<PathEdge> edges;
+	static thread_local CoverageRasterizer rasterizer;
+
+	edges.clear();
+	AddPolygonEdges(edges, points, count);
+	rasterizer.Fill(screen, ClipRect(0, 0, screen->Width(), screen->Height()), edges, c, rule, opacity);
+}
+
+void FillPolygonSmooth(Device* screen, const std::vector<PolygonPoint>& points, Color c, FillRule rule, Uint8 opacity)
+{
+	if (!points.empty())
+	{
+		FillPolygonSmooth(screen, &points[0], (int)points.size(), c, rule, opacity);
+	}
+}
@@ -0,0 +1,32 @@
+#ifndef RENDERING_SVG_POLYGON_H
+#define RENDERING_SVG_POLYGON_H
+
+#include <vector>
+#include "../device.h"
+#include "../color.h"
+
+struct PolygonPoint
+{
+	float x;
+	float y;
+};
+
+// How overlapping parts of a polygon decide what's inside, the same two rules svg has
+enum FillRule
+{
+	// Inside wherever the edges wind around a point a different number of times one way than the other
+	FILL_NONZERO,
+
+	// Inside wherever a line out from the point crosses an odd number of edges
+	FILL_EVEN_ODD
+};
+
+// Fills a closed polygon, the last point joins back up to the first. A pixel is filled when its center is inside
+void FillPolygon(Device* screen, const PolygonPoint* points, int count, Color c, FillRule rule = FILL_NONZERO);
+void FillPolygon(Device* screen, const std::vector<PolygonPoint>& points, Color c, FillRule rule = FILL_NONZERO);
+
+// The same with anti-aliased edges, each pixel blended by how much of its area is inside. Opacity fades the whole thing
+void FillPolygonSmooth(Device* screen, const PolygonPoint* points, int count, Color c, FillRule rule = FILL_NONZERO, Uint8 opacity = 255);
+void FillPolygonSmooth(Device* screen, const std::vector<PolygonPoint>& points, Color c, FillRule rule = FILL_NONZERO, Uint8 opacity = 255);
+
+#endif
@@ -0,0 +1,782 @@
+#include "scene.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../debug.h"
+
+// Everything that a group passes down to what's inside it
+struct SceneStyle
+{
+	SceneStyle()
+		: filled(true), fill(0, 0, 0), fillRule(FILL_NONZERO), fillOpacity(1.0f),
+		stroked(false), stroke(0, 0, 0), strokeOpacity(1.0f), opacity(1.0f)
+	{}
+
+	Transform2D transform;
+	bool filled;
+	Color fill;
+	FillRule fillRule;
+	float fillOpacity;
+	bool stroked;
+	Color stroke;
+	StrokeStyle strokeStyle;
+	float strokeOpacity;
+	float opacity;
+};
+
+struct SceneAttribute
+{
+	std::string name;
+	std::string value;
+};
+
+static const char* FindAttribute(const std::vector<SceneAttribute>& attributes, const char* name)
+{
+	for (size_t i = 0; i < attributes.size(); ++i)
+	{
+		if (attributes[i].name == name)
+		{
+			return attributes[i].value.c_str();
+		}
+	}
+
+	return NULL;
+}
+
+static float NumberAttribute(const std::vector<SceneAttribute>& attributes, const char* name, float fallback = 0.0f)
+{
+	const char* value = FindAttribute(attributes, name);
+	return value ? (float)atof(value) : fallback;
+}
+
+static int HexDigit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// Reads a solid paint, returning false for none or anything we can't draw like gradients
+static bool ParsePaint(const char* text, Color& color)
+{
+	while (*text == ' ')
+	{
+		++text;
+	}
+
+	if (text[0] == '#')
+	{
+		int digits[6];
+		int count = 0;
+		while (count < 6 && HexDigit(text[count + 1]) >= 0)
+		{
+			digits[count] = HexDigit(text[count + 1]);
+			++count;
+		}
+
+		if (count == 3)
+		{
+			color = Color(digits[0] * 17, digits[1] * 17, digits[2] * 17);
+			return true;
+		}
+
+		if (count == 6)
+		{
+			color = Color(digits[0] * 16 + digits[1], digits[2] * 16 + digits[3], digits[4] * 16 + digits[5]);
+			return true;
+		}
+
+		return false;
+	}
+
+	if (strncmp(text, "rgb(", 4) == 0)
+	{
+		int values[3] = { 0, 0, 0 };
+		const char* s = text + 4;
+		for (int i = 0; i < 3; ++i)
+		{
+			char* end = NULL;
+			float value = (float)strtod(s, &end);
+			if (*end == '%')
+			{
+				value *= 2.55f;
+				++end;
+			}
+
+			values[i] = SDL_max(0, SDL_min((int)(value + 0.5f), 255));
+			s = end;
+			while (*s == ' ' || *s == ',')
+			{
+				++s;
+			}
+		}
+
+		color = Color(values[0], values[1], values[2]);
+		return true;
+	}
+
+	struct NamedColor
+	{
+		const char* name;
+		Uint32 rgb;
+	};
+
+	static const NamedColor names[] = {
+		{ "black", 0x000000 }, { "white", 0xFFFFFF }, { "red", 0xFF0000 }, { "green", 0x008000 },
+		{ "lime", 0x00FF00 }, { "blue", 0x0000FF }, { "yellow", 0xFFFF00 }, { "cyan", 0x00FFFF },
+		{ "aqua", 0x00FFFF }, { "magenta", 0xFF00FF }, { "fuchsia", 0xFF00FF }, { "gray", 0x808080 },
+		{ "grey", 0x808080 }, { "silver", 0xC0C0C0 }, { "maroon", 0x800000 }, { "olive", 0x808000 },
+		{ "navy", 0x000080 }, { "purple", 0x800080 }, { "teal", 0x008080 }, { "orange", 0xFFA500 }
+	};
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+	{
+		if (strcmp(text, names[i].name) == 0)
+		{
+			color = Color((names[i].rgb >> 16) & 255, (names[i].rgb >> 8) & 255, names[i].rgb & 255);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static float ClampOpacity(const char* text)
+{
+	return SDL_max(0.0f, SDL_min((float)atof(text), 1.0f));
+}
+
+static void ApplyStyleProperty(SceneStyle& style, const std::string& name, const char* value)
+{
+	if (name == "fill")
+	{
+		style.filled = ParsePaint(value, style.fill);
+	}
+	else if (name == "stroke")
+	{
+		style.stroked = ParsePaint(value, style.stroke);
+	}
+	else if (name == "stroke-width")
+	{
+		style.strokeStyle.width = (float)atof(value);
+	}
+	else if (name == "stroke-linejoin")
+	{
+		style.strokeStyle.join = strcmp(value, "round") == 0 ? JOIN_ROUND : strcmp(value, "bevel") == 0 ? JOIN_BEVEL : JOIN_MITER;
+	}
+	else if (name == "stroke-linecap")
+	{
+		style.strokeStyle.cap = strcmp(value, "round") == 0 ? CAP_ROUND : strcmp(value, "square") == 0 ? CAP_SQUARE : CAP_BUTT;
+	}
+	else if (name == "stroke-miterlimit")
+	{
+		// Limits under one aren't valid svg, so they're ignored
+		float limit = (float)atof(value);
+		if (limit >= 1.0f)
+		{
+			style.strokeStyle.miterLimit = limit;
+		}
+	}
+	else if (name == "fill-rule")
+	{
+		style.fillRule = strcmp(value, "evenodd") == 0 ? FILL_EVEN_ODD : FILL_NONZERO;
+	}
+	else if (name == "fill-opacity")
+	{
+		style.fillOpacity = ClampOpacity(value);
+	}
+	else if (name == "stroke-opacity")
+	{
+		style.strokeOpacity = ClampOpacity(value);
+	}
+	else if (name == "opacity")
+	{
+		style.opacity *= ClampOpacity(value);
+	}
+}
+
+// Presentation attributes first, then the style attribute which beats them, then the transform
+static void ApplyStyle(SceneStyle& style, const std::vector<SceneAttribute>& attributes)
+{
+	for (size_t i = 0; i < attributes.size(); ++i)
+	{
+		ApplyStyleProperty(style, attributes[i].name, attributes[i].value.c_str());
+	}
+
+	const char* css = FindAttribute(attributes, "style");
+	while (css && *css)
+	{
+		const char* colon = strchr(css, ':');
+		if (!colon)
+		{
+			break;
+		}
+
+		const char* end = strchr(colon, ';');
+		if (!end)
+		{
+			end = colon + strlen(colon);
+		}
+
+		std::string name(css, colon - css);
+		std::string value(colon + 1, end - colon - 1);
+		name.erase(0, name.find_first_not_of(" \t\n\r"));
+		name.erase(name.find_last_not_of(" \t\n\r") + 1);
+		value.erase(0, value.find_first_not_of(" \t\n\r"));
+		value.erase(value.find_last_not_of(" \t\n\r") + 1);
+		ApplyStyleProperty(style, name, value.c_str());
+
+		css = *end ? end + 1 : end;
+	}
+
+	const char* transform = FindAttribute(attributes, "transform");
+	if (transform)
+	{
+		ParseTransform(transform, style.transform);
+	}
+}
+
+// Circles and rounded corners are four arcs, kappa puts the cubic handles where they match a quarter circle best
+static const float CIRCLE_KAPPA = 0.5522847f;
+
+static void AddEllipse(VectorPath& path, float cx, float cy, float rx, float ry)
+{
+	float kx = rx * CIRCLE_KAPPA;
+	float ky = ry * CIRCLE_KAPPA;
+	path.MoveTo(cx + rx, cy);
+	path.CubicTo(cx + rx, cy + ky, cx + kx, cy + ry, cx, cy + ry);
+	path.CubicTo(cx - kx, cy + ry, cx - rx, cy + ky, cx - rx, cy);
+	path.CubicTo(cx - rx, cy - ky, cx - kx, cy - ry, cx, cy - ry);
+	path.CubicTo(cx + kx, cy - ry, cx + rx, cy - ky, cx + rx, cy);
+	path.Close();
+}
+
+static void AddRect(VectorPath& path, float x, float y, float w, float h, float rx, float ry)
+{
+	rx = SDL_min(rx, w * 0.5f);
+	ry = SDL_min(ry, h * 0.5f);
+	if (rx <= 0.0f || ry <= 0.0f)
+	{
+		path.MoveTo(x, y);
+		path.LineTo(x + w, y);
+		path.LineTo(x + w, y + h);
+		path.LineTo(x, y + h);
+		path.Close();
+		return;
+	}
+
+	float kx = rx * CIRCLE_KAPPA;
+	float ky = ry * CIRCLE_KAPPA;
+	float right = x + w;
+	float bottom = y + h;
+	path.MoveTo(x + rx, y);
+	path.LineTo(right - rx, y);
+	path.CubicTo(right - rx + kx, y, right, y + ry - ky, right, y + ry);
+	path.LineTo(right, bottom - ry);
+	path.CubicTo(right, bottom - ry + ky, right - rx + kx, bottom, right - rx, bottom);
+	path.LineTo(x + rx, bottom);
+	path.CubicTo(x + rx - kx, bottom, x, bottom - ry + ky, x, bottom - ry);
+	path.LineTo(x, y + ry);
+	path.CubicTo(x, y + ry - ky, x + rx - kx, y, x + rx, y);
+	path.Close();
+}
+
+static void AddPoints(VectorPath& path, const char* text, bool close)
+{
+	const char* s = text;
+	bool first = true;
+	while (true)
+	{
+		char* end = NULL;
+		float x = (float)strtod(s, &end);
+		if (end == s)
+		{
+			break;
+		}
+
+		s = end;
+		while (*s == ' ' || *s == ',' || *s == '\n' || *s == '\r' || *s == '\t')
+		{
+			++s;
+		}
+
+		float y = (float)strtod(s, &end);
+		if (end == s)
+		{
+			break;
+		}
+		s = end;
+
+		if (first)
+		{
+			path.MoveTo(x, y);
+			first = false;
+		}
+		else
+		{
+			path.LineTo(x, y);
+		}
+	}
+
+	if (close && !first)
+	{
+		path.Close();
+	}
+}
+
+// Builds the outline for a shape element, false for elements that don't draw anything themselves
+static bool BuildShapePath(const std::string& name, const std::vector<SceneAttribute>& attributes, VectorPath& path)
+{
+	if (name == "path")
+	{
+		const char* data = FindAttribute(attributes, "d");
+		if (data && !ParsePathData(data, path))
+		{
+			Debug::console("Svg: Stopped reading path data partway through\n");
+		}
+	}
+	else if (name == "rect")
+	{
+		float rx = NumberAttribute(attributes, "rx", -1.0f);
+		float ry = NumberAttribute(attributes, "ry", -1.0f);
+		rx = rx < 0.0f ? SDL_max(ry, 0.0f) : rx;
+		ry = ry < 0.0f ? rx : ry;
+		float w = NumberAttribute(attributes, "width");
+		float h = NumberAttribute(attributes, "height");
+		if (w > 0.0f && h > 0.0f)
+		{
+			AddRect(path, NumberAttribute(attributes, "x"), NumberAttribute(attributes, "y"), w, h, rx, ry);
+		}
+	}
+	else if (name == "circle")
+	{
+		float r = NumberAttribute(attributes, "r");
+		if (r > 0.0f)
+		{
+			AddEllipse(path, NumberAttribute(attributes, "cx"), NumberAttribute(attributes, "cy"), r, r);
+		}
+	}
+	else if (name == "ellipse")
+	{
+		float rx = NumberAttribute(attributes, "rx");
+		float ry = NumberAttribute(attributes, "ry");
+		if (rx > 0.0f && ry > 0.0f)
+		{
+			AddEllipse(path, NumberAttribute(attributes, "cx"), NumberAttribute(attributes, "cy"), rx, ry);
+		}
+	}
+	else if (name == "line")
+	{
+		path.MoveTo(NumberAttribute(attributes, "x1"), NumberAttribute(attributes, "y1"));
+		path.LineTo(NumberAttribute(attributes, "x2"), NumberAttribute(attributes, "y2"));
+	}
+	else if (name == "polyline" || name == "polygon")
+	{
+		const char* points = FindAttribute(attributes, "points");
+		if (points)
+		{
+			AddPoints(path, points, name == "polygon");
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// Elements whose insides are never drawn straight onto the page
+static bool IsHiddenContainer(const std::string& name)
+{
+	return name == "defs" || name == "clipPath" || name == "mask" || name == "pattern" || name == "symbol" ||
+		name == "marker" || name == "linearGradient" || name == "radialGradient" || name == "style" || name == "title" || name == "desc";
+}
+
+VectorScene::VectorScene()
+	: width(0.0f), height(0.0f), drawCount(0), flattenCount(0), viewValid(false), viewZoom(0.0f), viewX(0.0f), viewY(0.0f), tiled(true)
+{
+}
+
+void VectorScene::Clear()
+{
+	shapes.clear();
+	levels.clear();
+	width = 0.0f;
+	height = 0.0f;
+	flattenCount = 0;
+	viewValid = false;
+}
+
+bool VectorScene::Load(const char* filename)
+{
+	FILE* file = fopen(filename, "rb");
+	if (!file)
+	{
+		Debug::console("Svg: Unable to open %s\n", filename);
+		Clear();
+		return false;
+	}
+
+	std::string text;
+	char buffer[16384];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text.append(buffer, read);
+	}
+	fclose(file);
+
+	return Parse(text.c_str());
+}
+
+// Not a real xml parser, it only understands tags and their attributes, which is all the drawing needs
+bool VectorScene::Parse(const char* text)
+{
+	Clear();
+
+	std::vector<SceneStyle> styles(1);
+	std::vector<SceneAttribute> attributes;
+	int hiddenDepth = 0;
+	bool foundRoot = false;
+
+	const char* s = text;
+	while ((s = strchr(s, '<')) != NULL)
+	{
+		if (strncmp(s, "<!--", 4) == 0)
+		{
+			const char* end = strstr(s, "-->");
+			s = end ? end + 3 : s + strlen(s);
+			continue;
+		}
+
+		if (s[1] == '?' || s[1] == '!')
+		{
+			const char* end = strchr(s, '>');
+			s = end ? end + 1 : s + strlen(s);
+			continue;
+		}
+
+		bool closing = s[1] == '/';
+		s += closing ? 2 : 1;
+
+		const char* nameStart = s;
+		while (*s && *s != '>' && *s != '/' && *s != ' ' && *s != '\t' && *s != '\n' && *s != '\r')
+		{
+			++s;
+		}
+		std::string name(nameStart, s - nameStart);
+
+		// Read the attributes up to the end of the tag
+		attributes.clear();
+		bool selfClosing = false;
+		while (*s && *s != '>')
+		{
+			if (*s == '/')
+			{
+				selfClosing = true;
+				++s;
+				continue;
+			}
+
+			if (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+			{
+				++s;
+				continue;
+			}
+
+			const char* attributeStart = s;
+			while (*s && *s != '=' && *s != '>' && *s != ' ' && *s != '\t' && *s != '\n' && *s != '\r')
+			{
+				++s;
+			}
+
+			SceneAttribute attribute;
+			attribute.name.assign(attributeStart, s - attributeStart);
+			while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+			{
+				++s;
+			}
+
+			if (*s == '=')
+			{
+				++s;
+				while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+				{
+					++s;
+				}
+
+				if (*s == '"' || *s == '\'')
+				{
+					char quote = *s++;
+					const char* valueStart = s;
+					while (*s && *s != quote)
+					{
+						++s;
+					}
+					attribute.value.assign(valueStart, s - valueStart);
+					if (*s)
+					{
+						++s;
+					}
+				}
+			}
+
+			attributes.push_back(attribute);
+		}
+
+		if (!*s)
+		{
+			Debug::console("Svg: The document ends partway through a tag\n");
+			return false;
+		}
+		++s;
+
+		if (closing)
+		{
+			if (hiddenDepth > 0)
+			{
+				--hiddenDepth;
+			}
+			else if (styles.size() > 1)
+			{
+				styles.pop_back();
+			}
+			continue;
+		}
+
+		if (hiddenDepth > 0)
+		{
+			hiddenDepth += selfClosing ? 0 : 1;
+			continue;
+		}
+
+		if (IsHiddenContainer(name))
+		{
+			hiddenDepth = selfClosing ? 0 : 1;
+			continue;
+		}
+
+		SceneStyle style = styles.back();
+		if (name == "svg" && !foundRoot)
+		{
+			// The outer svg sets the page size, and a view box maps the document's own units onto it
+			foundRoot = true;
+			float viewBox[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			const char* box = FindAttribute(attributes, "viewBox");
+			bool hasViewBox = box && sscanf(box, "%f%*[ ,]%f%*[ ,]%f%*[ ,]%f", &viewBox[0], &viewBox[1], &viewBox[2], &viewBox[3]) == 4 &&
+				viewBox[2] > 0.0f && viewBox[3] > 0.0f;
+
+			const char* widthText = FindAttribute(attributes, "width");
+			const char* heightText = FindAttribute(attributes, "height");
+			width = widthText && !strchr(widthText, '%') ? (float)atof(widthText) : (hasViewBox ? viewBox[2] : 0.0f);
+			height = heightText && !strchr(heightText, '%') ? (float)atof(heightText) : (hasViewBox ? viewBox[3] : 0.0f);
+
+			if (hasViewBox)
+			{
+				width = width > 0.0f ? width : viewBox[2];
+				height = height > 0.0f ? height : viewBox[3];
+				float scaleX = width / viewBox[2];
+				float scaleY = height / viewBox[3];
+				style.transform = style.transform * Transform2D(scaleX, 0.0f, 0.0f, scaleY, -viewBox[0] * scaleX, -viewBox[1] * scaleY);
+			}
+		}
+
+		ApplyStyle(style, attributes);
+		if (!selfClosing)
+		{
+			styles.push_back(style);
+		}
+
+		VectorShape shape;
+		if (!BuildShapePath(name, attributes, shape.path) || shape.path.Empty())
+		{
+			continue;
+		}
+
+		shape.path.Transform(style.transform);
+		shape.filled = style.filled;
+		shape.fill = style.fill;
+		shape.fillRule = style.fillRule;
+		shape.fillOpacity = (Uint8)(style.fillOpacity * style.opacity * 255.0f + 0.5f);
+		shape.stroked = style.stroked && style.strokeStyle.width > 0.0f;
+		shape.stroke = style.stroke;
+		shape.strokeStyle = style.strokeStyle;
+		shape.strokeStyle.width *= style.transform.Scale();
+		shape.strokeOpacity = (Uint8)(style.strokeOpacity * style.opacity * 255.0f + 0.5f);
+
+		// Lines and polylines still fill in svg, but there's never anything inside a line
+		if (name == "line")
+		{
+			shape.filled = false;
+		}
+
+		AddShape(shape);
+	}
+
+	return true;
+}
+
+void VectorScene::AddShape(const VectorShape& shape)
+{
+	shapes.push_back(shape);
+
+	// Levels flattened before this shape was added don't have it
+	levels.clear();
+	viewValid = false;
+}
+
+// Zoom levels go up in half octaves, and each is flattened for the biggest zoom it covers
+const VectorScene::FlatLevel& VectorScene::GetLevel(float zoom)
+{
+	int level = (int)ceilf(log2f(zoom) * 2.0f);
+	++drawCount;
+
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		if (levels[i].level == level)
+		{
+			levels[i].lastUsed = drawCount;
+			return levels[i];
+		}
+	}
+
+	size_t slot = levels.size();
+	if (levels.size() >= SCENE_CACHED_LEVELS)
+	{
+		slot = 0;
+		for (size_t i = 1; i < levels.size(); ++i)
+		{
+			if (levels[i].lastUsed < levels[slot].lastUsed)
+			{
+				slot = i;
+			}
+		}
+	}
+	else
+	{
+		levels.resize(levels.size() + 1);
+	}
+
+	FlatLevel& flat = levels[slot];
+	flat.level = level;
+	flat.lastUsed = drawCount;
+	flat.shapes.resize(shapes.size());
+
+	float tolerance = SCENE_FLATTEN_TOLERANCE / powf(2.0f, level * 0.5f);
+	for (size_t i = 0; i < shapes.size(); ++i)
+	{
+		FlattenPath(shapes[i].path, tolerance, flat.shapes[i]);
+		++flattenCount;
+	}
+
+	return flat;
+}
+
+// Moves one flattened contour from document space onto the screen
+static void PlaceContour(const FlatPath& path, int first, int end, float zoom, float x, float y, std::vector<PolygonPoint>& placed)
+{
+	placed.resize(end - first);
+	for (int p = first; p < end; ++p)
+	{
+		placed[p - first].x = path.points[p].x * zoom + x;
+		placed[p - first].y = path.points[p].y * zoom + y;
+	}
+}
+
+void VectorScene::BuildEdges(float zoom, float x, float y)
+{
+	const FlatLevel& flat = GetLevel(zoom);
+
+	edges.clear();
+	fills.clear();
+
+	std::vector<PolygonPoint> placed;
+	for (size_t i = 0; i < shapes.size(); ++i)
+	{
+		const VectorShape& shape = shapes[i];
+		const FlatPath& path = flat.shapes[i];
+
+		VectorFill fill;
+		if (shape.filled)
+		{
+			fill.firstEdge = (int)edges.size();
+			for (size_t contour = 0; contour < path.ends.size(); ++contour)
+			{
+				int first = contour > 0 ? path.ends[contour - 1] : 0;
+				PlaceContour(path, first, path.ends[contour], zoom, x, y, placed);
+				AddPolygonEdges(edges, &placed[0], (int)placed.size());
+			}
+
+			fill.edgeCount = (int)edges.size() - fill.firstEdge;
+			fill.color = shape.fill;
+			fill.rule = shape.fillRule;
+			fill.opacity = shape.fillOpacity;
+			if (fill.edgeCount > 0)
+			{
+				fills.push_back(fill);
+			}
+		}
+
+		if (shape.stroked)
+		{
+			StrokeStyle stroke = shape.strokeStyle;
+			stroke.width *= zoom;
+
+			fill.firstEdge = (int)edges.size();
+			for (size_t contour = 0; contour < path.ends.size(); ++contour)
+			{
+				int first = contour > 0 ? path.ends[contour - 1] : 0;
+				PlaceContour(path, first, path.ends[contour], zoom, x, y, placed);
+				AddStrokeEdges(edges, &placed[0], (int)placed.size(), path.closed[contour], stroke);
+			}
+
+			fill.edgeCount = (int)edges.size() - fill.firstEdge;
+			fill.color = shape.stroke;
+			fill.rule = FILL_NONZERO;
+			fill.opacity = shape.strokeOpacity;
+			if (fill.edgeCount > 0)
+			{
+				fills.push_back(fill);
+			}
+		}
+	}
+
+	viewValid = true;
+	viewZoom = zoom;
+	viewX = x;
+	viewY = y;
+}
+
+void VectorScene::Draw(Device* screen, float zoom, float x, float y)
+{
+	if (shapes.empty() || zoom <= 0.0f)
+	{
+		return;
+	}
+
+	if (!viewValid || zoom != viewZoom || x != viewX || y != viewY)
+	{
+		BuildEdges(zoom, x, y);
+	}
+
+	if (fills.empty())
+	{
+		return;
+	}
+
+	if (tiled)
+	{
+		tileRenderer.Draw(screen, &edges[0], &fills[0], (int)fills.size());
+		return;
+	}
+
+	ClipRect clip(0, 0, screen->Width(), screen->Height());
+	for (size_t i = 0; i < fills.size(); ++i)
+	{
+		const VectorFill& fill = fills[i];
+		rasterizer.Fill(screen, clip, &edges[fill.firstEdge], fill.edgeCount, fill.color, fill.rule, fill.opacity);
+	}
+}
@@ -0,0 +1,113 @@
+#ifndef RENDERING_SVG_SCENE_H
+#define RENDERING_SVG_SCENE_H
+
+#include <string>
+#include <vector>
+#include "path.h"
+#include "coverage.h"
+#include "stroke.h"
+#include "vectortiles.h"
+#include "../device.h"
+#include "../color.h"
+
+// How far a flattened curve can be from the real one, in screen pixels
+const float SCENE_FLATTEN_TOLERANCE = 0.2f;
+
+// How many zoom levels of flattened curves a scene keeps before it throws out the one used longest ago
+const int SCENE_CACHED_LEVELS = 4;
+
+// One filled and/or stroked outline out of a document, already moved into document space
+struct VectorShape
+{
+	VectorShape()
+		: filled(true), fillRule(FILL_NONZERO), fillOpacity(255),
+		stroked(false), strokeOpacity(255)
+	{}
+
+	VectorPath path;
+
+	bool filled;
+	Color fill;
+	FillRule fillRule;
+	Uint8 fillOpacity;
+
+	bool stroked;
+	Color stroke;
+	Uint8 strokeOpacity;
+
+	// The width is in document units
+	StrokeStyle strokeStyle;
+};
+
+// A vector document that's loaded once and drawn as many times as we like
+// Covers the parts of svg that most drawings use: path, rect, circle, ellipse, line, polyline and polygon,
+// inside nested groups with transforms, and solid fills and strokes (with their joins and caps) set by attribute or style
+// Gradients, text, clipping and markers are skipped. Group opacity is multiplied into each shape rather than blended as a layer
+//
+// Curves are flattened once per zoom level and kept, so drawing the same document again only rasterizes it,
+// and moving the view just moves the points we already have
+class VectorScene
+{
+public:
+	VectorScene();
+
+	// Throws out whatever was loaded before. On failure the scene keeps the shapes read before the mistake
+	bool Load(const char* filename);
+	bool Parse(const char* text);
+	void Clear();
+
+	// The size the document asks for, in document units
+	float Width() const { return width; }
+	float Height() const { return height; }
+
+	int ShapeCount() const { return (int)shapes.size(); }
+	const VectorShape& Shape(int i) const { return shapes[i]; }
+
+	// Adds a shape made in code. Its path should already be in document space
+	void AddShape(const VectorShape& shape);
+
+	// Draws the document scaled by zoom with its top left corner at x, y on the screen
+	void Draw(Device* screen, float zoom, float x, float y);
+
+	// Tiled drawing spreads the shapes over every thread, otherwise they're filled one at a time on this one
+	void SetTiled(bool enabled) { tiled = enabled; }
+	bool Tiled() const { return tiled; }
+	const VectorTileRenderer& TileRenderer() const { return tileRenderer; }
+
+	// How many times a shape has been flattened since loading, which should stop going up once the view settles
+	int FlattenCount() const { return flattenCount; }
+
+private:
+	// Every shape flattened at one zoom level
+	struct FlatLevel
+	{
+		int level;
+		Uint32 lastUsed;
+		std::vector<FlatPath> shapes;
+	};
+
+	const FlatLevel& GetLevel(float zoom);
+	void BuildEdges(float zoom, float x, float y);
+
+	std::vector<VectorShape> shapes;
+	float width;
+	float height;
+
+	std::vector<FlatLevel> levels;
+	Uint32 drawCount;
+	int flattenCount;
+
+	// Screen space edges for the last view, and the fills and strokes that use them in drawing order
+	bool viewValid;
+	float viewZoom;
+	float viewX;
+	float viewY;
+	std::vector<PathEdge> edges;
+	std::vector<VectorFill> fills;
+
+	bool tiled;
+	VectorTileRenderer tileRenderer;
+	CoverageRasterizer rasterizer;
+};
+
+#endif
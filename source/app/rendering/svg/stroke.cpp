@@ -0,0 +1,358 @@
+#include "stroke.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// Round pieces never get more steps than this however big they are
+const int STROKE_MAX_ARC_STEPS = 128;
+
+struct StrokeVector
+{
+	float x;
+	float y;
+};
+
+// The offset a half width out to one side of a direction. Walking the line the other way gives the other side
+static inline PolygonPoint Offset(const PolygonPoint& point, StrokeVector direction, float halfWidth)
+{
+	PolygonPoint offset = { point.x - direction.y * halfWidth, point.y + direction.x * halfWidth };
+	return offset;
+}
+
+static float SignedArea(const std::vector<PolygonPoint>& points)
+{
+	float area = 0.0f;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		const PolygonPoint& a = points[i];
+		const PolygonPoint& b = points[(i + 1) % points.size()];
+		area += a.x * b.y - b.x * a.y;
+	}
+
+	return area;
+}
+
+// Adds the points partway round an arc, from start turned by angle around center. The ends are left for the caller
+static void AppendArc(std::vector<PolygonPoint>& outline, const PolygonPoint& center, StrokeVector start, float angle, float radius)
+{
+	float step = 2.0f * acosf(SDL_max(-1.0f, 1.0f - STROKE_ROUND_TOLERANCE / radius));
+	int steps = SDL_min(SDL_max((int)ceilf(fabsf(angle) / step), 1), STROKE_MAX_ARC_STEPS);
+
+	// The points in between sit a little outside the circle, so the flat sides lose about as much as they gain
+	float stepAngle = angle / steps;
+	float cosStep = cosf(stepAngle);
+	float sinStep = sinf(stepAngle);
+	float outside = sqrtf(fabsf(stepAngle) / SDL_max(fabsf(sinStep), 1e-6f));
+	StrokeVector offset = start;
+	for (int i = 1; i < steps; ++i)
+	{
+		float x = offset.x * cosStep - offset.y * sinStep;
+		offset.y = offset.x * sinStep + offset.y * cosStep;
+		offset.x = x;
+
+		PolygonPoint point = { center.x + offset.x * outside, center.y + offset.y * outside };
+		outline.push_back(point);
+	}
+}
+
+// Which way to turn from an offset to head along direction
+static inline float TurnToward(StrokeVector offset, StrokeVector direction)
+{
+	return offset.x * direction.y - offset.y * direction.x > 0.0f ? 1.0f : -1.0f;
+}
+
+// Goes round the corner at point on our side of the line, where it turns from direction in to direction out
+// On the outside of the turn the gap gets the join. On the inside the two offsets cross over, and going in to the
+// point and back out again makes the overlap count twice rather than cancel out
+static void AppendCorner(std::vector<PolygonPoint>& outline, const PolygonPoint& point, StrokeVector in, StrokeVector out,
+	float halfWidth, const StrokeStyle& style, bool firstSide)
+{
+	float cross = in.x * out.y - in.y * out.x;
+	float dot = in.x * out.x + in.y * out.y;
+	bool turning = fabsf(cross) >= 1e-6f;
+	if (!turning && dot > 0.0f)
+	{
+		outline.push_back(Offset(point, in, halfWidth));
+		return;
+	}
+
+	// When the line doubles straight back either side could be the outside, so the first side takes it
+	bool outside = turning ? cross < 0.0f : firstSide;
+
+	PolygonPoint from = Offset(point, in, halfWidth);
+	PolygonPoint to = Offset(point, out, halfWidth);
+	outline.push_back(from);
+
+	if (!outside)
+	{
+		outline.push_back(point);
+	}
+	else if (style.join == JOIN_ROUND)
+	{
+		StrokeVector start = { from.x - point.x, from.y - point.y };
+		float angle = acosf(SDL_max(-1.0f, SDL_min(dot, 1.0f)));
+		AppendArc(outline, point, start, angle * TurnToward(start, in), halfWidth);
+	}
+	else if (style.join == JOIN_MITER && dot > -1.0f + 1e-6f && 1.0f / sqrtf((1.0f + dot) * 0.5f) <= style.miterLimit)
+	{
+		// The miter is as long compared to the width as one over the sine of half the angle between the segments
+		PolygonPoint miter = {
+			point.x + (from.x - point.x + to.x - point.x) / (1.0f + dot),
+			point.y + (from.y - point.y + to.y - point.y) / (1.0f + dot)
+		};
+		outline.push_back(miter);
+	}
+
+	outline.push_back(to);
+}
+
+// Goes round the end at point from our side to the other, with direction pointing out away from the line
+static void AppendCap(std::vector<PolygonPoint>& outline, const PolygonPoint& point, StrokeVector direction, float halfWidth, LineCap cap)
+{
+	PolygonPoint from = Offset(point, direction, halfWidth);
+	StrokeVector start = { from.x - point.x, from.y - point.y };
+	if (cap == CAP_ROUND)
+	{
+		AppendArc(outline, point, start, (float)M_PI * TurnToward(start, direction), halfWidth);
+	}
+	else if (cap == CAP_SQUARE)
+	{
+		float ex = direction.x * halfWidth;
+		float ey = direction.y * halfWidth;
+		PolygonPoint corners[2] = {
+			{ point.x + start.x + ex, point.y + start.y + ey }, { point.x - start.x + ex, point.y - start.y + ey }
+		};
+		outline.push_back(corners[0]);
+		outline.push_back(corners[1]);
+	}
+}
+
+// Walks one side of the line, points and directions already in the order for that side
+static void AppendSide(std::vector<PolygonPoint>& outline, const std::vector<PolygonPoint>& points, const std::vector<StrokeVector>& directions,
+	bool closed, float halfWidth, const StrokeStyle& style, bool firstSide)
+{
+	int pointCount = (int)points.size();
+	int segmentCount = (int)directions.size();
+	if (closed)
+	{
+		for (int i = 0; i < pointCount; ++i)
+		{
+			AppendCorner(outline, points[i], directions[(i + segmentCount - 1) % segmentCount], directions[i], halfWidth, style, firstSide);
+		}
+		return;
+	}
+
+	outline.push_back(Offset(points[0], directions[0], halfWidth));
+	for (int i = 1; i < pointCount - 1; ++i)
+	{
+		AppendCorner(outline, points[i], directions[i - 1], directions[i], halfWidth, style, firstSide);
+	}
+	outline.push_back(Offset(points[pointCount - 1], directions[segmentCount - 1], halfWidth));
+}
+
+// The outline goes down one side of the line and back up the other, so it's the same as a box for every segment
+// plus a piece for every join and cap, all wound the same way, with the edges they share cancelled out
+void AddStrokeEdges(std::vector<PathEdge>& edges, const PolygonPoint* points, int count, bool closed, const StrokeStyle& style)
+{
+	float halfWidth = style.width * 0.5f;
+	if (count < 1 || !(halfWidth > 0.0f))
+	{
+		return;
+	}
+
+	// Points on top of each other have no direction, so they're dropped before anything else
+	static thread_local std::vector<PolygonPoint> forward;
+	forward.clear();
+	for (int i = 0; i < count; ++i)
+	{
+		if (forward.empty() || points[i].x != forward.back().x || points[i].y != forward.back().y)
+		{
+			forward.push_back(points[i]);
+		}
+	}
+
+	while (closed && forward.size() > 1 && forward.back().x == forward[0].x && forward.back().y == forward[0].y)
+	{
+		forward.pop_back();
+	}
+
+	static thread_local std::vector<PolygonPoint> outline;
+	static thread_local std::vector<PolygonPoint> inner;
+	outline.clear();
+	inner.clear();
+
+	int pointCount = (int)forward.size();
+
+	// A line with no length still shows up as a dot with round or square caps, the same as svg
+	if (pointCount == 1)
+	{
+		if (!closed && style.cap != CAP_BUTT)
+		{
+			StrokeVector right = { 1.0f, 0.0f };
+			StrokeVector left = { -1.0f, 0.0f };
+			outline.push_back(Offset(forward[0], right, halfWidth));
+			AppendCap(outline, forward[0], right, halfWidth, style.cap);
+			outline.push_back(Offset(forward[0], left, halfWidth));
+			AppendCap(outline, forward[0], left, halfWidth, style.cap);
+		}
+	}
+	else
+	{
+		int segmentCount = closed ? pointCount : pointCount - 1;
+		static thread_local std::vector<StrokeVector> directions;
+		directions.resize(segmentCount);
+		for (int i = 0; i < segmentCount; ++i)
+		{
+			const PolygonPoint& a = forward[i];
+			const PolygonPoint& b = forward[(i + 1) % pointCount];
+			float dx = b.x - a.x;
+			float dy = b.y - a.y;
+			float length = sqrtf(dx * dx + dy * dy);
+			directions[i].x = dx / length;
+			directions[i].y = dy / length;
+		}
+
+		// The other side is the same walk with the line turned around
+		static thread_local std::vector<PolygonPoint> backward;
+		static thread_local std::vector<StrokeVector> backwardDirections;
+		backward.assign(forward.rbegin(), forward.rend());
+		backwardDirections.resize(segmentCount);
+		for (int i = 0; i < segmentCount; ++i)
+		{
+			const StrokeVector& direction = directions[closed ? (2 * segmentCount - 2 - i) % segmentCount : segmentCount - 1 - i];
+			backwardDirections[i].x = -direction.x;
+			backwardDirections[i].y = -direction.y;
+		}
+
+		AppendSide(outline, forward, directions, closed, halfWidth, style, true);
+		if (closed)
+		{
+			AppendSide(inner, backward, backwardDirections, closed, halfWidth, style, false);
+		}
+		else
+		{
+			AppendCap(outline, forward[pointCount - 1], directions[segmentCount - 1], halfWidth, style.cap);
+			AppendSide(outline, backward, backwardDirections, closed, halfWidth, style, false);
+			AppendCap(outline, forward[0], backwardDirections[segmentCount - 1], halfWidth, style.cap);
+		}
+	}
+
+	// The pieces all add up the same way round, whichever way that turned out to be, so flip it if it's backwards
+	if (SignedArea(outline) + SignedArea(inner) < 0.0f)
+	{
+		std::reverse(outline.begin(), outline.end());
+		std::reverse(inner.begin(), inner.end());
+	}
+
+	if (outline.size() >= 3)
+	{
+		AddPolygonEdges(edges, &outline[0], (int)outline.size());
+	}
+
+	if (inner.size() >= 3)
+	{
+		AddPolygonEdges(edges, &inner[0], (int)inner.size());
+	}
+}
+
+// FNV-1a over the points and the style, just to skip most of the entries without comparing all their points
+static Uint32 HashStroke(const PolygonPoint* points, int count, bool closed, const StrokeStyle& style)
+{
+	Uint32 hash = 2166136261u;
+	const Uint8* bytes = (const Uint8*)points;
+	size_t size = count * sizeof(PolygonPoint);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+
+	float values[2] = { style.width, style.miterLimit };
+	bytes = (const Uint8*)values;
+	for (size_t i = 0; i < sizeof(values); ++i)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+
+	hash = (hash ^ (Uint32)style.join) * 16777619u;
+	hash = (hash ^ (Uint32)style.cap) * 16777619u;
+	return (hash ^ (closed ? 1u : 0u)) * 16777619u;
+}
+
+StrokeCache::StrokeCache()
+	: useCount(0), tessellateCount(0)
+{
+}
+
+void StrokeCache::Clear()
+{
+	entries.clear();
+	useCount = 0;
+}
+
+const std::vector<PathEdge>& StrokeCache::Get(const PolygonPoint* points, int count, bool closed, const StrokeStyle& style)
+{
+	Uint32 hash = HashStroke(points, count, closed, style);
+	++useCount;
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		Entry& entry = entries[i];
+		if (entry.hash == hash && entry.closed == closed && (int)entry.points.size() == count
+			&& entry.style.width == style.width && entry.style.join == style.join && entry.style.cap == style.cap
+			&& entry.style.miterLimit == style.miterLimit
+			&& (count == 0 || memcmp(&entry.points[0], points, count * sizeof(PolygonPoint)) == 0))
+		{
+			entry.lastUsed = useCount;
+			return entry.edges;
+		}
+	}
+
+	size_t slot = entries.size();
+	if (entries.size() >= STROKE_CACHED_SHAPES)
+	{
+		slot = 0;
+		for (size_t i = 1; i < entries.size(); ++i)
+		{
+			if (entries[i].lastUsed < entries[slot].lastUsed)
+			{
+				slot = i;
+			}
+		}
+	}
+	else
+	{
+		entries.resize(entries.size() + 1);
+	}
+
+	Entry& entry = entries[slot];
+	entry.hash = hash;
+	entry.lastUsed = useCount;
+	entry.closed = closed;
+	entry.style = style;
+	entry.points.assign(points, points + count);
+	entry.edges.clear();
+	AddStrokeEdges(entry.edges, points, count, closed, style);
+	++tessellateCount;
+
+	return entry.edges;
+}
+
+void StrokePolyline(Device* screen, const PolygonPoint* points, int count, bool closed, const StrokeStyle& style, Color c, Uint8 opacity)
+{
+	static thread_local StrokeCache cache;
+	static thread_local CoverageRasterizer rasterizer;
+
+	const std::vector<PathEdge>& edges = cache.Get(points, count, closed, style);
+	if (!edges.empty())
+	{
+		rasterizer.Fill(screen, ClipRect(0, 0, screen->Width(), screen->Height()), edges, c, FILL_NONZERO, opacity);
+	}
+}
+
+void StrokePolyline(Device* screen, const std::vector<PolygonPoint>& points, bool closed, const StrokeStyle& style, Color c, Uint8 opacity)
+{
+	if (!points.empty())
+	{
+		StrokePolyline(screen, &points[0], (int)points.size(), closed, style, c, opacity);
+	}
+}
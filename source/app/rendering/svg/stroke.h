@@ -0,0 +1,89 @@
+#ifndef RENDERING_SVG_STROKE_H
+#define RENDERING_SVG_STROKE_H
+
+#include <vector>
+#include "polygon.h"
+#include "coverage.h"
+#include "../device.h"
+#include "../color.h"
+
+// How far the flat sides of a round join or cap can be from the real circle, in pixels
+const float STROKE_ROUND_TOLERANCE = 0.1f;
+
+// How many different strokes a cache keeps before it throws out the one used longest ago
+const int STROKE_CACHED_SHAPES = 256;
+
+// What goes on the outside of a corner, the same three svg has
+enum LineJoin
+{
+	// The two edges carry on until they meet, unless that's further out than the miter limit, then it's a bevel
+	JOIN_MITER,
+	JOIN_ROUND,
+	JOIN_BEVEL
+};
+
+// What goes on the ends of an open line
+enum LineCap
+{
+	// Stops flat right at the end point
+	CAP_BUTT,
+	CAP_ROUND,
+
+	// Stops flat half the width past the end point
+	CAP_SQUARE
+};
+
+struct StrokeStyle
+{
+	StrokeStyle(float _width = 1.0f, LineJoin _join = JOIN_MITER, LineCap _cap = CAP_BUTT, float _miterLimit = 4.0f)
+		: width(_width), join(_join), cap(_cap), miterLimit(_miterLimit)
+	{}
+
+	float width;
+	LineJoin join;
+	LineCap cap;
+
+	// How long a miter can get compared to the width before it's cut off to a bevel
+	float miterLimit;
+};
+
+// Turns a line through the points into edges for the fill rasterizers, joining back to the first point when it's closed
+// The outline winds the same way everywhere it overlaps itself, so filling it with the nonzero rule gives the whole stroke
+void AddStrokeEdges(std::vector<PathEdge>& edges, const PolygonPoint* points, int count, bool closed, const StrokeStyle& style);
+
+// Keeps the edges of strokes that have been tessellated, so drawing the exact same stroke again
+// (the same HUD element every frame) just finds the edges it had last time
+class StrokeCache
+{
+public:
+	StrokeCache();
+
+	// The edges for a stroke, only tessellating it when there's no match kept. They stay valid until the next call
+	const std::vector<PathEdge>& Get(const PolygonPoint* points, int count, bool closed, const StrokeStyle& style);
+
+	void Clear();
+
+	// How many strokes have been tessellated rather than found, which should stop going up once the strokes settle
+	int TessellateCount() const { return tessellateCount; }
+
+private:
+	struct Entry
+	{
+		Uint32 hash;
+		Uint32 lastUsed;
+		bool closed;
+		StrokeStyle style;
+		std::vector<PolygonPoint> points;
+		std::vector<PathEdge> edges;
+	};
+
+	std::vector<Entry> entries;
+	Uint32 useCount;
+	int tessellateCount;
+};
+
+// Draws a stroke with anti-aliased edges. Each thread keeps its own cache of strokes for this
+void StrokePolyline(Device* screen, const PolygonPoint* points, int count, bool closed, const StrokeStyle& style, Color c, Uint8 opacity = 255);
+void StrokePolyline(Device* screen, const std::vector<PolygonPoint>& points, bool closed, const StrokeStyle& style, Color c, Uint8 opacity = 255);
+
+#endif
@@ -0,0 +1,416 @@
+#include "vectortiles.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "../../jobs.h"
+#include "../../profiler.h"
+
+VectorTileRenderer::VectorTileRenderer()
+	: screenWidth(0), screenHeight(0), tilesX(0), tilesY(0), solidTiles(0), edgeTiles(0)
+{
+}
+
+void VectorTileRenderer::Draw(Device* screen, const PathEdge* edges, const VectorFill* fills, int fillCount)
+{
+	screenWidth = screen->Width();
+	screenHeight = screen->Height();
+	tilesX = (screenWidth + VECTOR_TILE_SIZE - 1) / VECTOR_TILE_SIZE;
+	tilesY = (screenHeight + VECTOR_TILE_SIZE - 1) / VECTOR_TILE_SIZE;
+
+	// Rows and tiles keep their memory from draw to draw, they just get emptied when they're binned into again
+	rows.resize(tilesY);
+	tiles.resize(tilesX * tilesY);
+	bounds.resize(fillCount);
+
+	Jobs::ParallelFor(fillCount, 64, [&](int start, int end)
+	{
+		for (int i = start; i < end; ++i)
+		{
+			const VectorFill& fill = fills[i];
+			FillBounds& box = bounds[i];
+			box.left = box.top = 1e30f;
+			box.right = box.bottom = -1e30f;
+			for (int e = fill.firstEdge; e < fill.firstEdge + fill.edgeCount; ++e)
+			{
+				const PathEdge& edge = edges[e];
+				box.left = SDL_min(box.left, SDL_min(edge.x0, edge.x1));
+				box.right = SDL_max(box.right, SDL_max(edge.x0, edge.x1));
+				box.top = SDL_min(box.top, edge.y0);
+				box.bottom = SDL_max(box.bottom, edge.y1);
+			}
+		}
+	});
+
+	Jobs::ParallelFor(tilesY, 1, [&](int start, int end)
+	{
+		PROFILE_ZONE("Bin vector rows");
+		for (int row = start; row < end; ++row)
+		{
+			BinRow(row, edges, fills, fillCount);
+		}
+	});
+
+	solidTiles = 0;
+	edgeTiles = 0;
+	for (int row = 0; row < tilesY; ++row)
+	{
+		solidTiles += rows[row].solidTiles;
+		edgeTiles += rows[row].edgeTiles;
+	}
+
+	Jobs::ParallelFor(tilesX * tilesY, 1, [&](int start, int end)
+	{
+		PROFILE_ZONE("Fill vector tiles");
+		for (int tile = start; tile < end; ++tile)
+		{
+			FillTile(screen, tile, edges, fills);
+		}
+	});
+}
+
+// Every fill crossing the row keeps the edges that overlap it, and every tile of the fill gets marked if one of
+// those passes through it. Unmarked tiles can't have an edge inside, so the winding is the same all over them and
+// the winding at their middle says whether they're filled
+void VectorTileRenderer::BinRow(int row, const PathEdge* edges, const VectorFill* fills, int fillCount)
+{
+	TileRow& tileRow = rows[row];
+	tileRow.edges.clear();
+	tileRow.touched.resize(tilesX);
+	tileRow.solidTiles = 0;
+	tileRow.edgeTiles = 0;
+
+	std::vector<TileEntry>* rowTiles = &tiles[row * tilesX];
+	for (int column = 0; column < tilesX; ++column)
+	{
+		rowTiles[column].clear();
+	}
+
+	float top = (float)(row * VECTOR_TILE_SIZE);
+	float bottom = (float)SDL_min((row + 1) * VECTOR_TILE_SIZE, screenHeight);
+	float middle = (top + bottom) * 0.5f;
+
+	for (int i = 0; i < fillCount; ++i)
+	{
+		const FillBounds& box = bounds[i];
+		if (box.bottom <= top || box.top >= bottom || box.right <= 0.0f || box.left >= screenWidth)
+		{
+			continue;
+		}
+
+		int firstColumn = SDL_max((int)box.left, 0) / VECTOR_TILE_SIZE;
+		int lastColumn = SDL_min((int)ceilf(box.right), screenWidth - 1) / VECTOR_TILE_SIZE;
+		memset(&tileRow.touched[firstColumn], 0, lastColumn - firstColumn + 1);
+		tileRow.crossings.clear();
+		tileRow.corners.clear();
+
+		const VectorFill& fill = fills[i];
+		int firstEdge = (int)tileRow.edges.size();
+		for (int e = fill.firstEdge; e < fill.firstEdge + fill.edgeCount; ++e)
+		{
+			const PathEdge& edge = edges[e];
+			if (edge.y1 <= top || edge.y0 >= bottom)
+			{
+				continue;
+			}
+
+			tileRow.edges.push_back(e);
+
+			// The part of the edge inside the row, and the tiles it reaches across
+			float slope = (edge.x1 - edge.x0) / (edge.y1 - edge.y0);
+			float xa = edge.x0 + (SDL_max(edge.y0, top) - edge.y0) * slope;
+			float xb = edge.x0 + (SDL_min(edge.y1, bottom) - edge.y0) * slope;
+			float low = SDL_min(xa, xb);
+			float high = SDL_max(xa, xb);
+			if (high >= 0.0f && low < screenWidth)
+			{
+				int first = SDL_max((int)low / VECTOR_TILE_SIZE, firstColumn);
+				int last = SDL_min((int)high / VECTOR_TILE_SIZE, lastColumn);
+				for (int column = first; column <= last; ++column)
+				{
+					tileRow.touched[column] = 1;
+				}
+			}
+
+			// Flat edges never made it into the list, but they still run between two corners at the same height
+			if (edge.y0 > top)
+			{
+				PolygonPoint corner = { edge.x0, edge.y0 };
+				tileRow.corners.push_back(corner);
+			}
+
+			if (edge.y1 < bottom)
+			{
+				PolygonPoint corner = { edge.x1, edge.y1 };
+				tileRow.corners.push_back(corner);
+			}
+
+			if (edge.y0 <= middle && edge.y1 > middle)
+			{
+				Crossing crossing;
+				crossing.x = edge.x0 + (middle - edge.y0) * slope;
+				crossing.winding = edge.winding;
+				tileRow.crossings.push_back(crossing);
+			}
+		}
+
+		int edgeCount = (int)tileRow.edges.size() - firstEdge;
+		if (edgeCount == 0)
+		{
+			continue;
+		}
+
+		// So the tiles between corners at the same height count as touched too
+		std::sort(tileRow.corners.begin(), tileRow.corners.end(), [](const PolygonPoint& a, const PolygonPoint& b)
+		{
+			return a.y < b.y || (a.y == b.y && a.x < b.x);
+		});
+
+		for (size_t c = 0; c < tileRow.corners.size();)
+		{
+			size_t end = c + 1;
+			while (end < tileRow.corners.size() && tileRow.corners[end].y == tileRow.corners[c].y)
+			{
+				++end;
+			}
+
+			float low = tileRow.corners[c].x;
+			float high = tileRow.corners[end - 1].x;
+			if (end - c > 1 && high >= 0.0f && low < screenWidth)
+			{
+				int first = SDL_max((int)SDL_max(low, 0.0f) / VECTOR_TILE_SIZE, firstColumn);
+				int last = SDL_min((int)high / VECTOR_TILE_SIZE, lastColumn);
+				for (int column = first; column <= last; ++column)
+				{
+					tileRow.touched[column] = 1;
+				}
+			}
+
+			c = end;
+		}
+
+		std::sort(tileRow.crossings.begin(), tileRow.crossings.end());
+		size_t nextCrossing = 0;
+		int winding = 0;
+
+		for (int column = firstColumn; column <= lastColumn; ++column)
+		{
+			TileEntry entry;
+			entry.fill = i;
+			entry.firstEdge = firstEdge;
+			entry.edgeCount = edgeCount;
+			entry.solid = false;
+
+			if (tileRow.touched[column])
+			{
+				rowTiles[column].push_back(entry);
+				++tileRow.edgeTiles;
+				continue;
+			}
+
+			float centerX = column * VECTOR_TILE_SIZE + VECTOR_TILE_SIZE * 0.5f;
+			while (nextCrossing < tileRow.crossings.size() && tileRow.crossings[nextCrossing].x < centerX)
+			{
+				winding += tileRow.crossings[nextCrossing++].winding;
+			}
+
+			bool inside = fill.rule == FILL_EVEN_ODD ? (winding & 1) != 0 : winding != 0;
+			if (inside)
+			{
+				entry.solid = true;
+				rowTiles[column].push_back(entry);
+				++tileRow.solidTiles;
+			}
+		}
+	}
+}
+
+// Sends a row of a tile to the screen a run of pixels at a time. Long runs go out as spans, and short ones are
+// collected up so the pixels along an edge get blended in one go
+struct TileRowWriter
+{
+	TileRowWriter(Device* _screen, int _y, int _left, const Color& _color, Uint32 _pixel)
+		: screen(_screen), y(_y), left(_left), color(_color), pixel(_pixel), pendingStart(0), pendingEnd(0)
+	{}
+
+	void Run(int start, int end, Uint8 alpha)
+	{
+		if (alpha == 0)
+		{
+			return;
+		}
+
+		if (end - start >= FRAMEBUFFER_TILE_SIZE)
+		{
+			if (alpha == 255)
+			{
+				screen->FillSpanMapped(y, left + start, left + end - 1, pixel);
+			}
+			else
+			{
+				screen->BlendSpan(y, left + start, left + end - 1, color, alpha);
+			}
+			return;
+		}
+
+		if (start != pendingEnd)
+		{
+			Flush();
+			pendingStart = start;
+		}
+
+		for (int x = start; x < end; ++x)
+		{
+			alphas[x] = alpha;
+		}
+		pendingEnd = end;
+	}
+
+	void Flush()
+	{
+		if (pendingEnd > pendingStart)
+		{
+			screen->BlendCoverage(y, left + pendingStart, pendingEnd - pendingStart, &alphas[pendingStart], color);
+		}
+		pendingStart = pendingEnd = 0;
+	}
+
+	Device* screen;
+	int y;
+	int left;
+	const Color& color;
+	Uint32 pixel;
+	int pendingStart;
+	int pendingEnd;
+	Uint8 alphas[VECTOR_TILE_SIZE];
+};
+
+void VectorTileRenderer::FillTile(Device* screen, int tile, const PathEdge* edges, const VectorFill* fills)
+{
+	const std::vector<TileEntry>& entries = tiles[tile];
+	if (entries.empty())
+	{
+		return;
+	}
+
+	int row = tile / tilesX;
+	int left = (tile % tilesX) * VECTOR_TILE_SIZE;
+	int top = row * VECTOR_TILE_SIZE;
+	int right = SDL_min(left + VECTOR_TILE_SIZE, screenWidth);
+	int bottom = SDL_min(top + VECTOR_TILE_SIZE, screenHeight);
+	int width = right - left;
+	const std::vector<int>& rowEdges = rows[row].edges;
+
+	// Each pixel gets the coverage that starts in it, plus the area an edge hands on to the pixel after it,
+	// so adding them up along a row gives the winding at every pixel. The winding only changes at the columns
+	// something was added to, which each row keeps a bit for, and the rest go out as spans
+	// Everything is emptied again as it's read so the buffer is ready for the next fill
+	float accumulation[VECTOR_TILE_SIZE][VECTOR_TILE_SIZE + 1];
+	Uint64 touched[VECTOR_TILE_SIZE];
+	static_assert(VECTOR_TILE_SIZE + 1 <= 64, "Each row keeps a bit per column in 64 bits");
+	memset(accumulation, 0, sizeof(accumulation));
+	memset(touched, 0, sizeof(touched));
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const TileEntry& entry = entries[i];
+		const VectorFill& fill = fills[entry.fill];
+		Uint32 pixel = screen->MapColor(fill.color);
+
+		if (entry.solid)
+		{
+			for (int y = top; y < bottom; ++y)
+			{
+				if (fill.opacity == 255)
+				{
+					screen->FillSpanMapped(y, left, right - 1, pixel);
+				}
+				else
+				{
+					screen->BlendSpan(y, left, right - 1, fill.color, fill.opacity);
+				}
+			}
+			continue;
+		}
+
+		for (int e = entry.firstEdge; e < entry.firstEdge + entry.edgeCount; ++e)
+		{
+			const PathEdge& edge = edges[rowEdges[e]];
+			if (SDL_min(edge.x0, edge.x1) >= right)
+			{
+				continue;
+			}
+
+			float edgeTop = SDL_max(edge.y0, (float)top);
+			float edgeBottom = SDL_min(edge.y1, (float)bottom);
+
+			// Edges that stay left of the tile just change the winding all the way across, which lands in the first column
+			if (SDL_max(edge.x0, edge.x1) <= left)
+			{
+				for (int y = (int)edgeTop; y < edgeBottom; ++y)
+				{
+					float height = SDL_min(edgeBottom, (float)(y + 1)) - SDL_max(edgeTop, (float)y);
+					accumulation[y - top][0] += height * edge.winding;
+					touched[y - top] |= 1;
+				}
+				continue;
+			}
+
+			float slope = (edge.x1 - edge.x0) / (edge.y1 - edge.y0);
+
+			for (int y = (int)edgeTop; y < edgeBottom; ++y)
+			{
+				float ya = SDL_max(edgeTop, (float)y);
+				float yb = SDL_min(edgeBottom, (float)(y + 1));
+				if (yb <= ya)
+				{
+					continue;
+				}
+
+				float* line = accumulation[y - top];
+				Uint64& bits = touched[y - top];
+				SplitRowSegment(edge.x0 + (ya - edge.y0) * slope, ya, edge.x0 + (yb - edge.y0) * slope, yb, edge.winding, left, right,
+					[line, &bits, left](int x, float cover, float area)
+					{
+						line[x - left] += cover - area;
+						line[x - left + 1] += area;
+						bits |= (Uint64)3 << (x - left);
+					});
+			}
+		}
+
+		for (int y = top; y < bottom; ++y)
+		{
+			Uint64 bits = touched[y - top];
+			if (!bits)
+			{
+				continue;
+			}
+
+			float* line = accumulation[y - top];
+			TileRowWriter writer(screen, y, left, fill.color, pixel);
+			float winding = 0.0f;
+			int x = 0;
+
+			for (int column = 0; bits && column < width; ++column, bits >>= 1)
+			{
+				if (!(bits & 1))
+				{
+					continue;
+				}
+
+				writer.Run(x, column, CoverageAlpha(winding, fill.rule, fill.opacity));
+				winding += line[column];
+				line[column] = 0.0f;
+				writer.Run(column, column + 1, CoverageAlpha(winding, fill.rule, fill.opacity));
+				x = column + 1;
+			}
+
+			writer.Run(x, width, CoverageAlpha(winding, fill.rule, fill.opacity));
+			writer.Flush();
+
+			// Anything handed on past the right side of the tile
+			line[width] = 0.0f;
+			touched[y - top] = 0;
+		}
+	}
+}
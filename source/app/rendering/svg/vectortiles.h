@@ -0,0 +1,95 @@
+#ifndef RENDERING_SVG_VECTORTILES_H
+#define RENDERING_SVG_VECTORTILES_H
+
+#include <vector>
+#include "coverage.h"
+#include "../device.h"
+#include "../color.h"
+
+// Vector drawing cuts the screen into square tiles this many pixels wide, each one filled by one thread at a time
+const int VECTOR_TILE_SIZE = 32;
+
+// Tiles have to line up with the framebuffer tiles so no two threads ever write into the same one
+static_assert(VECTOR_TILE_SIZE % FRAMEBUFFER_TILE_SIZE == 0, "Vector tiles need to be made of whole framebuffer tiles");
+
+// One fill out of a list of edges, the edges from firstEdge on belong to it
+struct VectorFill
+{
+	int firstEdge;
+	int edgeCount;
+	Color color;
+	FillRule rule;
+	Uint8 opacity;
+};
+
+// Draws a list of fills across every thread by sorting their edges into screen tiles, then filling the tiles in parallel
+// A tile no edge passes through is either all inside a fill or all outside it, so those just get filled solid without
+// working out any coverage. The rest add up coverage in a buffer the size of the tile
+// Fills always go down in order within a tile, so the picture matches drawing them one after another
+class VectorTileRenderer
+{
+public:
+	VectorTileRenderer();
+
+	void Draw(Device* screen, const PathEdge* edges, const VectorFill* fills, int fillCount);
+
+	// How the tiles the last draw touched were filled, counting each fill in each tile separately
+	int SolidTiles() const { return solidTiles; }
+	int EdgeTiles() const { return edgeTiles; }
+
+private:
+	// A fill that touches a tile. Solid ones cover the whole tile, the others use the edges from
+	// firstEdge up to firstEdge + edgeCount out of their row's edge list
+	struct TileEntry
+	{
+		int fill;
+		int firstEdge;
+		int edgeCount;
+		bool solid;
+	};
+
+	// Where a fill's edges cross the middle of a tile row, for working out the winding of the solid tiles
+	struct Crossing
+	{
+		float x;
+		int winding;
+
+		bool operator<(const Crossing& other) const { return x < other.x; }
+	};
+
+	// Everything one row of tiles needs, so every row can be binned on its own thread
+	struct TileRow
+	{
+		std::vector<int> edges;
+		std::vector<Crossing> crossings;
+		std::vector<PolygonPoint> corners;
+		std::vector<Uint8> touched;
+		int solidTiles;
+		int edgeTiles;
+	};
+
+	struct FillBounds
+	{
+		float left;
+		float top;
+		float right;
+		float bottom;
+	};
+
+	void BinRow(int row, const PathEdge* edges, const VectorFill* fills, int fillCount);
+	void FillTile(Device* screen, int tile, const PathEdge* edges, const VectorFill* fills);
+
+	int screenWidth;
+	int screenHeight;
+	int tilesX;
+	int tilesY;
+
+	std::vector<FillBounds> bounds;
+	std::vector<TileRow> rows;
+	std::vector<std::vector<TileEntry> > tiles;
+
+	int solidTiles;
+	int edgeTiles;
+};
+
+#endif
@@ -13,6 +13,13 @@
 #include "..\util.h"
 #include <sstream>
 #include "svg\circle.h"
+#include "svg\line.h"
+#include "svg\stroke.h"
+#include "font.h"
+#include "glyphatlas.h"
+#include "../jobs.h"
+#include "../profiler.h"
+#include "../clock.h"
 
 // This is used to run random softawre rasterizing tests
 
@@ -108,15 +115,54 @@ void DrawLineBresenham(Device* screen, const Point& p1, const Point& p2, const C
     }
 }
 
-void DrawClockHand(Device* screen, const Point& origin, float percent, int length, Color strokeColor)
+// Joins up the points with smooth lines, all in one batch. The points are pixels, so the lines run through their centers
+void DrawOutline(Device* screen, const Point* points, int count, Color c)
+{
+    std::vector<LineSegment> lines(count);
+    for (int i = 0; i < count; ++i)
+    {
+        const Point& a = points[i];
+        const Point& b = points[(i + 1) % count];
+        lines[i] = LineSegment(a.x + 0.5f, a.y + 0.5f, b.x + 0.5f, b.y + 0.5f);
+    }
+
+    DrawLines(screen, lines, c);
+}
+
+// Hands wider than a pixel are stroked with round ends. They only move once a second, so the stroke cache
+// has them ready the rest of the time
+void DrawClockHand(Device* screen, const Point& origin, float percent, int length, float width, Color strokeColor)
 {
     // 0% in circle terms is a line going right to 3 o'clock, to make it go up to noon, we add 75%
     percent += 0.75f;
 
-    Point edge;
-    edge.x = origin.x + length * cos(percent * 2 * M_PI);
-    edge.y = origin.y + length * sin(percent * 2 * M_PI);
-    DrawLineBresenham(screen, origin, edge, strokeColor);
+    // The tip doesn't get rounded to a pixel any more, the smooth line takes care of where it falls
+    float centerX = origin.x + 0.5f;
+    float centerY = origin.y + 0.5f;
+    float edgeX = centerX + length * cosf(percent * 2 * (float)M_PI);
+    float edgeY = centerY + length * sinf(percent * 2 * (float)M_PI);
+    if (width <= 1.0f)
+    {
+        DrawLineSmooth(screen, centerX, centerY, edgeX, edgeY, strokeColor);
+        return;
+    }
+
+    PolygonPoint hand[2] = { { centerX, centerY }, { edgeX, edgeY } };
+    StrokePolyline(screen, hand, 2, false, StrokeStyle(width, JOIN_ROUND, CAP_ROUND), strokeColor);
+}
+
+// The overlays draw the same few strings every frame, so they all share one atlas and it fills up once
+static GlyphAtlas& OverlayText()
+{
+    static GlyphAtlas atlas;
+    return atlas;
+}
+
+// Centers text on a point, the width leaves off the gap after the last glyph
+static void DrawLabel(Device* screen, float x, float y, const char* text, Color c, float scale)
+{
+    float width = GlyphAtlas::Width(text, scale) - scale;
+    OverlayText().Draw(screen, x - width * 0.5f, y - FONT_GLYPH_HEIGHT * scale * 0.5f, text, c, scale);
 }
 
 void DrawClock(Device* screen, const Point& origin, Color strokeColor, Color backingColor)
@@ -131,24 +177,36 @@ void DrawClock(Device* screen, const Point& origin, Color strokeColor, Color bac
     const int minuteHandLength = 45;
     const int hourHandLength = 25;
 
+    // Numbers at the quarter hours go under the hands, 12 at the top and around from there
+    const char* numerals[4] = { "12", "3", "6", "9" };
+    for (int i = 0; i < 4; ++i)
+    {
+        float angle = (i / 4.0f + 0.75f) * 2 * (float)M_PI;
+        DrawLabel(screen, origin.x + 0.5f + 40 * cosf(angle), origin.y + 0.5f + 40 * sinf(angle), numerals[i], strokeColor, 1.5f);
+    }
+
     // Render the Second hand
     float currsecond = localTime->tm_sec / 60.0f;
-    DrawClockHand(screen, origin, currsecond, secondHandLength, strokeColor);
+    DrawClockHand(screen, origin, currsecond, secondHandLength, 1.0f, strokeColor);
 
     // Render the Minute hand
     float currminute = localTime->tm_min / 60.0f;
-    DrawClockHand(screen, origin, currminute, minuteHandLength, strokeColor);
+    DrawClockHand(screen, origin, currminute, minuteHandLength, 2.0f, strokeColor);
 
     // Render the Hour hand
     float currhour = localTime->tm_hour / 12.0f;
-    DrawClockHand(screen, origin, currhour, hourHandLength, strokeColor);
+    DrawClockHand(screen, origin, currhour, hourHandLength, 3.5f, strokeColor);
+
+    // And the time written out under the face
+    char digital[16];
+    SDL_snprintf(digital, 16, "%02d:%02d:%02d", localTime->tm_hour, localTime->tm_min, localTime->tm_sec);
+    DrawLabel(screen, origin.x + 0.5f, origin.y + 62.0f, digital, strokeColor, 1.5f);
 }
 
 void DrawTriangle(Device* screen, const Point& p1, const Point& p2, const Point& p3, Color c)
 {
-    DrawLineBresenham(screen, p1, p2, c);
-    DrawLineBresenham(screen, p2, p3, c);
-    DrawLineBresenham(screen, p3, p1, c);
+    Point corners[] = { p1, p2, p3 };
+    DrawOutline(screen, corners, 3, c);
 }
 
 void DrawTrapezoid(Device* screen, const Point& origin, Uint32 width, Uint32 height, Uint32 topWidth, Color c)
@@ -158,81 +216,8 @@ void DrawTrapezoid(Device* screen, const Point& origin, Uint32 width, Uint32 hei
     Point ll = Point(origin.x - width / 2, origin.y + height / 2);
     Point lr = Point(origin.x + width / 2, origin.y + height / 2);
 
-    DrawLineBresenham(screen, ul, ur, c);
-    DrawLineBresenham(screen, ur, lr, c);
-    DrawLineBresenham(screen, ll, lr, c);
-    DrawLineBresenham(screen, ll, ul, c);
-}
-
-Uint8 lerp(Uint8 min, Uint8 max, float gradient)
-{
-    return min + (Uint8)((max - min) * gradient);
-}
-
-Color lerp(Color start, Color end, float gradient)
-{
-    return Color(
-        lerp(start.r, end.r, gradient),
-        lerp(start.g, end.g, gradient),
-        lerp(start.b, end.b, gradient),
-        lerp(start.a, end.a, gradient)
-    );
-}
-
-// This function draws a scanline between four vertices that are sorted along the y axis
-// It uses multiple lerps to interpolate values in the vertices, such as colour, depth, and texture mapping
-// In hardware terms, this would set up and call your pixel shader
-void DrawScanline(Device* screen, int y, Vertex va, Vertex vb, Vertex vc, Vertex vd, Color color)
-{
-    // A and B form a line, C and D form a line
-    const Vector3& pa = va.position;
-    const Vector3& pb = vb.position;
-    const Vector3& pc = vc.position;
-    const Vector3& pd = vd.position;
-
-    // We then find out what percentage of the way we are vertically along each line given the y value
-    // Note: This isn't the fatest way as these gradients could be found using precomputation and additions
-    // that would mean fusing the scanline function with it's containing function or passing way more params
-    float gradientLeft = pa.y != pb.y ? (y - pa.y) / (pb.y - pa.y) : 1;
-    float gradientRight = pc.y != pd.y ? (y - pc.y) / (pd.y - pc.y) : 1;
-
-    // With those percentages in hand we can use linear interpolation to find the corresponing values along each
-    // line for our given y, at a base level we calculate the x co-ordinate for drawing the line
-    int startX = (int)lerp(pa.x, pb.x, gradientLeft);
-    int endX = (int)lerp(pc.x, pd.x, gradientRight);
-
-    // We also calculate the z values, which are used for depth buffer testing
-    float z1 = lerp(pa.z, pb.z, gradientLeft);
-    float z2 = lerp(pc.z, pd.z, gradientRight);
-
-    // We also calculate the color values, which are used for lighting an object
-    Color c1 = lerp(va.color, vb.color, gradientLeft);
-    Color c2 = lerp(vc.color, vd.color, gradientRight);
-
-    // Here's where you'd put various mapping coordinate calculations
-    // Things like texture maps, bump maps, normal maps, etc
-
-    // This makes sure we're drawing left to right
-    if (startX > endX)
-    {
-        std::swap(startX, endX);
-        std::swap(z1, z2);
-        std::swap(c1, c2);
-    }
-
-    // Then we draw our pixels, which is the equivalent of a pixel shader
-    for (int x = startX; x < endX; ++x)
-    {
-        float gradientX = (x - startX) / (float)(endX - startX);
-        screen->DrawPoint(x, y, lerp(z1, z2, gradientX), lerp(c1, c2, gradientX));
-    }
-}
-
-// determine on which side of a 2D line a 2D point is
-// returns positive values for "right", negative values for "left", and zero if point is on line
-float VertexDirection(Vertex p, Vertex start, Vertex end)
-{
-    return (p.position.x - start.position.x) * (end.position.y - start.position.y) - (end.position.x - start.position.x) * (p.position.y - start.position.y);
+    Point corners[] = { ul, ur, lr, ll };
+    DrawOutline(screen, corners, 4, c);
 }
 
 float LightIntesity(const Vector3& lightSource, const Vector3& position, const Vector3& normal)
@@ -242,80 +227,24 @@ float LightIntesity(const Vector3& lightSource, const Vector3& position, const V
     return SDL_max(0.0f, normal.Dot(lightDirection));
 }
 
-// New algorithm for rasterizing the triangle uses more interpolation to simplify
-// editing later values. It draws the whole trangle instead of a top half bottom half like before
-void FillTriangle(Device* screen, Vertex v1, Vertex v2, Vertex v3, Vector3& surfaceNormal)
-{
-    // First we need to vertically sort the vertices so v1 is on top
-    if (v2.position.y > v3.position.y)
-    {
-        std::swap(v2, v3);
-    }
-
-    if (v1.position.y > v2.position.y)
-    {
-        std::swap(v1, v2);
-    }
-
-    if (v2.position.y > v3.position.y)
-    {
-        std::swap(v2, v3);
-    }
-
-    // Calculate our lighting values
-    Vector3 light(0, 10, 10);
-    
-    Vector3 centerSurface = (v1.worldPosition + v2.worldPosition + v3.worldPosition) / 3;
-    Color faceColor = Color(0xFFFFFF) * LightIntesity(light, centerSurface, surfaceNormal);
-    v1.color *= LightIntesity(light, v1.worldPosition, v1.normal);
-    v2.color *= LightIntesity(light, v2.worldPosition, v2.normal);
-    v3.color *= LightIntesity(light, v3.worldPosition, v3.normal);
-
-    // We draw a right facing triangle one way
-    if (VertexDirection(v2, v1, v3) > 0)
-    {
-        for (int y = (int)v1.position.y; y <= (int)v3.position.y; y++)
-        {
-            if (y < v2.position.y)
-            {
-                DrawScanline(screen, y, v1, v3, v1, v2, faceColor);
-            }
-            else
-            {
-                DrawScanline(screen, y, v1, v3, v2, v3, faceColor);
-            }
-        }
-    }
-    // and a left facing triangle the opposite way
-    else
-    {
-        for (int y = (int)v1.position.y; y <= (int)v3.position.y; y++)
-        {
-            if (y < v2.position.y)
-            {
-                DrawScanline(screen, y, v1, v2, v1, v3, faceColor);
-            }
-            else
-            {
-                DrawScanline(screen, y, v2, v3, v1, v3, faceColor);
-            }
-        }
-    }
-}
-
-Vector3 Project(Device* screen, Vector3 v, const Matrix& transform)
+Vector3 Project(int width, int height, Vector3 v, const Matrix& transform)
 {
     // Trying to prevent weird holes in the geometry by reducing the risk of floating point errors later on
     Vector3 projectedVector = transform.Transform(Vector4(v));
     return Vector3(
-        (int)((screen->Width() / 2) * projectedVector.x) + (screen->Width() / 2),
-        (int)(-(((screen->Height() / 2) * projectedVector.y) - (screen->Height() / 2))),
+        (int)((width / 2) * projectedVector.x) + (width / 2),
+        (int)(-(((height / 2) * projectedVector.y) - (height / 2))),
         projectedVector.z
     );
 }
 
-void DrawMesh(Device* screen, const Mesh& mesh, const Matrix& projection, const Matrix& view)
+// How many vertices one job shades, small enough that a batch going in and coming out fits in cache
+const int VERTEX_BATCH_SIZE = 512;
+
+void BuildMeshGeometry(FrameGeometry& frame, int width, int height, const Mesh& mesh, const Matrix& projection, const Matrix& view)
 {
+    const DrawState& state = frame.state;
+
     Matrix objectRotation;
     objectRotation.BuildYawPitchRoll(mesh.rotation.y, mesh.rotation.x, mesh.rotation.z);
 
@@ -328,48 +257,103 @@ void DrawMesh(Device* screen, const Mesh& mesh, const Matrix& projection, const
     // Also in a right handed system so multiplies go right to left
     Matrix transformMatrix = projection * (view * worldMatrix);
 
+    bool needsLighting = state.mode != SHADE_DEPTH_ONLY;
+
+    Vector3 light(0, 10, 10);
+
     // This can be thought of as our vertex shader
     // It'll use the variables available to modify each vertex, before they are passed to the scanline function
-    for (int i = 0; i < mesh.faces.size(); ++i)
+    // Faces share most of their vertices, so every vertex is shaded once into the shared buffer and the faces
+    // just pick theirs up. The vertices are independent, so they're split into batches small enough to stay
+    // in cache and spread across the job system
+    Uint64 vertexStart = GetNanoSeconds();
+    std::vector<Vertex>& transformed = frame.vertices;
+    transformed.resize(mesh.vertices.size());
+
+    Jobs::ParallelFor((int)mesh.vertices.size(), VERTEX_BATCH_SIZE, [&](int start, int end)
     {
-        Face face = mesh.faces[i];
-
-        // Grab our raw vectors
-        Vertex v1 = mesh.vertices[face.a];
-        Vertex v2 = mesh.vertices[face.b];
-        Vertex v3 = mesh.vertices[face.c];
-
-        // Calculate world space positions, we'll use this later for lighting
-        v1.worldPosition = worldMatrix.Transform(v1.position);
-        v2.worldPosition = worldMatrix.Transform(v2.position);
-        v3.worldPosition = worldMatrix.Transform(v3.position);
-
-        // Also transform the normals to world space for lighting
-        v1.normal = objectRotation.Transform(v1.normal);
-        v2.normal = objectRotation.Transform(v2.normal);
-        v3.normal = objectRotation.Transform(v3.normal);
-
-        // Project the coordinates
-        v1.position = Project(screen, v1.position, transformMatrix);
-        v2.position = Project(screen, v2.position, transformMatrix);
-        v3.position = Project(screen, v3.position, transformMatrix);
-
-        // Finally rasterize the triangle
-        FillTriangle(screen, v1, v2, v3, worldMatrix.Transform(face.normal));
-    }
+        PROFILE_ZONE("Transform");
+        for (int i = start; i < end; ++i)
+        {
+            const Vertex& source = mesh.vertices[i];
+            Vertex& vertex = transformed[i];
+            vertex = source;
+
+            if (needsLighting)
+            {
+                // Calculate world space positions, we'll use this later for lighting
+                vertex.worldPosition = worldMatrix.Transform(source.position);
+
+                // Gouraud shading lights each vertex and blends between them, everything else lights the whole face at once
+                if (state.mode == SHADE_GOURAUD)
+                {
+                    // Also transform the normals to world space for lighting
+                    vertex.normal = objectRotation.Transform(source.normal);
+                    vertex.color *= LightIntesity(light, vertex.worldPosition, vertex.normal);
+                }
+            }
+
+            // Project the coordinates
+            vertex.position = Project(width, height, source.position, transformMatrix);
+        }
+    });
+
+    frame.vertexTime = GetNanoSeconds() - vertexStart;
+
+    RenderStats& stats = frame.stats;
+    stats.Reset();
+    stats.verticesTransformed = mesh.vertices.size();
+    stats.trianglesSubmitted = mesh.faces.size();
+
+    TileBinner& binner = frame.binner;
+    binner.Reset(width, height, (int)mesh.faces.size());
+
+    // Then put the triangles together, lighting the ones that are lit per face
+    Jobs::ParallelFor((int)mesh.faces.size(), 256, [&](int start, int end)
+    {
+        PROFILE_ZONE("Assemble");
+        for (int i = start; i < end; ++i)
+        {
+            const Face& face = mesh.faces[i];
+            ScreenTriangle& triangle = binner.Triangle(i);
+            triangle.v1 = transformed[face.a];
+            triangle.v2 = transformed[face.b];
+            triangle.v3 = transformed[face.c];
+
+            Color faceColor = Color(0xFFFFFF);
+            if (needsLighting && state.mode != SHADE_GOURAUD)
+            {
+                Vector3 centerSurface = (triangle.v1.worldPosition + triangle.v2.worldPosition + triangle.v3.worldPosition) / 3;
+                faceColor = faceColor * LightIntesity(light, centerSurface, worldMatrix.Transform(face.normal));
+            }
+
+            triangle.faceColor = faceColor;
+        }
+    });
+
+    // Finally sort the triangles into screen bins, they get filled later by RasterizeGeometry
+    binner.Bin(stats);
 }
 
-void Draw(Device* screen, Mesh& mesh)
+void BuildGeometry(FrameGeometry& frame, int width, int height, Mesh& mesh, const DrawState& state)
 {
     // 3d rendering tests
     float rotationsPerSecond = 0.25f;
     float currsecond = ((int)(SDL_GetTicks() * rotationsPerSecond) % 1000) / 1000.0f;
 
+    BuildGeometry(frame, width, height, mesh, state, currsecond);
+}
+
+void BuildGeometry(FrameGeometry& frame, int width, int height, Mesh& mesh, const DrawState& state, float turns)
+{
+    PROFILE_ZONE("Geometry");
+    frame.state = state;
+
     Camera camera;
     camera.position = Vector3(0.0f, 0.0f, 10.0f);
     camera.target = Vector3(0.0f, 0.0f, 0.0f);
 
-    mesh.rotation.y = 2 * M_PI * currsecond;
+    mesh.rotation.y = 2 * M_PI * turns;
     //mesh.position.x = sin(2 * M_PI * currsecond) * 3.0f;
 
     Matrix viewMatrix;
@@ -379,16 +363,79 @@ void Draw(Device* screen, Mesh& mesh)
     Matrix projectionMatrix;
 	// fov version
 	float fov = 60.0f;
-	float aspect = (float)screen->Width() / (float)screen->Height();
+	float aspect = (float)width / (float)height;
 	//projectionMatrix.BuildPerspectiveProjection(fov, aspect, 10, 100); // Perspective version test
-    projectionMatrix.BuildOrthographicProjection(-1.5, 1.5, -2, 2, 0, 2); // Ortho version test
+    // The depth range needs to contain the whole scene, otherwise the fixed point depth formats clamp it all to the far plane
+    projectionMatrix.BuildOrthographicProjection(-1.5, 1.5, -2, 2, 1, 20); // Ortho version test
     //projectionMatrix.BuildPerspectiveProjection(-3, 3, -4, 4, 1, 100); // Perspective version test
 
-    DrawMesh(screen, mesh, projectionMatrix, viewMatrix);
+    BuildMeshGeometry(frame, width, height, mesh, projectionMatrix, viewMatrix);
+}
+
+void RasterizeGeometry(Device* screen, FrameGeometry& frame, RenderStats& stats)
+{
+    PROFILE_ZONE("Rasterize");
+    stats = frame.stats;
+    stats.bytesCleared = screen->BytesCleared();
+    stats.screenPixels = (Uint64)screen->Width() * screen->Height();
+
+    // Pick the rasterizer once for the whole frame, every triangle is filled the same way
+    RasterizeFunction rasterize = GetRasterizer(frame.state.mode, screen->GetDepthFormat());
+    TileBinner& binner = frame.binner;
+    binner.Rasterize(screen, frame.state, rasterize, screen->ReserveTriangleIds(binner.TriangleCount()), stats);
+
+    // The rasterizers only count what made it through, so whatever's left over lost the depth test
+    stats.fragmentsDepthRejected = stats.fragmentsGenerated - stats.fragmentsWritten;
+}
+
+void Draw(Device* screen, Mesh& mesh, const DrawState& state)
+{
+    // Keeps its bin lists around so we're not reallocating them every frame
+    static FrameGeometry frame;
+
+    BuildGeometry(frame, screen->Width(), screen->Height(), mesh, state);
+
+    RenderStats stats;
+    RasterizeGeometry(screen, frame, stats);
+    DrawClock(screen);
+}
+
+void Draw(Device* screen, Mesh& mesh, const DrawState& state, float turns)
+{
+    static FrameGeometry frame;
+
+    BuildGeometry(frame, screen->Width(), screen->Height(), mesh, state, turns);
+
+    RenderStats stats;
+    RasterizeGeometry(screen, frame, stats);
+}
 
+void DrawClock(Device* screen)
+{
     DrawClock(screen, Point(55, 55), Color(0xFFFFFFFF), Color(0xFF1c1ccc));
 }
 
+void DrawStatsOverlay(Device* screen, const RenderStats& stats)
+{
+    // Each line is short enough to sit between the clock and the middle of the screen
+    char lines[7][64];
+    SDL_snprintf(lines[0], 64, "VERTS %llu", (unsigned long long)stats.verticesTransformed);
+    SDL_snprintf(lines[1], 64, "TRIS %llu CULLED %llu CLIPPED %llu", (unsigned long long)stats.trianglesSubmitted,
+        (unsigned long long)stats.trianglesCulled, (unsigned long long)stats.trianglesClipped);
+    SDL_snprintf(lines[2], 64, "RASTERIZED %llu", (unsigned long long)stats.trianglesRasterized);
+    SDL_snprintf(lines[3], 64, "FRAGS %llu REJECTED %llu", (unsigned long long)stats.fragmentsGenerated,
+        (unsigned long long)stats.fragmentsDepthRejected);
+    SDL_snprintf(lines[4], 64, "WRITTEN %llu", (unsigned long long)stats.fragmentsWritten);
+    SDL_snprintf(lines[5], 64, "OVERDRAW %.2f", stats.Overdraw());
+    SDL_snprintf(lines[6], 64, "CLEARED %llu KB", (unsigned long long)(stats.bytesCleared / 1024));
+
+    const int scale = 2;
+    for (int i = 0; i < 7; ++i)
+    {
+        OverlayText().Draw(screen, 115.0f, (float)(10 + i * FONT_LINE_HEIGHT * scale), lines[i], Color(0xFFFFFFFF), (float)scale);
+    }
+}
+
 /// Stuff to do later
 /*
     // If this spinning box left a trail on the points it could be a cool visualizer
@@ -4,7 +4,51 @@
 #include <SDL/SDL.h>
 #include "3d/mesh.h"
 #include "device.h"
+#include "3d/rasterizer.h"
+#include "3d/binner.h"
+#include "stats.h"
 
-void Draw(Device* screen, Mesh& mesh);
+// A frame's worth of triangles that have been through the vertex stage and binned, waiting to be filled
+// Keeping these apart from the device means the next frame can be built while this one is being drawn
+struct FrameGeometry
+{
+    FrameGeometry() : vertexTime(0) {}
+
+    // Every vertex of the mesh after the vertex stage, faces index into this
+    std::vector<Vertex> vertices;
+
+    TileBinner binner;
+    DrawState state;
+
+    // How long shading the vertices took, in nanoseconds
+    Uint64 vertexTime;
+
+    // What the vertex and binning stages got through, the fragment counts get filled in by RasterizeGeometry
+    RenderStats stats;
+};
+
+// The vertex and binning half of Draw. It only needs the size of the screen, not the screen itself
+void BuildGeometry(FrameGeometry& frame, int width, int height, Mesh& mesh, const DrawState& state);
+
+// The same, but the mesh is turned the given fraction of a full turn instead of following the clock,
+// so the exact same frames can be drawn again and again
+void BuildGeometry(FrameGeometry& frame, int width, int height, Mesh& mesh, const DrawState& state, float turns);
+
+// The filling half of Draw, the screen should already be cleared
+// Stats gets everything counted for the frame, including the clear that came before it
+void RasterizeGeometry(Device* screen, FrameGeometry& frame, RenderStats& stats);
+
+// Builds and fills a frame straight away, with the clock on top
+void Draw(Device* screen, Mesh& mesh, const DrawState& state);
+
+// Builds and fills a frame with the mesh turned to a fixed angle. Nothing here depends on the time,
+// so the same arguments always give the same picture
+void Draw(Device* screen, Mesh& mesh, const DrawState& state, float turns);
+
+// Draws the clock in the top left corner
+void DrawClock(Device* screen);
+
+// Writes the counters out in the corner next to the clock
+void DrawStatsOverlay(Device* screen, const RenderStats& stats);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "texture.h"
+#include <math.h>
+
+Texture::Texture()
+    : width(0), height(0), texels(NULL)
+{
+}
+
+Texture::~Texture()
+{
+    if (texels)
+    {
+        delete[] texels;
+    }
+}
+
+void Texture::Create(int _width, int _height)
+{
+    if (texels)
+    {
+        delete[] texels;
+    }
+
+    width = _width;
+    height = _height;
+    texels = new Color[width * height];
+}
+
+void Texture::FillChecker(int squareSize, Color a, Color b)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            bool odd = ((x / squareSize) + (y / squareSize)) & 1;
+            texels[x + y * width] = odd ? b : a;
+        }
+    }
+}
+
+Color Texture::Sample(float u, float v) const
+{
+    // Only keep the fractional part so the texture repeats
+    u -= floorf(u);
+    v -= floorf(v);
+
+    int x = SDL_min((int)(u * width), width - 1);
+    int y = SDL_min((int)(v * height), height - 1);
+    return texels[x + y * width];
+}
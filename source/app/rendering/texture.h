@@ -0,0 +1,27 @@
+#ifndef RENDERING_TEXTURE_H
+#define RENDERING_TEXTURE_H
+
+#include <SDL/SDL.h>
+#include "color.h"
+
+// A very basic texture, just a grid of colors we can look up using texture coordinates
+struct Texture
+{
+    Texture();
+    ~Texture();
+
+    // Allocates space for the given size, any previous texels are thrown away
+    void Create(int _width, int _height);
+
+    // Fills the texture with a checkerboard pattern, handy for seeing how coordinates are mapped
+    void FillChecker(int squareSize, Color a, Color b);
+
+    // Looks up the nearest texel to the given coordinates, wrapping outside of 0 to 1
+    Color Sample(float u, float v) const;
+
+    int width;
+    int height;
+    Color* texels;
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include "video.h"
+#include <string.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include "device.h"
+#include "simd.h"
+#include "../jobs.h"
+#include "../profiler.h"
+
+// Rgb to yuv with the bt.601 weights in 8 bit fixed point, squeezed into the 16 to 235 range video expects
+static inline Uint8 Luma(int r, int g, int b)
+{
+    return (Uint8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline Uint8 ChromaU(int r, int g, int b)
+{
+    return (Uint8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline Uint8 ChromaV(int r, int g, int b)
+{
+    return (Uint8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+static inline void ReadRgb(Uint32 pixel, const SDL_PixelFormat* format, bool packed, int& r, int& g, int& b)
+{
+    if (packed)
+    {
+        r = (pixel >> format->Rshift) & 0xFF;
+        g = (pixel >> format->Gshift) & 0xFF;
+        b = (pixel >> format->Bshift) & 0xFF;
+    }
+    else
+    {
+        Uint8 r8, g8, b8;
+        SDL_GetRGB(pixel, format, &r8, &g8, &b8);
+        r = r8;
+        g = g8;
+        b = b8;
+    }
+}
+
+#if RENDERING_AVX2
+static_assert(FRAMEBUFFER_TILE_SIZE == SIMD_WIDTH, "The wide conversion loads one tile row at a time");
+
+// Pulls one channel out of eight pixels into 32 bit lanes
+static inline __m256i WideChannel(__m256i pixels, __m128i shift)
+{
+    return _mm256_and_si256(_mm256_srl_epi32(pixels, shift), _mm256_set1_epi32(0xFF));
+}
+
+// The same sums as the scalar versions, so both paths give exactly the same bytes
+static inline __m256i WideSum(__m256i r, __m256i g, __m256i b, int rWeight, int gWeight, int bWeight)
+{
+    __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(rWeight)), _mm256_mullo_epi32(g, _mm256_set1_epi32(gWeight)));
+    sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(b, _mm256_set1_epi32(bWeight)));
+    return _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8);
+}
+
+// Takes the low byte of every 32 bit lane, the eight of them end up in the low 64 bits
+static inline __m128i PackBytes(__m256i values)
+{
+    const __m256i pick = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i packed = _mm256_shuffle_epi8(values, pick);
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0)));
+}
+#endif
+
+// Turns rows 2 * pair and 2 * pair + 1 into two rows of luma and one row of each chroma plane, where each chroma
+// sample is the average of a 2x2 block. An odd last row or column gets paired with itself
+static void TiledToYuv420(const Uint32* tiled, int width, int height, int pair, const SDL_PixelFormat* format, Uint8* yPlane, Uint8* uPlane, Uint8* vPlane)
+{
+    int tilesX = (width + FRAMEBUFFER_TILE_SIZE - 1) / FRAMEBUFFER_TILE_SIZE;
+    bool packed = format->BytesPerPixel == 4 && format->Rloss == 0 && format->Gloss == 0 && format->Bloss == 0;
+
+    int y0 = pair * 2;
+    int y1 = SDL_min(y0 + 1, height - 1);
+    const Uint32* rows[2];
+    int ys[2] = { y0, y1 };
+    for (int i = 0; i < 2; ++i)
+    {
+        int tileRow = (ys[i] >> FRAMEBUFFER_TILE_SHIFT) * tilesX;
+        int inside = (ys[i] & (FRAMEBUFFER_TILE_SIZE - 1)) << FRAMEBUFFER_TILE_SHIFT;
+        rows[i] = tiled + (tileRow << (FRAMEBUFFER_TILE_SHIFT * 2)) + inside;
+    }
+
+    Uint8* luma0 = yPlane + y0 * width;
+    Uint8* luma1 = yPlane + y1 * width;
+    int chromaWidth = (width + 1) / 2;
+    Uint8* u = uPlane + pair * chromaWidth;
+    Uint8* v = vPlane + pair * chromaWidth;
+
+    int x = 0;
+
+#if RENDERING_AVX2
+    // A tile row is eight pixels next to each other in memory, so every whole tile is one load per row
+    if (packed)
+    {
+        __m128i rShift = _mm_cvtsi32_si128(format->Rshift);
+        __m128i gShift = _mm_cvtsi32_si128(format->Gshift);
+        __m128i bShift = _mm_cvtsi32_si128(format->Bshift);
+        const __m256i pairOrder = _mm256_setr_epi32(0, 1, 4, 5, 0, 1, 4, 5);
+
+        for (; x + FRAMEBUFFER_TILE_SIZE <= width; x += FRAMEBUFFER_TILE_SIZE)
+        {
+            int offset = (x >> FRAMEBUFFER_TILE_SHIFT) << (FRAMEBUFFER_TILE_SHIFT * 2);
+            __m256i top = _mm256_loadu_si256((const __m256i*)(rows[0] + offset));
+            __m256i bottom = _mm256_loadu_si256((const __m256i*)(rows[1] + offset));
+
+            __m256i r0 = WideChannel(top, rShift);
+            __m256i g0 = WideChannel(top, gShift);
+            __m256i b0 = WideChannel(top, bShift);
+            __m256i r1 = WideChannel(bottom, rShift);
+            __m256i g1 = WideChannel(bottom, gShift);
+            __m256i b1 = WideChannel(bottom, bShift);
+
+            __m256i sixteen = _mm256_set1_epi32(16);
+            _mm_storel_epi64((__m128i*)(luma0 + x), PackBytes(_mm256_add_epi32(WideSum(r0, g0, b0, 66, 129, 25), sixteen)));
+            _mm_storel_epi64((__m128i*)(luma1 + x), PackBytes(_mm256_add_epi32(WideSum(r1, g1, b1, 66, 129, 25), sixteen)));
+
+            // Adding the rows then neighbouring lanes gives the 2x2 sums, which land in lanes 0, 1, 4 and 5
+            __m256i two = _mm256_set1_epi32(2);
+            __m256i r = _mm256_add_epi32(r0, r1);
+            __m256i g = _mm256_add_epi32(g0, g1);
+            __m256i b = _mm256_add_epi32(b0, b1);
+            r = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(r, r), two), 2);
+            g = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(g, g), two), 2);
+            b = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(b, b), two), 2);
+
+            __m256i half = _mm256_set1_epi32(128);
+            __m256i chromaU = _mm256_add_epi32(WideSum(r, g, b, -38, -74, 112), half);
+            __m256i chromaV = _mm256_add_epi32(WideSum(r, g, b, 112, -94, -18), half);
+
+            int packedU = _mm_cvtsi128_si32(PackBytes(_mm256_permutevar8x32_epi32(chromaU, pairOrder)));
+            int packedV = _mm_cvtsi128_si32(PackBytes(_mm256_permutevar8x32_epi32(chromaV, pairOrder)));
+            memcpy(u + x / 2, &packedU, 4);
+            memcpy(v + x / 2, &packedV, 4);
+        }
+    }
+#endif
+
+    for (; x < width; x += 2)
+    {
+        int r = 0;
+        int g = 0;
+        int b = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            Uint8* luma = i == 0 ? luma0 : luma1;
+            for (int column = x; column < x + 2; ++column)
+            {
+                int clamped = SDL_min(column, width - 1);
+                int index = ((clamped >> FRAMEBUFFER_TILE_SHIFT) << (FRAMEBUFFER_TILE_SHIFT * 2)) + (clamped & (FRAMEBUFFER_TILE_SIZE - 1));
+
+                int pr, pg, pb;
+                ReadRgb(rows[i][index], format, packed, pr, pg, pb);
+                luma[clamped] = Luma(pr, pg, pb);
+                r += pr;
+                g += pg;
+                b += pb;
+            }
+        }
+
+        r = (r + 2) >> 2;
+        g = (g + 2) >> 2;
+        b = (b + 2) >> 2;
+        u[x / 2] = ChromaU(r, g, b);
+        v[x / 2] = ChromaV(r, g, b);
+    }
+}
+
+VideoStream::VideoStream()
+    : file(NULL), ownsFile(false), format(VIDEO_Y4M), width(0), height(0), framesWritten(0)
+{
+}
+
+VideoStream::~VideoStream()
+{
+    Close();
+}
+
+bool VideoStream::Open(const char* filename, VideoFormat _format, int _width, int _height, int framesPerSecond)
+{
+    Close();
+
+    if (strcmp(filename, "-") == 0)
+    {
+        file = stdout;
+        ownsFile = false;
+#ifdef _WIN32
+        // Otherwise every 10 byte in the pictures gets a 13 put in front of it
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else
+    {
+        file = fopen(filename, "wb");
+        ownsFile = true;
+    }
+
+    if (!file)
+    {
+        return false;
+    }
+
+    // Frames are big, a bigger buffer means fewer trips into the system to write them
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    format = _format;
+    width = _width;
+    height = _height;
+    framesWritten = 0;
+
+    if (format == VIDEO_Y4M)
+    {
+        // 420jpeg is chroma taken from the middle of each 2x2 block, which is what averaging them gives
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond);
+    }
+
+    return true;
+}
+
+void VideoStream::Close()
+{
+    if (!file)
+    {
+        return;
+    }
+
+    if (ownsFile)
+    {
+        fclose(file);
+    }
+    else
+    {
+        fflush(file);
+    }
+
+    file = NULL;
+}
+
+bool VideoStream::WriteFrame(const Uint32* tiled, int frameWidth, int frameHeight, const SDL_PixelFormat* pixelFormat)
+{
+    PROFILE_ZONE("Write video frame");
+
+    if (!file || frameWidth != width || frameHeight != height)
+    {
+        return false;
+    }
+
+    if (format == VIDEO_Y4M)
+    {
+        int chromaWidth = (width + 1) / 2;
+        int chromaHeight = (height + 1) / 2;
+        int lumaSize = width * height;
+        int chromaSize = chromaWidth * chromaHeight;
+        frame.resize(lumaSize + chromaSize * 2);
+
+        Uint8* yPlane = &frame[0];
+        Uint8* uPlane = yPlane + lumaSize;
+        Uint8* vPlane = uPlane + chromaSize;
+        Jobs::ParallelFor(chromaHeight, 8, [=](int start, int end)
+        {
+            for (int pair = start; pair < end; ++pair)
+            {
+                TiledToYuv420(tiled, width, height, pair, pixelFormat, yPlane, uPlane, vPlane);
+            }
+        });
+
+        fputs("FRAME\n", file);
+    }
+    else
+    {
+        frame.resize(width * height * 3);
+        Uint8* rgb = &frame[0];
+        Jobs::ParallelFor(height, 16, [=](int start, int end)
+        {
+            Device::TiledToRgb(tiled, width, start, end, pixelFormat, rgb);
+        });
+    }
+
+    if (fwrite(&frame[0], frame.size(), 1, file) != 1)
+    {
+        return false;
+    }
+
+    ++framesWritten;
+    return true;
+}
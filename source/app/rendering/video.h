@@ -0,0 +1,48 @@
+#ifndef RENDERING_VIDEO_H
+#define RENDERING_VIDEO_H
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <vector>
+
+enum VideoFormat
+{
+    // Yuv 4:2:0 with a small text header, ffmpeg and most encoders read it without being told anything else
+    VIDEO_Y4M,
+
+    // Nothing but rgb bytes, the reader needs the size and rate passed in (ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH)
+    VIDEO_RAW_RGB
+};
+
+// Appends frames one after another to a single file or pipe, so an encoder can take them as they're drawn
+// instead of us opening, writing and closing a file for every frame
+class VideoStream
+{
+public:
+    VideoStream();
+    ~VideoStream();
+
+    // A filename of "-" writes to standard output, for piping straight into an encoder
+    // The size is fixed for the whole stream, frames that don't match get turned away
+    bool Open(const char* filename, VideoFormat format, int width, int height, int framesPerSecond);
+    void Close();
+    bool IsOpen() const { return file != NULL; }
+
+    // Converts a tiled color buffer (a device's or a copy of one) and appends it. The conversion is spread across the job system
+    bool WriteFrame(const Uint32* tiled, int width, int height, const SDL_PixelFormat* pixelFormat);
+
+    Uint32 FramesWritten() const { return framesWritten; }
+
+private:
+    FILE* file;
+    bool ownsFile;
+    VideoFormat format;
+    int width;
+    int height;
+    Uint32 framesWritten;
+
+    // Reused for every frame
+    std::vector<Uint8> frame;
+};
+
+#endif
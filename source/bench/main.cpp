@@ -0,0 +1,1523 @@
+// We have our own main, SDL is only used for its types and timers here
+#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../app/clock.h"
+#include "../app/debug.h"
+#include "../app/jobs.h"
+#include "../app/rendering/capture.h"
+#include "../app/rendering/device.h"
+#include "../app/rendering/font.h"
+#include "../app/rendering/glyphatlas.h"
+#include "../app/rendering/image.h"
+#include "../app/rendering/video.h"
+#include "../app/rendering/tests.h"
+#include "../app/rendering/svg/circle.h"
+#include "../app/rendering/svg/line.h"
+#include "../app/rendering/svg/polygon.h"
+#include "../app/rendering/svg/scene.h"
+#include "../app/rendering/svg/stroke.h"
+
+// Micro benchmarks for the job system, mostly to see how much a job costs on its own
+// so we know how small the pieces of work can get before the scheduler eats the gains
+// and how well the frame stages scale as cores get added
+// The scenes section draws whole frames of a few standard scenes without a window, so changes to the
+// renderer can be compared run to run
+// The golden section checks that the faster ways of drawing still give the same pixels as the plain one
+
+static double ElapsedNanoSeconds(Uint64 start)
+{
+    return (double)(GetNanoSeconds() - start);
+}
+
+static std::atomic<int> jobsRun(0);
+
+static void EmptyJob(void*)
+{
+    ++jobsRun;
+}
+
+// Queues up a pile of jobs that do nothing from the main thread and waits for them
+static void BenchEmptyJobs(int jobCount)
+{
+    jobsRun = 0;
+    JobCounter counter;
+
+    Uint64 start = GetNanoSeconds();
+    for (int i = 0; i < jobCount; ++i)
+    {
+        Jobs::Run(EmptyJob, NULL, &counter);
+    }
+
+    Jobs::Wait(&counter);
+    double elapsed = ElapsedNanoSeconds(start);
+
+    printf("  empty jobs         %8d jobs  %8.1f ns per job\n", jobsRun.load(), elapsed / jobCount);
+}
+
+struct SpawnData
+{
+    JobCounter* counter;
+    int children;
+};
+
+static void SpawnChildren(void* data)
+{
+    SpawnData* spawn = (SpawnData *)data;
+    for (int i = 0; i < spawn->children; ++i)
+    {
+        Jobs::Run(EmptyJob, NULL, spawn->counter);
+    }
+}
+
+// Each parent spawns its children from inside a worker into a child counter, so this covers
+// stealing and the parent counters staying open until their children are done
+static void BenchNestedJobs(int parentCount, int childCount)
+{
+    jobsRun = 0;
+    JobCounter root;
+    JobCounter* children = new JobCounter[parentCount];
+    SpawnData* spawns = new SpawnData[parentCount];
+
+    Uint64 start = GetNanoSeconds();
+    for (int i = 0; i < parentCount; ++i)
+    {
+        children[i].parent = &root;
+        spawns[i].counter = &children[i];
+        spawns[i].children = childCount;
+        Jobs::Run(SpawnChildren, &spawns[i], &children[i]);
+    }
+
+    Jobs::Wait(&root);
+    double elapsed = ElapsedNanoSeconds(start);
+
+    int total = parentCount * (childCount + 1);
+    printf("  nested jobs        %8d jobs  %8.1f ns per job\n", total, elapsed / total);
+
+    delete[] spawns;
+    delete[] children;
+}
+
+// A parallel for over a cheap body with different grain sizes, the cost per item should level off
+// once the pieces are big enough to hide the scheduling
+static void BenchParallelFor(int count, int grain)
+{
+    std::vector<float> values(count, 1.0f);
+
+    Uint64 start = GetNanoSeconds();
+    Jobs::ParallelFor(count, grain, [&values](int start, int end)
+    {
+        for (int i = start; i < end; ++i)
+        {
+            values[i] = values[i] * 0.5f + 1.0f;
+        }
+    });
+    double elapsed = ElapsedNanoSeconds(start);
+
+    printf("  parallel for       %8d items grain %6d  %8.2f ns per item\n", count, grain, elapsed / count);
+}
+
+// A flat grid with size by size vertices, just something with a lot of vertices to push through the vertex stage
+static void BuildGridMesh(Mesh& mesh, int size)
+{
+    mesh.vertices.reserve(size * size);
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            float u = (float)x / (size - 1);
+            float v = (float)y / (size - 1);
+            Vertex vertex(u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.25f * (u - v));
+            vertex.u = u;
+            vertex.v = v;
+            mesh.vertices.push_back(vertex);
+        }
+    }
+
+    mesh.faces.reserve((size - 1) * (size - 1) * 2);
+    for (int y = 0; y < size - 1; ++y)
+    {
+        for (int x = 0; x < size - 1; ++x)
+        {
+            int corner = x + y * size;
+            mesh.faces.push_back(Face(corner, corner + size, corner + 1));
+            mesh.faces.push_back(Face(corner + 1, corner + size, corner + size + 1));
+        }
+    }
+
+    mesh.CalculateNormals();
+}
+
+// Runs the vertex stage over a big mesh with more and more threads. Efficiency is the single thread time
+// divided by the thread count times the time we got, so 100% means it scaled perfectly
+static void BenchVertexScaling(int gridSize)
+{
+    Mesh mesh;
+    BuildGridMesh(mesh, gridSize);
+
+    DrawState state;
+    state.mode = SHADE_GOURAUD;
+
+    FrameGeometry frame;
+    double singleThreaded = 0.0;
+
+    printf("Vertex stage, %d vertices\n", (int)mesh.vertices.size());
+
+    // Doubling the threads each time, always finishing on all of them
+    int maxThreads = SDL_max((int)std::thread::hardware_concurrency(), 1);
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    for (size_t i = 0; i < threadCounts.size(); ++i)
+    {
+        int threads = threadCounts[i];
+        Jobs::Init(threads - 1);
+
+        // Take the best of a few runs, the first one also gets the buffers allocated
+        double best = 0.0;
+        for (int run = 0; run < 6; ++run)
+        {
+            BuildGeometry(frame, 800, 600, mesh, state);
+            double milliseconds = frame.vertexTime / 1000000.0;
+            if (run == 1 || (run > 1 && milliseconds < best))
+            {
+                best = milliseconds;
+            }
+        }
+
+        Jobs::Shutdown();
+
+        if (threads == 1)
+        {
+            singleThreaded = best;
+        }
+
+        printf("  %2d threads  %8.2f ms  %6.1f%% efficiency\n", threads, best, 100.0 * singleThreaded / (threads * best));
+    }
+}
+
+// Splits every triangle into four through the middle of its edges, the shape stays the same but there's four times the work
+static void SubdivideMesh(Mesh& mesh)
+{
+    // Neighbouring faces share their edges, so each edge only gets one new vertex
+    std::map<std::pair<int, int>, int> midpoints;
+    std::vector<Face> faces;
+    faces.reserve(mesh.faces.size() * 4);
+
+    for (size_t i = 0; i < mesh.faces.size(); ++i)
+    {
+        const Face& face = mesh.faces[i];
+        int corners[3] = { face.a, face.b, face.c };
+        int middles[3];
+
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            int a = corners[edge];
+            int b = corners[(edge + 1) % 3];
+            std::pair<int, int> key(SDL_min(a, b), SDL_max(a, b));
+
+            std::map<std::pair<int, int>, int>::iterator found = midpoints.find(key);
+            if (found != midpoints.end())
+            {
+                middles[edge] = found->second;
+                continue;
+            }
+
+            const Vertex& start = mesh.vertices[a];
+            const Vertex& end = mesh.vertices[b];
+            Vertex middle((start.position + end.position) / 2, start.color);
+            middle.u = (start.u + end.u) * 0.5f;
+            middle.v = (start.v + end.v) * 0.5f;
+
+            middles[edge] = (int)mesh.vertices.size();
+            midpoints[key] = middles[edge];
+            mesh.vertices.push_back(middle);
+        }
+
+        faces.push_back(Face(corners[0], middles[0], middles[2]));
+        faces.push_back(Face(middles[0], corners[1], middles[1]));
+        faces.push_back(Face(middles[2], middles[1], corners[2]));
+        faces.push_back(Face(middles[0], middles[1], middles[2]));
+    }
+
+    mesh.faces.swap(faces);
+
+    // CalculateNormals adds onto whatever's there, so the old ones have to go first
+    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        mesh.vertices[i].normal = Vector3();
+    }
+
+    mesh.CalculateNormals();
+}
+
+// Copies a mesh into another one at an offset and size, there's no instancing so this is how we get lots of objects
+static void AppendInstance(Mesh& mesh, const Mesh& instance, const Vector3& offset, float scale)
+{
+    int first = (int)mesh.vertices.size();
+    for (size_t i = 0; i < instance.vertices.size(); ++i)
+    {
+        Vertex vertex = instance.vertices[i];
+        const Vector3& position = vertex.position;
+        vertex.position = Vector3(position.x * scale + offset.x, position.y * scale + offset.y, position.z * scale + offset.z);
+        mesh.vertices.push_back(vertex);
+    }
+
+    for (size_t i = 0; i < instance.faces.size(); ++i)
+    {
+        Face face = instance.faces[i];
+        face.a += first;
+        face.b += first;
+        face.c += first;
+        mesh.faces.push_back(face);
+    }
+}
+
+static void BuildCubeMesh(Mesh& mesh)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        mesh.vertices.push_back(Vertex((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f));
+    }
+
+    // Two triangles per side, wound the same way as the obj files
+    const int sides[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+    for (int i = 0; i < 6; ++i)
+    {
+        mesh.faces.push_back(Face(sides[i][0], sides[i][1], sides[i][2]));
+        mesh.faces.push_back(Face(sides[i][0], sides[i][2], sides[i][3]));
+    }
+
+    mesh.CalculateNormals();
+}
+
+// A 100 by 100 field of little cubes covering the view
+static void BuildInstanceField(Mesh& mesh)
+{
+    Mesh cube;
+    BuildCubeMesh(cube);
+
+    const int fieldSize = 100;
+    for (int y = 0; y < fieldSize; ++y)
+    {
+        for (int x = 0; x < fieldSize; ++x)
+        {
+            float u = (float)x / (fieldSize - 1);
+            float v = (float)y / (fieldSize - 1);
+            AppendInstance(mesh, cube, Vector3(u * 2.8f - 1.4f, v * 3.8f - 1.9f, (u - v) * 2.0f), 0.012f);
+        }
+    }
+}
+
+// Layers of quads covering the whole view, drawn back to front so every one of them passes the depth test
+static void BuildOverdrawStack(Mesh& mesh, int layers)
+{
+    Mesh quad;
+    quad.vertices.push_back(Vertex(-1.0f, -1.0f, 0.0f));
+    quad.vertices.push_back(Vertex(1.0f, -1.0f, 0.0f));
+    quad.vertices.push_back(Vertex(1.0f, 1.0f, 0.0f));
+    quad.vertices.push_back(Vertex(-1.0f, 1.0f, 0.0f));
+    quad.faces.push_back(Face(0, 1, 2));
+    quad.faces.push_back(Face(0, 2, 3));
+    quad.CalculateNormals();
+
+    for (int i = 0; i < layers; ++i)
+    {
+        float depth = -8.0f + 16.0f * i / layers;
+        AppendInstance(mesh, quad, Vector3(0.0f, 0.0f, depth), 2.0f);
+    }
+}
+
+// A pile of circles on top of the 3d, standing in for the kind of 2d drawing a ui would do
+static void DrawVectorOverlay(Device* screen)
+{
+    for (int y = 40; y < screen->Height(); y += 80)
+    {
+        for (int x = 40; x < screen->Width(); x += 80)
+        {
+            FillCircle(screen, x, y, 24, Color(0xFF3060C0));
+            StrokeCircle(screen, x, y, 30, Color(0xFFFFFFFF));
+        }
+    }
+}
+
+struct BenchScene
+{
+    BenchScene(const char* _name, ShadeMode _mode, float _turnsPerFrame, bool _vectorOverlay)
+        : name(_name), mode(_mode), turnsPerFrame(_turnsPerFrame), vectorOverlay(_vectorOverlay)
+    {}
+
+    const char* name;
+    Mesh mesh;
+    ShadeMode mode;
+
+    // How far the mesh turns each frame, every run sees the exact same frames
+    float turnsPerFrame;
+    bool vectorOverlay;
+};
+
+struct SceneResult
+{
+    double medianMilliseconds;
+    double p99Milliseconds;
+    double meanMilliseconds;
+    double trianglesPerSecond;
+    double fragmentsPerSecond;
+};
+
+// Draws frames of a scene one after another into an offscreen surface, the same way the app does when it isn't pipelining
+static SceneResult RunScene(BenchScene& scene, int width, int height, int frameCount, Texture* texture)
+{
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
+    Device* device = new Device(surface);
+    device->SetDepthCompression(true);
+
+    DrawState state;
+    state.mode = scene.mode;
+    state.texture = texture;
+
+    FrameGeometry frame;
+    RenderStats stats;
+    RenderStats totals;
+    std::vector<double> times;
+
+    // A few frames to get the buffers allocated and the caches warm before anything counts
+    const int warmupFrames = 5;
+    for (int i = -warmupFrames; i < frameCount; ++i)
+    {
+        Uint64 start = GetNanoSeconds();
+
+        device->Clear(Color(0x000000));
+        BuildGeometry(frame, width, height, scene.mesh, state, SDL_max(i, 0) * scene.turnsPerFrame);
+        RasterizeGeometry(device, frame, stats);
+        if (scene.vectorOverlay)
+        {
+            DrawVectorOverlay(device);
+        }
+        device->Present();
+
+        double elapsed = ElapsedNanoSeconds(start);
+        if (i >= 0)
+        {
+            times.push_back(elapsed / 1000000.0);
+            totals.Add(stats);
+        }
+    }
+
+    delete device;
+    SDL_FreeSurface(surface);
+
+    SceneResult result;
+    double total = 0.0;
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        total += times[i];
+    }
+
+    std::sort(times.begin(), times.end());
+    int p99 = SDL_min((int)(times.size() * 99 + 99) / 100, (int)times.size()) - 1;
+    result.medianMilliseconds = times[times.size() / 2];
+    result.p99Milliseconds = times[p99];
+    result.meanMilliseconds = total / times.size();
+    result.trianglesPerSecond = totals.trianglesSubmitted / (total / 1000.0);
+    result.fragmentsPerSecond = totals.fragmentsGenerated / (total / 1000.0);
+    return result;
+}
+
+// Runs every scene at every resolution, printing a table as it goes and writing it all out as json at the end
+static void BenchScenes(int frameCount, const char* filename)
+{
+    Jobs::Init(-1);
+
+    Mesh suzanne;
+    if (!suzanne.ReadTestFormat("data/suzanne.obj"))
+    {
+        printf("Scenes need data/suzanne.obj, run from the top of the repo\n");
+        Jobs::Shutdown();
+        return;
+    }
+
+    Texture texture;
+    texture.Create(64, 64);
+    texture.FillChecker(8, Color(0xFFFFFF), Color(0x3060C0));
+
+    std::vector<BenchScene> scenes;
+    scenes.push_back(BenchScene("suzanne", SHADE_GOURAUD, 0.01f, false));
+    scenes.back().mesh = suzanne;
+    scenes.push_back(BenchScene("suzanne_subdivided", SHADE_TEXTURED, 0.01f, false));
+    scenes.back().mesh = suzanne;
+    SubdivideMesh(scenes.back().mesh);
+    SubdivideMesh(scenes.back().mesh);
+    scenes.push_back(BenchScene("instance_field", SHADE_FLAT, 0.005f, false));
+    BuildInstanceField(scenes.back().mesh);
+    scenes.push_back(BenchScene("vector_overlay", SHADE_GOURAUD, 0.01f, true));
+    scenes.back().mesh = suzanne;
+    scenes.push_back(BenchScene("overdraw", SHADE_GOURAUD, 0.0f, false));
+    BuildOverdrawStack(scenes.back().mesh, 32);
+
+    const int resolutions[][2] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 } };
+    const int resolutionCount = sizeof(resolutions) / sizeof(resolutions[0]);
+
+    FILE* file = fopen(filename, "w");
+    if (!file)
+    {
+        printf("Unable to write %s\n", filename);
+    }
+    else
+    {
+        fprintf(file, "{\n  \"frames\": %d,\n  \"threads\": %d,\n  \"results\": [", frameCount, Jobs::ThreadCount());
+    }
+
+    printf("Scenes, %d frames each on %d threads\n", frameCount, Jobs::ThreadCount());
+    bool first = true;
+    for (size_t i = 0; i < scenes.size(); ++i)
+    {
+        BenchScene& scene = scenes[i];
+        for (int r = 0; r < resolutionCount; ++r)
+        {
+            int width = resolutions[r][0];
+            int height = resolutions[r][1];
+            SceneResult result = RunScene(scene, width, height, frameCount, &texture);
+
+            printf("  %-20s %4dx%-4d  median %7.2f ms  p99 %7.2f ms  %8.2f Mtri/s  %8.1f Mfrag/s\n", scene.name, width, height,
+                result.medianMilliseconds, result.p99Milliseconds, result.trianglesPerSecond / 1000000.0, result.fragmentsPerSecond / 1000000.0);
+
+            if (file)
+            {
+                fprintf(file, "%s\n    { \"scene\": \"%s\", \"width\": %d, \"height\": %d, \"triangles\": %d, "
+                    "\"median_ms\": %.4f, \"p99_ms\": %.4f, \"mean_ms\": %.4f, \"fps\": %.2f, "
+                    "\"triangles_per_second\": %.0f, \"fragments_per_second\": %.0f }",
+                    first ? "" : ",", scene.name, width, height, (int)scene.mesh.faces.size(),
+                    result.medianMilliseconds, result.p99Milliseconds, result.meanMilliseconds, 1000.0 / result.meanMilliseconds,
+                    result.trianglesPerSecond, result.fragmentsPerSecond);
+                first = false;
+            }
+        }
+    }
+
+    if (file)
+    {
+        fprintf(file, "\n  ]\n}\n");
+        fclose(file);
+        printf("  written to %s\n", filename);
+    }
+
+    Jobs::Shutdown();
+}
+
+// One way of drawing a frame. The first one is the plain scalar path, which is checked against the reference images
+// in data. The rest turn on the faster paths one at a time and are checked against the scalar frame from the same run
+struct GoldenVariant
+{
+    const char* name;
+    int workers;
+    bool simd;
+    DepthFormat depthFormat;
+    bool compression;
+
+    // How many pixels can be off from the scalar frame. The wide path steps depth exactly like the scalar one, so only
+    // a depth format that can't tell apart surfaces the float formats can gets any, where triangles meet at a silhouette
+    int badPixels;
+};
+
+static const GoldenVariant goldenVariants[] =
+{
+    { "scalar", 0, false, DEPTH_FLOAT32, false, 0 },
+    { "simd", 0, true, DEPTH_FLOAT32, false, 0 },
+    { "threads", 3, true, DEPTH_FLOAT32, false, 0 },
+    { "compressed", 3, true, DEPTH_FLOAT32, true, 0 },
+    { "reversed", 3, true, DEPTH_FLOAT32_REVERSED, true, 0 },
+    { "unorm24", 3, true, DEPTH_UNORM24, true, 0 },
+    { "unorm16", 3, true, DEPTH_UNORM16, true, 8 },
+};
+
+static const char* shadeModeNames[SHADE_MODE_COUNT] = { "depth", "flat", "gouraud", "textured" };
+
+// A channel can be off by this much before the pixel counts as different
+const int GOLDEN_CHANNEL_TOLERANCE = 2;
+
+// How many pixels the scalar frame can be off from the stored reference. The references are drawn by one compiler
+// and another one's sinf and cosf can land a transformed vertex an ulp away, which moves the odd edge pixel
+const int GOLDEN_REFERENCE_BAD_PIXELS = 12;
+
+// And the picture as a whole has to stay this close to the reference
+const double GOLDEN_MIN_PSNR = 40.0;
+
+const int GOLDEN_WIDTH = 400;
+const int GOLDEN_HEIGHT = 300;
+
+// Reference images are written with Device::WriteToFile, which puts the rgb pixels straight after the 8 byte header
+static bool ReadReference(const char* filename, std::vector<Uint8>& pixels)
+{
+    SDL_RWops* file = SDL_RWFromFile(filename, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    Uint8 header[8];
+    pixels.resize(GOLDEN_WIDTH * GOLDEN_HEIGHT * 3);
+    bool valid = SDL_RWread(file, header, sizeof(header), 1) == 1
+        && header[0] == 'M' && header[1] == 'M' && header[2] == 0 && header[3] == 42
+        && SDL_RWread(file, &pixels[0], pixels.size(), 1) == 1;
+
+    SDL_RWclose(file);
+    return valid;
+}
+
+// Reads the pixels back out of the framebuffer as rgb, the same way WriteToFile does
+static void ReadPixels(Device* device, std::vector<Uint8>& pixels)
+{
+    pixels.resize(device->Width() * device->Height() * 3);
+    Uint8* pixel = &pixels[0];
+    for (int y = 0; y < device->Height(); ++y)
+    {
+        for (int x = 0; x < device->Width(); ++x)
+        {
+            Color color = device->GetPixel(x, y);
+            *pixel++ = color.r;
+            *pixel++ = color.g;
+            *pixel++ = color.b;
+        }
+    }
+}
+
+struct GoldenResult
+{
+    int maxDifference;
+    int badPixels;
+    double psnr;
+    bool passed;
+};
+
+// Compares a frame against its reference. When it doesn't match, the frame and a picture of the differences
+// get written next to the reference, the differences are scaled up so they're easy to see and bad pixels are red
+static GoldenResult CompareGolden(Device* device, const std::vector<Uint8>& actual, const std::vector<Uint8>& reference,
+    int allowedBadPixels, const char* failurePrefix)
+{
+    GoldenResult result;
+    result.maxDifference = 0;
+    result.badPixels = 0;
+
+    double squaredError = 0.0;
+    int pixelCount = device->Width() * device->Height();
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        int worst = 0;
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            int difference = abs(actual[i * 3 + channel] - reference[i * 3 + channel]);
+            squaredError += difference * difference;
+            worst = SDL_max(worst, difference);
+        }
+
+        result.maxDifference = SDL_max(result.maxDifference, worst);
+        result.badPixels += worst > GOLDEN_CHANNEL_TOLERANCE ? 1 : 0;
+    }
+
+    double meanSquaredError = squaredError / (pixelCount * 3.0);
+    result.psnr = meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+    result.passed = result.badPixels <= allowedBadPixels && result.psnr >= GOLDEN_MIN_PSNR;
+
+    if (!result.passed)
+    {
+        char filename[256];
+        SDL_snprintf(filename, sizeof(filename), "%s-actual.tif", failurePrefix);
+        device->WriteToFile(filename);
+
+        for (int y = 0; y < device->Height(); ++y)
+        {
+            for (int x = 0; x < device->Width(); ++x)
+            {
+                const Uint8* a = &actual[(x + y * device->Width()) * 3];
+                const Uint8* b = &reference[(x + y * device->Width()) * 3];
+                int worst = SDL_max(abs(a[0] - b[0]), SDL_max(abs(a[1] - b[1]), abs(a[2] - b[2])));
+                Uint8 level = (Uint8)SDL_min(worst * 16, 255);
+                device->PutPixel(x, y, worst > GOLDEN_CHANNEL_TOLERANCE ? Color(0xFFFF0000) : Color(level, level, level));
+            }
+        }
+
+        SDL_snprintf(filename, sizeof(filename), "%s-diff.tif", failurePrefix);
+        device->WriteToFile(filename);
+    }
+
+    return result;
+}
+
+// Draws Suzanne in every shade mode that writes color at a couple of angles through every variant. The scalar frames are
+// checked against the reference images in data and every other variant against the scalar frames. With update set the
+// reference images get drawn again from the scalar path instead, which should only be done from a build that's known
+// to be right. Returns false if anything didn't match
+static bool BenchGolden(bool update)
+{
+    Mesh suzanne;
+    if (!suzanne.ReadTestFormat("data/suzanne.obj"))
+    {
+        printf("Golden images need data/suzanne.obj, run from the top of the repo\n");
+        return false;
+    }
+
+    Texture texture;
+    texture.Create(64, 64);
+    texture.FillChecker(8, Color(0xFFFFFF), Color(0x3060C0));
+
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, GOLDEN_WIDTH, GOLDEN_HEIGHT, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    Device* device = new Device(surface);
+
+    const float angles[] = { 0.125f, 0.6f };
+    const int angleCount = sizeof(angles) / sizeof(angles[0]);
+    const int variantCount = update ? 1 : sizeof(goldenVariants) / sizeof(goldenVariants[0]);
+
+    // The scalar frames from this run, one per mode and angle, for the faster paths to match
+    std::vector<std::vector<Uint8> > scalarFrames(SHADE_MODE_COUNT * angleCount);
+
+    printf(update ? "Updating golden images\n" : "Golden images\n");
+    int failures = 0;
+    for (int v = 0; v < variantCount; ++v)
+    {
+        const GoldenVariant& variant = goldenVariants[v];
+        Jobs::Init(variant.workers);
+        device->SetDepthFormat(variant.depthFormat);
+        device->SetDepthCompression(variant.compression);
+
+        // Depth only doesn't write any color, but every other mode runs the same depth test so it's still covered
+        for (int mode = SHADE_FLAT; mode < SHADE_MODE_COUNT; ++mode)
+        {
+            DrawState state;
+            state.mode = (ShadeMode)mode;
+            state.texture = &texture;
+            state.simd = variant.simd;
+
+            for (int a = 0; a < angleCount; ++a)
+            {
+                device->Clear(Color(0x000000));
+                Draw(device, suzanne, state, angles[a]);
+
+                char name[128];
+                SDL_snprintf(name, sizeof(name), "data/golden-%s-%d", shadeModeNames[mode], a);
+                char filename[160];
+                SDL_snprintf(filename, sizeof(filename), "%s.tif", name);
+
+                if (update)
+                {
+                    device->WriteToFile(filename);
+                    printf("  wrote %s\n", filename);
+                    continue;
+                }
+
+                std::vector<Uint8>& scalar = scalarFrames[mode * angleCount + a];
+                std::vector<Uint8> actual;
+                ReadPixels(device, actual);
+
+                std::vector<Uint8> stored;
+                const std::vector<Uint8>* reference = &scalar;
+                int allowedBadPixels = variant.badPixels;
+                if (v == 0)
+                {
+                    scalar = actual;
+                    if (!ReadReference(filename, stored))
+                    {
+                        printf("  %-10s %-8s %d  missing %s, run bench golden update first\n", variant.name, shadeModeNames[mode], a, filename);
+                        ++failures;
+                        continue;
+                    }
+
+                    reference = &stored;
+                    allowedBadPixels = GOLDEN_REFERENCE_BAD_PIXELS;
+                }
+
+                char failurePrefix[192];
+                SDL_snprintf(failurePrefix, sizeof(failurePrefix), "%s-%s", name, variant.name);
+                GoldenResult result = CompareGolden(device, actual, *reference, allowedBadPixels, failurePrefix);
+                printf("  %-10s %-8s %d  %s  max %3d  bad %6d  psnr %6.1f dB\n", variant.name, shadeModeNames[mode], a,
+                    result.passed ? "pass" : "FAIL", result.maxDifference, result.badPixels, result.psnr);
+                failures += result.passed ? 0 : 1;
+            }
+        }
+
+        Jobs::Shutdown();
+    }
+
+    delete device;
+    SDL_FreeSurface(surface);
+
+    if (!update)
+    {
+        printf(failures ? "  %d images didn't match\n" : "  everything matched\n", failures);
+    }
+
+    return failures == 0;
+}
+
+// Draws the same frames with nothing captured, with every frame written straight away, and with every frame queued for
+// the capture thread, to see how much of the render speed is left during a long capture
+static void BenchCapture(int frameCount)
+{
+    Mesh suzanne;
+    if (!suzanne.ReadTestFormat("data/suzanne.obj"))
+    {
+        printf("Capture needs data/suzanne.obj, run from the top of the repo\n");
+        return;
+    }
+
+    Jobs::Init(-1);
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, 640, 480, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    Device* device = new Device(surface);
+    DrawState state;
+
+    const char* names[] = { "no capture", "write to file", "capture, waiting", "capture, dropping" };
+    printf("Capture, %d frames at 640x480\n", frameCount);
+    for (int mode = 0; mode < 4; ++mode)
+    {
+        FrameCapture capture(4, mode == 3 ? CAPTURE_DROP : CAPTURE_WAIT);
+
+        Uint64 start = GetNanoSeconds();
+        for (int i = 0; i < frameCount; ++i)
+        {
+            device->Clear(Color(0x000000));
+            Draw(device, suzanne, state, i * 0.01f);
+
+            char filename[64];
+            SDL_snprintf(filename, sizeof(filename), "bench_capture_%03d.tif", i);
+            if (mode == 1)
+            {
+                device->WriteToFile(filename);
+            }
+            else if (mode > 1)
+            {
+                capture.Capture(device, filename);
+            }
+        }
+        double frameTime = ElapsedNanoSeconds(start) / frameCount / 1000000.0;
+
+        Uint64 flushStart = GetNanoSeconds();
+        capture.Flush();
+        double flushTime = ElapsedNanoSeconds(flushStart) / 1000000.0;
+
+        printf("  %-18s %7.2f ms per frame  %7.2f ms to finish writing  %4u dropped\n", names[mode], frameTime, flushTime, capture.FramesDropped());
+    }
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        char filename[64];
+        SDL_snprintf(filename, sizeof(filename), "bench_capture_%03d.tif", i);
+        remove(filename);
+    }
+
+    delete device;
+    SDL_FreeSurface(surface);
+    Jobs::Shutdown();
+}
+
+// Writes a turntable of suzanne as a file per frame and then as one stream, the difference is the cost
+// of opening and closing a file for every frame on top of converting and writing the pixels
+static void BenchVideo(int frameCount)
+{
+    Mesh suzanne;
+    if (!suzanne.ReadTestFormat("data/suzanne.obj"))
+    {
+        printf("Video needs data/suzanne.obj, run from the top of the repo\n");
+        return;
+    }
+
+    Jobs::Init(-1);
+    const int width = 640;
+    const int height = 480;
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    Device* device = new Device(surface);
+    DrawState state;
+
+    const char* names[] = { "tiff per frame", "y4m stream", "raw rgb stream" };
+    printf("Video, %d frames at %dx%d\n", frameCount, width, height);
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        VideoStream stream;
+        if (mode > 0)
+        {
+            stream.Open(mode == 1 ? "bench_video.y4m" : "bench_video.rgb", mode == 1 ? VIDEO_Y4M : VIDEO_RAW_RGB, width, height, 60);
+        }
+
+        double writeTime = 0.0;
+        for (int i = 0; i < frameCount; ++i)
+        {
+            device->Clear(Color(0x000000));
+            Draw(device, suzanne, state, (float)i / frameCount);
+
+            Uint64 start = GetNanoSeconds();
+            if (mode == 0)
+            {
+                char filename[64];
+                SDL_snprintf(filename, sizeof(filename), "bench_video_%03d.tif", i);
+                device->WriteToFile(filename);
+            }
+            else
+            {
+                stream.WriteFrame(device->ColorBuffer(), width, height, device->Format());
+            }
+            writeTime += ElapsedNanoSeconds(start);
+        }
+
+        Uint64 closeStart = GetNanoSeconds();
+        stream.Close();
+        writeTime += ElapsedNanoSeconds(closeStart);
+
+        printf("  %-16s %7.2f ms per frame written\n", names[mode], writeTime / frameCount / 1000000.0);
+    }
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        char filename[64];
+        SDL_snprintf(filename, sizeof(filename), "bench_video_%03d.tif", i);
+        remove(filename);
+    }
+    remove("bench_video.y4m");
+    remove("bench_video.rgb");
+
+    delete device;
+    SDL_FreeSurface(surface);
+    Jobs::Shutdown();
+}
+
+// Encodes one frame in every image format, one thread and then all of them. The speed is how much raw rgb goes in
+// per second, so the formats can be compared on the same footing as well as on how small they get the frame
+// The files from the one thread run are left behind as bench_image_*, to open and check they came out right
+static void BenchImages(int repeats)
+{
+    Mesh suzanne;
+    if (!suzanne.ReadTestFormat("data/suzanne.obj"))
+    {
+        printf("Images needs data/suzanne.obj, run from the top of the repo\n");
+        return;
+    }
+
+    const int width = 1280;
+    const int height = 720;
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    std::vector<Uint8> rgb;
+    {
+        Jobs::Init(-1);
+        Device* device = new Device(surface);
+        DrawState state;
+        device->Clear(Color(0x203040));
+        Draw(device, suzanne, state, 0.1f);
+        ReadPixels(device, rgb);
+        delete device;
+        Jobs::Shutdown();
+    }
+
+    double megabytes = rgb.size() / (1024.0 * 1024.0);
+    printf("Images, %dx%d, %.2f MB of rgb\n", width, height, megabytes);
+
+    int threadCounts[2] = { 0, -1 };
+    for (int t = 0; t < 2; ++t)
+    {
+        Jobs::Init(threadCounts[t]);
+        printf("  %d threads\n", Jobs::ThreadCount());
+
+        for (int format = 0; format < IMAGE_FORMAT_COUNT; ++format)
+        {
+            std::vector<Uint8> encoded;
+            Uint64 start = GetNanoSeconds();
+            for (int i = 0; i < repeats; ++i)
+            {
+                EncodeImage(encoded, &rgb[0], width, height, (ImageFormat)format);
+            }
+            double seconds = ElapsedNanoSeconds(start) / repeats / 1000000000.0;
+
+            printf("    %-14s %8.1f MB/s  %9u bytes  %5.1f%% of raw\n", ImageFormatName((ImageFormat)format),
+                megabytes / seconds, (Uint32)encoded.size(), 100.0 * encoded.size() / rgb.size());
+
+            if (threadCounts[t] == 0)
+            {
+                char filename[64];
+                SDL_snprintf(filename, sizeof(filename), "bench_image_%s.%s", ImageFormatName((ImageFormat)format), ImageExtension((ImageFormat)format));
+                WriteImage(filename, &rgb[0], width, height, (ImageFormat)format);
+            }
+        }
+
+        Jobs::Shutdown();
+    }
+
+    SDL_FreeSurface(surface);
+}
+
+// Fills the same grid of 2d shapes a few ways. The first is how circles used to be filled, a PutPixel per pixel
+// mapping the color every time, to compare against filling whole spans
+static void BenchFills(int repeats)
+{
+    const int width = 1280;
+    const int height = 720;
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    Device* device = new Device(surface);
+    Color color(0xFF3060C0);
+
+    // A five pointed star, which crosses over itself so the middle shows the difference between the fill rules
+    std::vector<PolygonPoint> star(5);
+    for (int i = 0; i < 5; ++i)
+    {
+        float angle = i * 4.0f * (float)M_PI / 5.0f;
+        star[i].x = 30.0f * sinf(angle);
+        star[i].y = -30.0f * cosf(angle);
+    }
+
+    // The strokes are drawn the same in every pass, so after the first one they should all come out of the cache
+    StrokeStyle strokeStyle(4.0f, JOIN_ROUND, CAP_ROUND);
+    std::vector<PathEdge> strokeEdges;
+    CoverageRasterizer strokeRasterizer;
+    ClipRect screenClip(0, 0, width, height);
+
+    const char* names[] = { "circles by pixel", "circles by span", "rects", "stars", "smooth stars", "star strokes", "uncached strokes" };
+    printf("Fills, %d passes over a grid of 64 pixel shapes at %dx%d\n", repeats, width, height);
+    for (int shape = 0; shape < 7; ++shape)
+    {
+        device->Clear(Color(0x000000));
+
+        Uint64 start = GetNanoSeconds();
+        for (int i = 0; i < repeats; ++i)
+        {
+            for (int y = 32; y < height; y += 64)
+            {
+                for (int x = 32; x < width; x += 64)
+                {
+                    if (shape == 0)
+                    {
+                        // The midpoint spans, filled the old way
+                        int determinant = 3 - 2 * 30;
+                        int dx = 0;
+                        int dy = 30;
+                        while (dx <= dy)
+                        {
+                            const int rows[4] = { y + dy, y - dy, y + dx, y - dx };
+                            const int halfWidths[4] = { dx, dx, dy, dy };
+                            for (int r = 0; r < 4; ++r)
+                            {
+                                for (int px = x - halfWidths[r]; px <= x + halfWidths[r]; ++px)
+                                {
+                                    device->PutPixel(px, rows[r], color);
+                                }
+                            }
+
+                            if (determinant < 0)
+                            {
+                                determinant += (4 * dx) + 6;
+                            }
+                            else
+                            {
+                                determinant += 4 * (dx - dy) + 10;
+                                --dy;
+                            }
+                            ++dx;
+                        }
+                    }
+                    else if (shape == 1)
+                    {
+                        FillCircle(device, x, y, 30, color);
+                    }
+                    else if (shape == 2)
+                    {
+                        device->FillRect(x - 30, y - 30, 60, 60, color);
+                    }
+                    else
+                    {
+                        std::vector<PolygonPoint> placed(star);
+                        for (size_t p = 0; p < placed.size(); ++p)
+                        {
+                            placed[p].x += x;
+                            placed[p].y += y;
+                        }
+
+                        // Offset by a fraction so the smooth edges have partly covered pixels to work out
+                        if (shape == 5)
+                        {
+                            StrokePolyline(device, placed, true, strokeStyle, color);
+                        }
+                        else if (shape == 6)
+                        {
+                            strokeEdges.clear();
+                            AddStrokeEdges(strokeEdges, &placed[0], (int)placed.size(), true, strokeStyle);
+                            strokeRasterizer.Fill(device, screenClip, strokeEdges, color, FILL_NONZERO);
+                        }
+                        else if (shape == 4)
+                        {
+                            for (size_t p = 0; p < placed.size(); ++p)
+                            {
+                                placed[p].x += 0.3f;
+                                placed[p].y += 0.6f;
+                            }
+                            FillPolygonSmooth(device, placed, color);
+                        }
+                        else
+                        {
+                            FillPolygon(device, placed, color);
+                        }
+                    }
+                }
+            }
+        }
+
+        printf("  %-18s %8.3f ms per pass\n", names[shape], ElapsedNanoSeconds(start) / repeats / 1000000.0);
+    }
+
+    delete device;
+    SDL_FreeSurface(surface);
+}
+
+// Draws a chart's worth of lines, random segments that mostly hang off the edges of the screen. The first way is how
+// the clock hands used to be drawn, a float error Bresenham going through DrawPoint for every pixel, the others are
+// the smooth lines one call at a time and the whole lot in one batch
+static void BenchLines(int segmentCount)
+{
+    const int width = 1280;
+    const int height = 720;
+    const int repeats = 10;
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    Device* device = new Device(surface);
+    Color color(40, 200, 120);
+
+    std::vector<LineSegment> segments(segmentCount);
+    Uint32 seed = 12345;
+    for (int i = 0; i < segmentCount; ++i)
+    {
+        float values[4];
+        for (int v = 0; v < 4; ++v)
+        {
+            seed = seed * 1664525 + 1013904223;
+            values[v] = (seed >> 8) / (float)(1 << 24);
+        }
+
+        // A quarter of a screen bigger all round, so plenty of them need clipping
+        segments[i] = LineSegment(values[0] * width * 1.5f - width * 0.25f, values[1] * height * 1.5f - height * 0.25f,
+            values[2] * width * 1.5f - width * 0.25f, values[3] * height * 1.5f - height * 0.25f);
+    }
+
+    const char* names[] = { "bresenham", "smooth", "smooth batch" };
+    printf("Lines, %d segments at %dx%d\n", segmentCount, width, height);
+    for (int method = 0; method < 3; ++method)
+    {
+        device->Clear(Color(0x000000));
+
+        Uint64 start = GetNanoSeconds();
+        for (int i = 0; i < repeats; ++i)
+        {
+            if (method == 2)
+            {
+                DrawLines(device, segments, color);
+                continue;
+            }
+
+            for (int s = 0; s < segmentCount; ++s)
+            {
+                const LineSegment& line = segments[s];
+                if (method == 1)
+                {
+                    DrawLineSmooth(device, line.x0, line.y0, line.x1, line.y1, color);
+                    continue;
+                }
+
+                int x0 = (int)line.x0;
+                int y0 = (int)line.y0;
+                int x1 = (int)line.x1;
+                int y1 = (int)line.y1;
+                bool yMajor = abs(y1 - y0) > abs(x1 - x0);
+                if (yMajor)
+                {
+                    std::swap(x0, y0);
+                    std::swap(x1, y1);
+                }
+
+                if (x0 > x1)
+                {
+                    std::swap(x0, x1);
+                    std::swap(y0, y1);
+                }
+
+                float dx = (float)(x1 - x0);
+                float dy = fabsf((float)(y1 - y0));
+                float error = dx / 2.0f;
+                int ystep = y0 > y1 ? -1 : 1;
+                int y = y0;
+                for (int x = x0; x <= x1; ++x)
+                {
+                    if (yMajor)
+                    {
+                        device->DrawPoint(y, x, color);
+                    }
+                    else
+                    {
+                        device->DrawPoint(x, y, color);
+                    }
+
+                    error -= dy;
+                    if (error < 0)
+                    {
+                        y += ystep;
+                        error += dx;
+                    }
+                }
+            }
+        }
+
+        printf("  %-18s %8.3f ms per pass\n", names[method], ElapsedNanoSeconds(start) / repeats / 1000000.0);
+    }
+
+    delete device;
+    SDL_FreeSurface(surface);
+}
+
+// A screen of overlay text, drawn a font pixel at a time and then out of the glyph atlas at a whole and a fractional scale
+static void BenchText(int lineCount)
+{
+    const int width = 1280;
+    const int height = 720;
+    const int repeats = 10;
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    Device* device = new Device(surface);
+    Color color(230, 230, 230);
+    GlyphAtlas atlas;
+
+    std::vector<std::string> lines(lineCount);
+    for (int i = 0; i < lineCount; ++i)
+    {
+        char line[64];
+        SDL_snprintf(line, sizeof(line), "FRAME %d TRIS %d OVERDRAW %.2f", i, i * 37 % 5000, (i % 300) / 100.0f);
+        lines[i] = line;
+    }
+
+    const char* names[] = { "points x2", "atlas x2", "atlas x1.5" };
+    printf("Text, %d lines at %dx%d\n", lineCount, width, height);
+    for (int method = 0; method < 3; ++method)
+    {
+        device->Clear(Color(0x000000));
+        int rasterized = atlas.RasterizeCount();
+
+        Uint64 start = GetNanoSeconds();
+        for (int r = 0; r < repeats; ++r)
+        {
+            for (int i = 0; i < lineCount; ++i)
+            {
+                // The lines wrap down the screen in columns, and the fractional ones land between pixels
+                int row = i % (height / (FONT_LINE_HEIGHT * 2));
+                int column = i / (height / (FONT_LINE_HEIGHT * 2));
+                float x = column * 260.0f + (method == 2 ? 0.3f : 0.0f);
+                float y = (float)(row * FONT_LINE_HEIGHT * 2);
+                if (method == 0)
+                {
+                    DrawString(device, (int)x, (int)y, lines[i].c_str(), color, 2);
+                }
+                else
+                {
+                    atlas.Draw(device, x, y, lines[i].c_str(), color, method == 1 ? 2.0f : 1.5f);
+                }
+            }
+        }
+
+        printf("  %-18s %8.3f ms per pass", names[method], ElapsedNanoSeconds(start) / repeats / 1000000.0);
+        if (method > 0)
+        {
+            printf(", %d glyphs rasterized", atlas.RasterizeCount() - rasterized);
+        }
+        printf("\n");
+    }
+
+    delete device;
+    SDL_FreeSurface(surface);
+}
+
+// Builds a dashboard's worth of svg, a mix of see through circles, outlined rounded boxes, self crossing diamonds
+// and curved strokes, so every part of the vector path gets a go, and one broken path at the end
+static std::string BuildDashboardSvg(int shapeCount, int width, int height)
+{
+    std::string text;
+    char element[256];
+    SDL_snprintf(element, sizeof(element), "<svg width=\"%d\" height=\"%d\">", width, height);
+    text += element;
+
+    Uint32 seed = 12345;
+    for (int i = 0; i < shapeCount; ++i)
+    {
+        // The same numbers every run
+        seed = seed * 1664525 + 1013904223;
+        int x = (seed >> 8) % width;
+        int y = (seed >> 4) % height;
+        int size = 5 + (seed >> 20) % 40;
+        Uint32 color = (seed * 2654435761u) & 0xFFFFFF;
+
+        switch (i % 4)
+        {
+        case 0:
+            SDL_snprintf(element, sizeof(element), "<circle cx=\"%d\" cy=\"%d\" r=\"%d\" fill=\"#%06x\" opacity=\"0.%d\"/>",
+                x, y, size, color, 3 + i % 7);
+            break;
+        case 1:
+            SDL_snprintf(element, sizeof(element), "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" rx=\"4\" fill=\"#%06x\" stroke=\"black\"/>",
+                x, y, size * 2, size, color);
+            break;
+        case 2:
+            SDL_snprintf(element, sizeof(element), "<polygon points=\"%d,%d %d,%d %d,%d %d,%d\" fill=\"#%06x\" fill-rule=\"evenodd\"/>",
+                x, y - size, x + size, y + size, x - size, y, x + size, y, color);
+            break;
+        default:
+            SDL_snprintf(element, sizeof(element), "<path d=\"M%d %d q %d %d %d 0 t %d 0\" fill=\"none\" stroke=\"#%06x\" stroke-width=\"2\"/>",
+                x, y, size, -size, 2 * size, 2 * size, color);
+            break;
+        }
+
+        text += element;
+    }
+
+    // Real files get things wrong too, this one has numbers after a close with no command for them.
+    // The triangle before the mistake should still get drawn and the rest thrown away
+    SDL_snprintf(element, sizeof(element), "<path d=\"M%d %d L%d %d L%d %d Z 5 5\" fill=\"#ff8000\"/>",
+        width / 2, height / 2, width / 2 + 40, height / 2, width / 2 + 40, height / 2 + 40);
+    text += element;
+
+    text += "</svg>";
+    return text;
+}
+
+// Draws the same dashboard one shape at a time and then tiled on every thread, checking the two come out the same
+static void BenchVector(int shapeCount)
+{
+    const int width = 1280;
+    const int height = 720;
+    const int frames = 20;
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+
+    VectorScene scene;
+    scene.Parse(BuildDashboardSvg(shapeCount, width, height).c_str());
+
+    printf("Vector, %d shapes at %dx%d\n", scene.ShapeCount(), width, height);
+
+    std::vector<Uint8> serialPixels;
+    int threadCounts[2] = { 0, -1 };
+    for (int run = 0; run < 3; ++run)
+    {
+        bool tiled = run > 0;
+        Jobs::Init(tiled ? threadCounts[run - 1] : 0);
+        Device* device = new Device(surface);
+        scene.SetTiled(tiled);
+
+        // The first draw flattens everything, after that it should only be rasterizing
+        device->Clear(Color(0xFFFFFF));
+        scene.Draw(device, 1.0f, 0.0f, 0.0f);
+        int flattened = scene.FlattenCount();
+
+        std::vector<double> times;
+        for (int i = 0; i < frames; ++i)
+        {
+            device->Clear(Color(0xFFFFFF));
+            Uint64 start = GetNanoSeconds();
+            scene.Draw(device, 1.0f, 0.0f, 0.0f);
+            times.push_back(ElapsedNanoSeconds(start) / 1000000.0);
+        }
+        std::sort(times.begin(), times.end());
+
+        std::vector<Uint8> pixels;
+        ReadPixels(device, pixels);
+        int maxDifference = 0;
+        if (!tiled)
+        {
+            serialPixels = pixels;
+        }
+        else
+        {
+            for (size_t i = 0; i < pixels.size(); ++i)
+            {
+                maxDifference = SDL_max(maxDifference, abs(pixels[i] - serialPixels[i]));
+            }
+        }
+
+        printf("  %-8s %d threads  %8.3f ms median", tiled ? "tiled" : "serial", Jobs::ThreadCount(), times[frames / 2]);
+        if (tiled)
+        {
+            printf("  %d solid and %d edge tiles, max difference %d", scene.TileRenderer().SolidTiles(), scene.TileRenderer().EdgeTiles(), maxDifference);
+        }
+        printf("%s\n", scene.FlattenCount() != flattened ? "  (flattened again!)" : "");
+
+        delete device;
+        Jobs::Shutdown();
+    }
+
+    SDL_FreeSurface(surface);
+}
+
+// Logging from a hot loop should only cost copying the arguments, the formatting happens on the writing thread
+// Without the thread the message is formatted on the spot, which is what every log used to cost
+static void BenchLogging()
+{
+    const int batchSize = 512;
+    const int batches = 20;
+
+    printf("Logging\n");
+
+    // SDL doesn't show debug messages by default, so this is just the cost of formatting and handing it off
+    Uint64 start = GetNanoSeconds();
+    for (int i = 0; i < batchSize * batches; ++i)
+    {
+        Debug::log("frame %d took %.3f ms on %s", i, 1.5, "Worker 1");
+    }
+    printf("  immediate          %8.1f ns per message\n", ElapsedNanoSeconds(start) / (batchSize * batches));
+
+    // Batches are kept smaller than a thread's buffer, with a pause for the writing thread to catch up
+    Debug::Init("bench.log", false);
+    double total = 0.0;
+    for (int batch = 0; batch < batches; ++batch)
+    {
+        start = GetNanoSeconds();
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Debug::log("frame %d took %.3f ms on %s", i, 1.5, "Worker 1");
+        }
+        total += ElapsedNanoSeconds(start);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    Debug::Shutdown();
+
+    printf("  deferred           %8.1f ns per message, written to bench.log\n", total / (batchSize * batches));
+}
+
+// Everything here is timed with GetNanoSeconds, so it's worth knowing how fine grained and how cheap it is
+static void BenchClock()
+{
+    ClockMeasurement measurement = MeasureClock();
+    printf("Clock\n");
+    printf("  reported resolution %8llu ns\n", (unsigned long long)GetClockResolution());
+    printf("  smallest step seen  %8llu ns\n", (unsigned long long)measurement.smallestStep);
+    printf("  call overhead       %8.1f ns\n", measurement.callOverhead);
+    if (!measurement.monotonic)
+    {
+        printf("  the clock went backwards!\n");
+    }
+}
+
+static void BenchJobs(int workers)
+{
+    Jobs::Init(workers);
+    printf("Job system with %d threads\n", Jobs::ThreadCount());
+
+    // One round to get the threads going and the queues allocated before anything is measured
+    BenchEmptyJobs(10000);
+
+    BenchEmptyJobs(100000);
+    BenchNestedJobs(1000, 100);
+
+    const int grains[] = { 1, 16, 256, 4096, 65536 };
+    const int grainCount = sizeof(grains) / sizeof(grains[0]);
+    for (int i = 0; i < grainCount; ++i)
+    {
+        BenchParallelFor(1 << 20, grains[i]);
+    }
+
+    Jobs::Shutdown();
+}
+
+// bench [clock] [log] [jobs [workers]] [vertices [grid size]] [scenes [frames]] [capture [frames]] [images [repeats]] [video [frames]] [fills [repeats]] [lines [segments]] [vector [shapes]] [text [lines]], with nothing given everything runs with the defaults
+// The scene results are also written to scenes.json
+// bench golden [update] checks the render paths against the reference images, it isn't part of the default run
+// and the exit code is 1 if anything didn't match
+int main(int argc, char* argv[])
+{
+    bool runAll = argc < 2;
+    bool passed = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        // The number after a section name is an optional setting for it
+        bool hasSetting = i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9';
+        int setting = hasSetting ? atoi(argv[i + 1]) : -1;
+
+        if (strcmp(argv[i], "clock") == 0)
+        {
+            BenchClock();
+        }
+        else if (strcmp(argv[i], "log") == 0)
+        {
+            BenchLogging();
+        }
+        else if (strcmp(argv[i], "jobs") == 0)
+        {
+            BenchJobs(setting);
+        }
+        else if (strcmp(argv[i], "vertices") == 0)
+        {
+            BenchVertexScaling(hasSetting ? setting : 1024);
+        }
+        else if (strcmp(argv[i], "scenes") == 0)
+        {
+            BenchScenes(hasSetting ? setting : 60, "scenes.json");
+        }
+        else if (strcmp(argv[i], "capture") == 0)
+        {
+            BenchCapture(hasSetting ? setting : 120);
+        }
+        else if (strcmp(argv[i], "fills") == 0)
+        {
+            BenchFills(hasSetting ? setting : 100);
+        }
+        else if (strcmp(argv[i], "lines") == 0)
+        {
+            BenchLines(hasSetting ? setting : 5000);
+        }
+        else if (strcmp(argv[i], "vector") == 0)
+        {
+            BenchVector(hasSetting ? setting : 3000);
+        }
+        else if (strcmp(argv[i], "text") == 0)
+        {
+            BenchText(hasSetting ? setting : 500);
+        }
+        else if (strcmp(argv[i], "video") == 0)
+        {
+            BenchVideo(hasSetting ? setting : 120);
+        }
+        else if (strcmp(argv[i], "images") == 0)
+        {
+            BenchImages(hasSetting ? setting : 10);
+        }
+        else if (strcmp(argv[i], "golden") == 0)
+        {
+            bool update = i + 1 < argc && strcmp(argv[i + 1], "update") == 0;
+            passed = BenchGolden(update) && passed;
+            i += update ? 1 : 0;
+        }
+        else
+        {
+            printf("Unknown benchmark %s\n", argv[i]);
+        }
+
+        i += hasSetting ? 1 : 0;
+    }
+
+    if (runAll)
+    {
+        BenchClock();
+        BenchLogging();
+        BenchJobs(-1);
+        BenchVertexScaling(1024);
+        BenchScenes(60, "scenes.json");
+        BenchCapture(120);
+        BenchImages(10);
+        BenchVideo(120);
+        BenchFills(100);
+        BenchLines(5000);
+        BenchVector(3000);
+        BenchText(500);
+    }
+
+    return passed ? 0 : 1;
+}